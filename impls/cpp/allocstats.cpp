@@ -0,0 +1,395 @@
+#include "allocstats.hpp"
+#include "interpreter.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxabi.h>
+
+string AllocStats::typeName(std::type_index type)
+{
+  int status;
+  char* readable = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+
+  if(!readable) return type.name();
+
+  string out(readable);
+  std::free(readable);
+
+  return out;
+}
+
+#ifdef MAL_ALLOC_STATS
+
+#include "profiler.hpp"
+#include "futures.hpp"
+#include "transients.hpp"
+#include "transducers.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+static thread_local AllocStats::Totals threadTotals = { 0, 0 };
+
+namespace
+{
+  struct Header
+  {
+    Header* prev;
+    Header* next;
+    const std::type_info* type;
+    uint32_t site;
+    uint32_t size;
+  };
+
+  static_assert(sizeof(Header) % alignof(std::max_align_t) == 0, "values must stay aligned");
+
+  // Everything sits behind one mutex: instrumented builds trade speed for
+  // exact numbers. It is recursive since code inspecting the live values
+  // may drop the last reference to one. The state is allocated once and
+  // never freed, since values are created during static initialization and
+  // destroyed after main returns.
+  struct State
+  {
+    std::recursive_mutex mutex;
+    Header live = { &live, &live, nullptr, 0, 0 };
+    vector<Header*> pending;
+    std::unordered_map<std::type_index, AllocStats::Counts> types;
+    std::unordered_map<uint32_t, AllocStats::Counts> sites;
+    AllocStats::Counts unresolved;
+  };
+
+  State& state()
+  {
+    static State* state = new State;
+    return *state;
+  }
+
+  // Frames are needed to attribute allocations; this keeps them on for the
+  // life of the process.
+  const bool watching = (CallStack::addWatcher(), true);
+
+  MalTypeData* valueOf(Header* header)
+  {
+    return reinterpret_cast<MalTypeData*>(header + 1);
+  }
+
+  // Every class that other values derive from. All of them are abstract,
+  // so none is ever a value's own type.
+  const std::type_info* const bases[] = {
+    &typeid(MalTypeData), &typeid(MalEnumerable), &typeid(MalOperation), &typeid(MalDerefable),
+    &typeid(MalPendingRef), &typeid(MalTransient), &typeid(MalReducer)
+  };
+
+  // A value's vtable pointer is zero until its constructor starts, and names
+  // an abstract base while the base constructors run.
+  bool constructed(Header* header)
+  {
+    if(*reinterpret_cast<void**>(header + 1) == nullptr) return false;
+
+    const auto& type = typeid(*valueOf(header));
+
+    return std::none_of(std::begin(bases), std::end(bases), [&](const std::type_info* base) { return *base == type; });
+  }
+
+  void resolvePending(State& state)
+  {
+    for(size_t i = 0; i < state.pending.size();)
+    {
+      auto* header = state.pending[i];
+
+      if(!constructed(header))
+      {
+        ++i;
+        continue;
+      }
+
+      header->type = &typeid(*valueOf(header));
+
+      auto& counts = state.types[*header->type];
+      ++counts.objects;
+      counts.bytes += header->size;
+      ++counts.liveObjects;
+      counts.liveBytes += header->size;
+
+      state.pending[i] = state.pending.back();
+      state.pending.pop_back();
+    }
+  }
+}
+
+// Counts every other heap allocation, so the totals take in environments,
+// argument vectors, strings and element buffers as well as values.
+void* operator new(size_t size)
+{
+  ++threadTotals.allocations;
+  threadTotals.bytes += size;
+
+  if(void* block = std::malloc(size ? size : 1)) return block;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept
+{
+  std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+  std::free(block);
+}
+
+void* MalTypeData::operator new(size_t size)
+{
+  ++threadTotals.allocations;
+  threadTotals.bytes += size;
+
+  return AllocStats::allocate(size);
+}
+
+void MalTypeData::operator delete(void* block, size_t)
+{
+  AllocStats::release(block);
+}
+
+bool AllocStats::compiledIn()
+{
+  return true;
+}
+
+AllocStats::Totals AllocStats::threadTotals()
+{
+  return ::threadTotals;
+}
+
+size_t AllocStats::sizeOf(const MalTypeData* value)
+{
+  return (reinterpret_cast<const Header*>(value) - 1)->size;
+}
+
+void* AllocStats::allocate(size_t size)
+{
+  auto* header = static_cast<Header*>(std::malloc(sizeof(Header) + size));
+
+  if(!header) throw std::bad_alloc();
+
+  header->type = nullptr;
+  header->site = static_cast<uint32_t>(CallStack::innermost());
+  header->size = static_cast<uint32_t>(size);
+  *reinterpret_cast<void**>(header + 1) = nullptr;
+
+  auto& state = ::state();
+  std::lock_guard<std::recursive_mutex> lock(state.mutex);
+
+  resolvePending(state);
+
+  header->prev = &state.live;
+  header->next = state.live.next;
+  state.live.next->prev = header;
+  state.live.next = header;
+
+  state.pending.push_back(header);
+
+  auto& site = state.sites[header->site];
+  ++site.objects;
+  site.bytes += size;
+
+  return header + 1;
+}
+
+void AllocStats::release(void* block)
+{
+  if(!block) return;
+
+  auto* header = static_cast<Header*>(block) - 1;
+  auto& state = ::state();
+
+  {
+    std::lock_guard<std::recursive_mutex> lock(state.mutex);
+
+    header->prev->next = header->next;
+    header->next->prev = header->prev;
+
+    if(header->type)
+    {
+      auto& counts = state.types[*header->type];
+      --counts.liveObjects;
+      counts.liveBytes -= header->size;
+    }
+    else
+    {
+      state.pending.erase(std::find(state.pending.begin(), state.pending.end(), header));
+
+      ++state.unresolved.objects;
+      state.unresolved.bytes += header->size;
+    }
+
+    resolvePending(state);
+  }
+
+  std::free(header);
+}
+
+map<string, AllocStats::Counts> AllocStats::byType()
+{
+  auto& state = ::state();
+  std::lock_guard<std::recursive_mutex> lock(state.mutex);
+
+  resolvePending(state);
+
+  map<string, Counts> out;
+
+  for(const auto& pair : state.types)
+  {
+    out[typeName(pair.first)] = pair.second;
+  }
+
+  if(state.unresolved.objects) out["(unresolved)"] = state.unresolved;
+
+  return out;
+}
+
+map<string, AllocStats::Counts> AllocStats::bySite()
+{
+  auto& state = ::state();
+  std::unordered_map<uint32_t, Counts> sites;
+
+  {
+    std::lock_guard<std::recursive_mutex> lock(state.mutex);
+    sites = state.sites;
+  }
+
+  // Interning takes the symbol table's lock, so names are looked up outside
+  // of ours.
+  map<string, Counts> out;
+
+  for(const auto& pair : sites)
+  {
+    out[SymbolTable::name(pair.first)] = pair.second;
+  }
+
+  return out;
+}
+
+void AllocStats::inspectLive(const std::function<void(const vector<const MalTypeData*>&)>& inspect)
+{
+  auto& state = ::state();
+  std::lock_guard<std::recursive_mutex> lock(state.mutex);
+
+  resolvePending(state);
+
+  vector<const MalTypeData*> values;
+
+  for(auto* header = state.live.next; header != &state.live; header = header->next)
+  {
+    if(header->type) values.push_back(valueOf(header));
+  }
+
+  inspect(values);
+}
+
+#else
+
+#include <malloc.h>
+
+void* MalTypeData::operator new(size_t size)
+{
+  return ::operator new(size);
+}
+
+void MalTypeData::operator delete(void* block, size_t size)
+{
+  ::operator delete(block, size);
+}
+
+bool AllocStats::compiledIn()
+{
+  return false;
+}
+
+AllocStats::Totals AllocStats::threadTotals()
+{
+  return { 0, 0 };
+}
+
+size_t AllocStats::sizeOf(const MalTypeData* value)
+{
+  return malloc_usable_size(const_cast<MalTypeData*>(value));
+}
+
+map<string, AllocStats::Counts> AllocStats::byType()
+{
+  return {};
+}
+
+map<string, AllocStats::Counts> AllocStats::bySite()
+{
+  return {};
+}
+
+void AllocStats::inspectLive(const std::function<void(const vector<const MalTypeData*>&)>& inspect)
+{
+  inspect({});
+}
+
+#endif
+
+static void requireStats()
+{
+  if(!AllocStats::compiledIn()) throw TypeException("Allocation stats need an instrumented build (make instrumented)");
+}
+
+MalType MalAllocStatsOperation::apply(const vector<MalType>&)
+{
+  requireStats();
+
+  map<string, MalType> types;
+
+  for(const auto& pair : AllocStats::byType())
+  {
+    const auto& counts = pair.second;
+
+    types['"' + pair.first + '"'] = MalType(new MalHashMap(map<string, MalType>{
+      { ":objects", MalInt::of(counts.objects) },
+      { ":bytes", MalInt::of(counts.bytes) },
+      { ":live", MalInt::of(counts.liveObjects) },
+      { ":live-bytes", MalInt::of(counts.liveBytes) }
+    }));
+  }
+
+  return MalType(new MalHashMap(std::move(types)));
+}
+
+MalType MalAllocSitesOperation::apply(const vector<MalType>& args)
+{
+  requireStats();
+
+  size_t topN = args.empty() ? 20 : Interpreter::toInt(args[0]);
+  auto sites = AllocStats::bySite();
+  vector<std::pair<string, AllocStats::Counts>> rows(sites.begin(), sites.end());
+
+  std::stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.second.bytes > b.second.bytes; });
+
+  if(rows.size() > topN) rows.resize(topN);
+
+  char line[160];
+  string out;
+
+  snprintf(line, sizeof(line), "%12s %14s  %s\n", "objects", "bytes", "function");
+  out += line;
+
+  for(const auto& row : rows)
+  {
+    snprintf(line, sizeof(line), "%12zu %14zu  %s\n", row.second.objects, row.second.bytes, row.first.c_str());
+    out += line;
+  }
+
+  std::lock_guard<std::mutex> lock(interpreter_.getOutputMutex());
+  interpreter_.getOutput() << out;
+
+  return MNil;
+}
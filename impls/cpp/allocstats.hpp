@@ -0,0 +1,84 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <functional>
+#include <string>
+#include <typeindex>
+
+using std::string;
+
+// Allocation accounting for mal values, compiled in only with
+// MAL_ALLOC_STATS (`make instrumented`); other builds don't have its hooks
+// at all. With it, MalTypeData's operator new puts a header in front of
+// each value recording its size and the mal function that allocated it,
+// and keeps it on a list of live values. A value's type can only be read
+// once it has been constructed, so it is filled in at the next allocation
+// or free; the few freed before that count as (unresolved).
+class AllocStats
+{
+public:
+  struct Counts
+  {
+    size_t objects = 0;
+    size_t bytes = 0;
+    size_t liveObjects = 0;
+    size_t liveBytes = 0;
+  };
+
+  static bool compiledIn();
+
+  // Heap allocations the calling thread has made, of values and of
+  // everything else, and their bytes; zero unless compiledIn().
+  struct Totals
+  {
+    size_t allocations;
+    size_t bytes;
+  };
+
+  static Totals threadTotals();
+
+  // The bytes a value was allocated with: the size asked for in
+  // instrumented builds, the block the allocator gave otherwise.
+  static size_t sizeOf(const MalTypeData* value);
+
+  static string typeName(std::type_index type);
+
+  static void* allocate(size_t size);
+  static void release(void* block);
+
+  // Counts per demangled type name, and per allocating function (objects
+  // and bytes only). Both are empty unless compiledIn().
+  static map<string, Counts> byType();
+  static map<string, Counts> bySite();
+
+  // Calls inspect with every constructed live value, holding the lock that
+  // allocating and freeing values take, so none of them can be freed under
+  // it. A value another thread is destroying at that moment is still on
+  // the list, half torn down, so other threads should be idle. The list is
+  // empty unless compiledIn().
+  static void inspectLive(const std::function<void(const vector<const MalTypeData*>&)>& inspect);
+};
+
+// (alloc-stats) maps each type name to a map of :objects, :bytes, :live and
+// :live-bytes, counting since startup. Bytes are the values themselves, not
+// the element buffers they own.
+class MalAllocStatsOperation : public MalOperation
+{
+public:
+  MalAllocStatsOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (alloc-sites) or (alloc-sites n) prints the n mal functions that
+// allocated the most bytes, 20 by default.
+class MalAllocSitesOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalAllocSitesOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
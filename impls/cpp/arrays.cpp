@@ -0,0 +1,766 @@
+#include "arrays.hpp"
+#include "bigint.hpp"
+#include "numbers.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+#include "heap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <typeinfo>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Integer kernels report overflow instead of wrapping: sums return false
+// so the caller can redo them exactly, elementwise ones throw.
+static void overflow(const char* name)
+{
+  throw TypeException(string("Integer overflow in ") + name);
+}
+
+static bool sumIntsScalar(const int64_t* data, size_t count, int64_t& sum)
+{
+  sum = 0;
+
+  for(size_t i = 0; i < count; ++i)
+  {
+    if(__builtin_add_overflow(sum, data[i], &sum)) return false;
+  }
+
+  return true;
+}
+
+static double sumDoublesScalar(const double* data, size_t count)
+{
+  double sum = 0;
+
+  for(size_t i = 0; i < count; ++i)
+  {
+    sum += data[i];
+  }
+
+  return sum;
+}
+
+// count is at least 1.
+template<class T>
+static void minMaxScalar(const T* data, size_t count, T& min, T& max)
+{
+  min = max = data[0];
+
+  for(size_t i = 1; i < count; ++i)
+  {
+    min = std::min(min, data[i]);
+    max = std::max(max, data[i]);
+  }
+}
+
+static double dotDoublesScalar(const double* a, const double* b, size_t count)
+{
+  double sum = 0;
+
+  for(size_t i = 0; i < count; ++i)
+  {
+    sum += a[i] * b[i];
+  }
+
+  return sum;
+}
+
+static void addIntsScalar(const int64_t* a, const int64_t* b, int64_t* out, size_t count)
+{
+  for(size_t i = 0; i < count; ++i)
+  {
+    if(__builtin_add_overflow(a[i], b[i], &out[i])) overflow("array-add");
+  }
+}
+
+static void addDoublesScalar(const double* a, const double* b, double* out, size_t count)
+{
+  for(size_t i = 0; i < count; ++i)
+  {
+    out[i] = a[i] + b[i];
+  }
+}
+
+static void mulDoublesScalar(const double* a, const double* b, double* out, size_t count)
+{
+  for(size_t i = 0; i < count; ++i)
+  {
+    out[i] = a[i] * b[i];
+  }
+}
+
+static void scaleDoublesScalar(const double* data, double factor, double* out, size_t count)
+{
+  for(size_t i = 0; i < count; ++i)
+  {
+    out[i] = data[i] * factor;
+  }
+}
+
+static void prefixSumDoublesScalar(const double* data, double* out, size_t count)
+{
+  double sum = 0;
+
+  for(size_t i = 0; i < count; ++i)
+  {
+    out[i] = sum += data[i];
+  }
+}
+
+#if defined(__x86_64__)
+
+#define AVX2 __attribute__((target("avx2")))
+
+// Lane-wise signed overflow of s = a + b: the sign of s differs from both.
+AVX2 static __m256i addOverflow(__m256i a, __m256i b, __m256i s)
+{
+  return _mm256_and_si256(_mm256_xor_si256(a, s), _mm256_xor_si256(b, s));
+}
+
+AVX2 static bool anySignBit(__m256i lanes)
+{
+  return _mm256_movemask_pd(_mm256_castsi256_pd(lanes)) != 0;
+}
+
+AVX2 static double horizontalSum(__m256d lanes)
+{
+  __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(lanes), _mm256_extractf128_pd(lanes, 1));
+
+  return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+AVX2 static bool sumIntsAvx2(const int64_t* data, size_t count, int64_t& sum)
+{
+  __m256i lanes = _mm256_setzero_si256();
+  __m256i overflowed = _mm256_setzero_si256();
+  size_t i = 0;
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    __m256i s = _mm256_add_epi64(lanes, x);
+
+    overflowed = _mm256_or_si256(overflowed, addOverflow(lanes, x, s));
+    lanes = s;
+  }
+
+  if(anySignBit(overflowed)) return false;
+
+  int64_t partial[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(partial), lanes);
+
+  sum = 0;
+
+  for(auto value : partial)
+  {
+    if(__builtin_add_overflow(sum, value, &sum)) return false;
+  }
+
+  int64_t tail;
+
+  return sumIntsScalar(data + i, count - i, tail) && !__builtin_add_overflow(sum, tail, &sum);
+}
+
+AVX2 static double sumDoublesAvx2(const double* data, size_t count)
+{
+  __m256d first = _mm256_setzero_pd();
+  __m256d second = _mm256_setzero_pd();
+  size_t i = 0;
+
+  // Two accumulators so consecutive adds don't wait on each other.
+  for(; i + 8 <= count; i += 8)
+  {
+    first = _mm256_add_pd(first, _mm256_loadu_pd(data + i));
+    second = _mm256_add_pd(second, _mm256_loadu_pd(data + i + 4));
+  }
+
+  return horizontalSum(_mm256_add_pd(first, second)) + sumDoublesScalar(data + i, count - i);
+}
+
+AVX2 static void minMaxIntsAvx2(const int64_t* data, size_t count, int64_t& min, int64_t& max)
+{
+  if(count < 4) return minMaxScalar(data, count, min, max);
+
+  __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+  __m256i high = low;
+  size_t i = 4;
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+
+    // AVX2 has no 64-bit min/max; compare and blend instead.
+    low = _mm256_blendv_epi8(low, x, _mm256_cmpgt_epi64(low, x));
+    high = _mm256_blendv_epi8(high, x, _mm256_cmpgt_epi64(x, high));
+  }
+
+  int64_t lows[4], highs[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lows), low);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(highs), high);
+
+  min = *std::min_element(lows, lows + 4);
+  max = *std::max_element(highs, highs + 4);
+
+  for(; i < count; ++i)
+  {
+    min = std::min(min, data[i]);
+    max = std::max(max, data[i]);
+  }
+}
+
+AVX2 static void minMaxDoublesAvx2(const double* data, size_t count, double& min, double& max)
+{
+  if(count < 4) return minMaxScalar(data, count, min, max);
+
+  __m256d low = _mm256_loadu_pd(data);
+  __m256d high = low;
+  size_t i = 4;
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m256d x = _mm256_loadu_pd(data + i);
+
+    low = _mm256_min_pd(x, low);
+    high = _mm256_max_pd(x, high);
+  }
+
+  double lows[4], highs[4];
+  _mm256_storeu_pd(lows, low);
+  _mm256_storeu_pd(highs, high);
+
+  min = *std::min_element(lows, lows + 4);
+  max = *std::max_element(highs, highs + 4);
+
+  for(; i < count; ++i)
+  {
+    min = std::min(min, data[i]);
+    max = std::max(max, data[i]);
+  }
+}
+
+AVX2 static double dotDoublesAvx2(const double* a, const double* b, size_t count)
+{
+  __m256d first = _mm256_setzero_pd();
+  __m256d second = _mm256_setzero_pd();
+  size_t i = 0;
+
+  for(; i + 8 <= count; i += 8)
+  {
+    first = _mm256_add_pd(first, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    second = _mm256_add_pd(second, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+  }
+
+  return horizontalSum(_mm256_add_pd(first, second)) + dotDoublesScalar(a + i, b + i, count - i);
+}
+
+AVX2 static void addIntsAvx2(const int64_t* a, const int64_t* b, int64_t* out, size_t count)
+{
+  __m256i overflowed = _mm256_setzero_si256();
+  size_t i = 0;
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    __m256i s = _mm256_add_epi64(x, y);
+
+    overflowed = _mm256_or_si256(overflowed, addOverflow(x, y, s));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), s);
+  }
+
+  if(anySignBit(overflowed)) overflow("array-add");
+
+  addIntsScalar(a + i, b + i, out + i, count - i);
+}
+
+AVX2 static void addDoublesAvx2(const double* a, const double* b, double* out, size_t count)
+{
+  size_t i = 0;
+
+  for(; i + 4 <= count; i += 4)
+  {
+    _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+  }
+
+  addDoublesScalar(a + i, b + i, out + i, count - i);
+}
+
+AVX2 static void mulDoublesAvx2(const double* a, const double* b, double* out, size_t count)
+{
+  size_t i = 0;
+
+  for(; i + 4 <= count; i += 4)
+  {
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+  }
+
+  mulDoublesScalar(a + i, b + i, out + i, count - i);
+}
+
+AVX2 static void scaleDoublesAvx2(const double* data, double factor, double* out, size_t count)
+{
+  __m256d scale = _mm256_set1_pd(factor);
+  size_t i = 0;
+
+  for(; i + 4 <= count; i += 4)
+  {
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(data + i), scale));
+  }
+
+  scaleDoublesScalar(data + i, factor, out + i, count - i);
+}
+
+// Scans four elements in registers by adding the block shifted up one lane
+// and then two, then adds the running total carried over from the last
+// block.
+AVX2 static void prefixSumDoublesAvx2(const double* data, double* out, size_t count)
+{
+  __m256d zero = _mm256_setzero_pd();
+  __m256d carry = zero;
+  size_t i = 0;
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m256d x = _mm256_loadu_pd(data + i);
+
+    x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0b0001));
+    x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0b0011));
+    x = _mm256_add_pd(x, carry);
+
+    _mm256_storeu_pd(out + i, x);
+    carry = _mm256_permute4x64_pd(x, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+
+  double sum = i ? out[i - 1] : 0;
+
+  for(; i < count; ++i)
+  {
+    out[i] = sum += data[i];
+  }
+}
+
+#endif
+
+// One implementation of each kernel, picked once for this CPU.
+struct Kernels
+{
+  const char* name;
+  bool (*sumInts)(const int64_t* data, size_t count, int64_t& sum);
+  double (*sumDoubles)(const double* data, size_t count);
+  void (*minMaxInts)(const int64_t* data, size_t count, int64_t& min, int64_t& max);
+  void (*minMaxDoubles)(const double* data, size_t count, double& min, double& max);
+  double (*dotDoubles)(const double* a, const double* b, size_t count);
+  void (*addInts)(const int64_t* a, const int64_t* b, int64_t* out, size_t count);
+  void (*addDoubles)(const double* a, const double* b, double* out, size_t count);
+  void (*mulDoubles)(const double* a, const double* b, double* out, size_t count);
+  void (*scaleDoubles)(const double* data, double factor, double* out, size_t count);
+  void (*prefixSumDoubles)(const double* data, double* out, size_t count);
+};
+
+static const Kernels& kernels()
+{
+  static const Kernels scalar = {
+    "scalar", sumIntsScalar, sumDoublesScalar, minMaxScalar<int64_t>, minMaxScalar<double>, dotDoublesScalar,
+    addIntsScalar, addDoublesScalar, mulDoublesScalar, scaleDoublesScalar, prefixSumDoublesScalar
+  };
+
+#if defined(__x86_64__)
+  static const Kernels avx2 = {
+    "avx2", sumIntsAvx2, sumDoublesAvx2, minMaxIntsAvx2, minMaxDoublesAvx2, dotDoublesAvx2,
+    addIntsAvx2, addDoublesAvx2, mulDoublesAvx2, scaleDoublesAvx2, prefixSumDoublesAvx2
+  };
+
+  static const Kernels& selected = [&]() -> const Kernels& {
+    const char* forced = std::getenv("MAL_SIMD");
+
+    if(forced && std::strcmp(forced, "scalar") == 0) return scalar;
+
+    return __builtin_cpu_supports("avx2") ? avx2 : scalar;
+  }();
+
+  return selected;
+#else
+  return scalar;
+#endif
+}
+
+const char* MalTypedArray::instructionSet()
+{
+  return kernels().name;
+}
+
+// The exact value of a 128-bit sum, as a MalInt when it fits.
+static MalType fromInt128(__int128 value)
+{
+  if(value >= INT64_MIN && value <= INT64_MAX) return MalInt::of(static_cast<int64_t>(value));
+
+  BigInt result(static_cast<int64_t>(value >> 64));
+  auto low = static_cast<uint64_t>(value);
+  BigInt word(int64_t(1) << 32);
+
+  result = result * word + BigInt(static_cast<int64_t>(low >> 32));
+  result = result * word + BigInt(static_cast<int64_t>(low & 0xffffffff));
+
+  return MalBigInt::from(result);
+}
+
+class ArrayCursor : public Cursor
+{
+  MalType owner_;
+  const MalTypedArray* array_;
+  size_t index_;
+
+public:
+  ArrayCursor(const MalType& owner): owner_(owner), array_(static_cast<MalTypedArray*>(&*owner)), index_(0) {}
+
+  virtual bool next(MalType& value) override
+  {
+    if(index_ == array_->size()) return false;
+
+    value = array_->nth(index_++);
+    return true;
+  }
+};
+
+string MalTypedArray::getString(bool printReadably)
+{
+  string out = type_ == Int64 ? "#<int-array [" : "#<double-array [";
+
+  for(size_t i = 0; i < size(); ++i)
+  {
+    if(i) out += " ";
+    out += nth(i)->getString(printReadably);
+  }
+
+  return out + "]>";
+}
+
+bool MalTypedArray::equals(const MalType& other) const
+{
+  auto* otherArray = dynamic_cast<MalTypedArray*>(&*other);
+
+  if(!otherArray || otherArray->type_ != type_) return false;
+
+  return type_ == Int64 ? ints_ == otherArray->ints_ : doubles_ == otherArray->doubles_;
+}
+
+MalType MalTypedArray::deepCopy() const
+{
+  return type_ == Int64 ? MalType(new MalTypedArray(ints_)) : MalType(new MalTypedArray(doubles_));
+}
+
+shared_ptr<Cursor> MalTypedArray::cursor(const MalType& self)
+{
+  return std::make_shared<ArrayCursor>(self);
+}
+
+void MalTypedArray::traverse(HeapVisitor& visitor) const
+{
+  visitor.buffer(ints_);
+  visitor.buffer(doubles_);
+}
+
+vector<double> MalTypedArray::toDoubles() const
+{
+  if(type_ == Float64) return doubles_;
+
+  return vector<double>(ints_.begin(), ints_.end());
+}
+
+MalType MalTypedArray::nth(size_t index) const
+{
+  return type_ == Int64 ? MalInt::of(ints_[index]) : MalType(new MalDouble(doubles_[index]));
+}
+
+static MalTypedArray* toArray(const MalType& value)
+{
+  auto* array = dynamic_cast<MalTypedArray*>(&*value);
+
+  if(!array) throw TypeException("Expected a typed array but got " + Printer::prStr(value, true));
+
+  return array;
+}
+
+// The elements of array as doubles, converted into scratch only if they
+// are int64.
+static const double* doubleData(const MalTypedArray* array, vector<double>& scratch)
+{
+  if(array->elementType() == MalTypedArray::Float64) return array->doubles().data();
+
+  scratch = array->toDoubles();
+
+  return scratch.data();
+}
+
+// Both arrays, checked to be the same length.
+static std::pair<MalTypedArray*, MalTypedArray*> toArrays(const vector<MalType>& args)
+{
+  auto* a = toArray(args[0]);
+  auto* b = toArray(args[1]);
+
+  if(a->size() != b->size())
+  {
+    throw TypeException("Arrays of different lengths: " + std::to_string(a->size()) + " and " + std::to_string(b->size()));
+  }
+
+  return { a, b };
+}
+
+MalType MalIntArrayOperation::apply(const vector<MalType>& args)
+{
+  vector<int64_t> elements;
+  SeqCursor cursor(args[0]);
+  MalType value;
+
+  while(cursor.next(value))
+  {
+    auto* malInt = dynamic_cast<MalInt*>(&*value);
+
+    if(!malInt) throw TypeException("int-array takes 64-bit integers but got " + Printer::prStr(value, true));
+
+    elements.push_back(**malInt);
+  }
+
+  return MalType(new MalTypedArray(std::move(elements)));
+}
+
+MalType MalDoubleArrayOperation::apply(const vector<MalType>& args)
+{
+  vector<double> elements;
+  SeqCursor cursor(args[0]);
+  MalType value;
+
+  while(cursor.next(value))
+  {
+    elements.push_back(MalDouble::toDouble(value));
+  }
+
+  return MalType(new MalTypedArray(std::move(elements)));
+}
+
+MalType MalArraySumOperation::apply(const vector<MalType>& args)
+{
+  auto* array = toArray(args[0]);
+
+  if(array->elementType() == MalTypedArray::Float64)
+  {
+    return MalType(new MalDouble(kernels().sumDoubles(array->doubles().data(), array->size())));
+  }
+
+  int64_t sum;
+
+  if(kernels().sumInts(array->ints().data(), array->size(), sum)) return MalInt::of(sum);
+
+  __int128 wide = 0;
+
+  for(auto value : array->ints())
+  {
+    wide += value;
+  }
+
+  return fromInt128(wide);
+}
+
+static MalType minMax(const MalType& arg, bool wantMax)
+{
+  auto* array = toArray(arg);
+
+  if(array->size() == 0) return MNil;
+
+  if(array->elementType() == MalTypedArray::Int64)
+  {
+    int64_t min, max;
+    kernels().minMaxInts(array->ints().data(), array->size(), min, max);
+
+    return MalInt::of(wantMax ? max : min);
+  }
+
+  double min, max;
+  kernels().minMaxDoubles(array->doubles().data(), array->size(), min, max);
+
+  return MalType(new MalDouble(wantMax ? max : min));
+}
+
+MalType MalArrayMinOperation::apply(const vector<MalType>& args)
+{
+  return minMax(args[0], false);
+}
+
+MalType MalArrayMaxOperation::apply(const vector<MalType>& args)
+{
+  return minMax(args[0], true);
+}
+
+MalType MalArrayDotOperation::apply(const vector<MalType>& args)
+{
+  auto arrays = toArrays(args);
+
+  if(arrays.first->elementType() == MalTypedArray::Int64 && arrays.second->elementType() == MalTypedArray::Int64)
+  {
+    // AVX2 has no 64-bit multiply, so this one stays scalar, exact in 128 bits.
+    const auto& a = arrays.first->ints();
+    const auto& b = arrays.second->ints();
+    __int128 sum = 0;
+
+    for(size_t i = 0; i < a.size(); ++i)
+    {
+      if(__builtin_add_overflow(sum, static_cast<__int128>(a[i]) * b[i], &sum)) overflow("array-dot");
+    }
+
+    return fromInt128(sum);
+  }
+
+  vector<double> scratchA, scratchB;
+  auto* a = doubleData(arrays.first, scratchA);
+  auto* b = doubleData(arrays.second, scratchB);
+
+  return MalType(new MalDouble(kernels().dotDoubles(a, b, arrays.first->size())));
+}
+
+MalType MalArrayAddOperation::apply(const vector<MalType>& args)
+{
+  auto arrays = toArrays(args);
+
+  if(arrays.first->elementType() == MalTypedArray::Int64 && arrays.second->elementType() == MalTypedArray::Int64)
+  {
+    vector<int64_t> sum(arrays.first->size());
+    kernels().addInts(arrays.first->ints().data(), arrays.second->ints().data(), sum.data(), sum.size());
+
+    return MalType(new MalTypedArray(std::move(sum)));
+  }
+
+  vector<double> scratchA, scratchB;
+  vector<double> sum(arrays.first->size());
+
+  kernels().addDoubles(doubleData(arrays.first, scratchA), doubleData(arrays.second, scratchB), sum.data(), sum.size());
+
+  return MalType(new MalTypedArray(std::move(sum)));
+}
+
+MalType MalArrayMulOperation::apply(const vector<MalType>& args)
+{
+  auto arrays = toArrays(args);
+
+  if(arrays.first->elementType() == MalTypedArray::Int64 && arrays.second->elementType() == MalTypedArray::Int64)
+  {
+    const auto& a = arrays.first->ints();
+    const auto& b = arrays.second->ints();
+    vector<int64_t> product(a.size());
+
+    for(size_t i = 0; i < a.size(); ++i)
+    {
+      if(__builtin_mul_overflow(a[i], b[i], &product[i])) overflow("array-mul");
+    }
+
+    return MalType(new MalTypedArray(std::move(product)));
+  }
+
+  vector<double> scratchA, scratchB;
+  vector<double> product(arrays.first->size());
+
+  kernels().mulDoubles(doubleData(arrays.first, scratchA), doubleData(arrays.second, scratchB), product.data(), product.size());
+
+  return MalType(new MalTypedArray(std::move(product)));
+}
+
+MalType MalArrayScaleOperation::apply(const vector<MalType>& args)
+{
+  auto* array = toArray(args[0]);
+  auto* factor = dynamic_cast<MalInt*>(&*args[1]);
+
+  if(array->elementType() == MalTypedArray::Int64 && factor)
+  {
+    const auto& data = array->ints();
+    vector<int64_t> scaled(data.size());
+
+    for(size_t i = 0; i < data.size(); ++i)
+    {
+      if(__builtin_mul_overflow(data[i], **factor, &scaled[i])) overflow("array-scale");
+    }
+
+    return MalType(new MalTypedArray(std::move(scaled)));
+  }
+
+  vector<double> scratch;
+  vector<double> scaled(array->size());
+
+  kernels().scaleDoubles(doubleData(array, scratch), MalDouble::toDouble(args[1]), scaled.data(), scaled.size());
+
+  return MalType(new MalTypedArray(std::move(scaled)));
+}
+
+MalType MalArrayPrefixSumOperation::apply(const vector<MalType>& args)
+{
+  auto* array = toArray(args[0]);
+
+  if(array->elementType() == MalTypedArray::Int64)
+  {
+    // Each sum depends on the last and must be checked, so this one is scalar.
+    const auto& data = array->ints();
+    vector<int64_t> sums(data.size());
+    int64_t sum = 0;
+
+    for(size_t i = 0; i < data.size(); ++i)
+    {
+      if(__builtin_add_overflow(sum, data[i], &sum)) overflow("array-prefix-sum");
+
+      sums[i] = sum;
+    }
+
+    return MalType(new MalTypedArray(std::move(sums)));
+  }
+
+  vector<double> sums(array->size());
+  kernels().prefixSumDoubles(array->doubles().data(), sums.data(), sums.size());
+
+  return MalType(new MalTypedArray(std::move(sums)));
+}
+
+// Sorts (value, index) pairs, which keeps each comparison within one
+// contiguous buffer, then keeps the indices.
+template<class T, class Before>
+static vector<int64_t> argsort(const vector<T>& data, Before before)
+{
+  vector<std::pair<T, int64_t>> pairs(data.size());
+
+  for(size_t i = 0; i < data.size(); ++i)
+  {
+    pairs[i] = { data[i], static_cast<int64_t>(i) };
+  }
+
+  std::sort(pairs.begin(), pairs.end(), [&](const std::pair<T, int64_t>& x, const std::pair<T, int64_t>& y) {
+    if(before(x.first, y.first)) return true;
+    if(before(y.first, x.first)) return false;
+
+    return x.second < y.second;
+  });
+
+  vector<int64_t> indices(pairs.size());
+
+  for(size_t i = 0; i < pairs.size(); ++i)
+  {
+    indices[i] = pairs[i].second;
+  }
+
+  return indices;
+}
+
+MalType MalArrayArgsortOperation::apply(const vector<MalType>& args)
+{
+  auto* array = toArray(args[0]);
+
+  if(array->elementType() == MalTypedArray::Int64)
+  {
+    return MalType(new MalTypedArray(argsort(array->ints(), std::less<int64_t>())));
+  }
+
+  return MalType(new MalTypedArray(argsort(array->doubles(), [](double x, double y) {
+    return std::isnan(x) ? false : std::isnan(y) || x < y;
+  })));
+}
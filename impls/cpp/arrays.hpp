@@ -0,0 +1,149 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstdint>
+
+// A fixed-size array of unboxed int64 or float64 elements in one contiguous
+// buffer, built with (int-array coll) or (double-array coll). count and nth
+// read it directly; every other sequence function sees its elements boxed,
+// through its cursor. The array-* functions run native kernels over the
+// buffer, using AVX2 when the CPU has it.
+class MalTypedArray : public MalTypeData
+{
+public:
+  enum ElementType { Int64, Float64 };
+
+private:
+  ElementType type_;
+  vector<int64_t> ints_;
+  vector<double> doubles_;
+
+public:
+  explicit MalTypedArray(vector<int64_t> ints): type_(Int64), ints_(std::move(ints)) {}
+  explicit MalTypedArray(vector<double> doubles): type_(Float64), doubles_(std::move(doubles)) {}
+
+  virtual string getString(bool printReadably) override;
+
+  virtual bool equals(const MalType& other) const override;
+
+  virtual MalType deepCopy() const override;
+
+  virtual shared_ptr<Cursor> cursor(const MalType& self) override;
+
+  virtual void traverse(HeapVisitor& visitor) const override;
+
+  ElementType elementType() const { return type_; }
+  size_t size() const { return type_ == Int64 ? ints_.size() : doubles_.size(); }
+
+  const vector<int64_t>& ints() const { return ints_; }
+  const vector<double>& doubles() const { return doubles_; }
+
+  // The elements as doubles, converting an int64 array.
+  vector<double> toDoubles() const;
+
+  // Element index boxed as a MalInt or MalDouble.
+  MalType nth(size_t index) const;
+
+  // "avx2" or "scalar": the kernels this process runs. Setting MAL_SIMD to
+  // "scalar" forces the fallback.
+  static const char* instructionSet();
+};
+
+class MalIntArrayOperation : public MalOperation
+{
+public:
+  MalIntArrayOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalDoubleArrayOperation : public MalOperation
+{
+public:
+  MalDoubleArrayOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (array-sum a). An int64 sum that overflows comes back as a bignum.
+class MalArraySumOperation : public MalOperation
+{
+public:
+  MalArraySumOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (array-min a) and (array-max a); nil for an empty array.
+class MalArrayMinOperation : public MalOperation
+{
+public:
+  MalArrayMinOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalArrayMaxOperation : public MalOperation
+{
+public:
+  MalArrayMaxOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (array-dot a b) of two arrays of the same length.
+class MalArrayDotOperation : public MalOperation
+{
+public:
+  MalArrayDotOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (array-add a b) and (array-mul a b) work elementwise and return a new
+// array: int64 if both are, float64 otherwise. An int64 element that
+// overflows throws.
+class MalArrayAddOperation : public MalOperation
+{
+public:
+  MalArrayAddOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalArrayMulOperation : public MalOperation
+{
+public:
+  MalArrayMulOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (array-scale a k) multiplies every element by the number k.
+class MalArrayScaleOperation : public MalOperation
+{
+public:
+  MalArrayScaleOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (array-prefix-sum a): element i is the sum of elements 0 to i.
+class MalArrayPrefixSumOperation : public MalOperation
+{
+public:
+  MalArrayPrefixSumOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (array-argsort a): an int64 array of the indices that would sort a,
+// stable, with NaNs last.
+class MalArrayArgsortOperation : public MalOperation
+{
+public:
+  MalArrayArgsortOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
@@ -0,0 +1,61 @@
+// Summing a million numbers: (apply + v) over a vector of boxed MalInts
+// against array-sum over an int-array and a double-array, plus the other
+// double kernels. Run with MAL_SIMD=scalar to compare against the scalar
+// fallbacks.
+
+#include "../interpreter.hpp"
+#include "../arrays.hpp"
+#include "bench.hpp"
+
+int main(int argc, char* argv[])
+{
+  int count = argc > 1 ? std::stoi(argv[1]) : 1000000;
+  int rounds = argc > 2 ? std::stoi(argv[2]) : 200;
+
+  Interpreter interpreter;
+
+  interpreter.eval("(def! v (vec (range " + std::to_string(count) + ")))");
+  interpreter.eval("(def! a (int-array v))");
+  interpreter.eval("(def! d (double-array v))");
+
+  printf("kernels: %s\n", MalTypedArray::instructionSet());
+
+  // Each form, and whether it returns the sum of v. The boxed ones get a
+  // tenth of the rounds.
+  const std::pair<const char*, bool> cases[] = {
+    { "(apply + v)", true },
+    { "(reduce + v)", true },
+    { "(array-sum a)", true },
+    { "(array-sum d)", true },
+    { "(array-dot d d)", false },
+    { "(array-max a)", false },
+    { "(array-prefix-sum d)", false },
+    { "(array-scale d 0.5)", false }
+  };
+
+  string sum = std::to_string(static_cast<int64_t>(count) * (count - 1) / 2);
+
+  for(const auto& item : cases)
+  {
+    int times = string(item.first).find("array") == string::npos ? rounds / 10 : rounds;
+    Stopwatch watch;
+    MalType result;
+
+    for(int i = 0; i < times; ++i)
+    {
+      result = interpreter.eval(item.first);
+    }
+
+    report(item.first, static_cast<double>(count) * times, watch.seconds(), "elements");
+
+    auto printed = result->getString(true);
+
+    if(item.second && printed != sum && printed != sum + ".0")
+    {
+      printf("expected %s but got %s\n", sum.c_str(), printed.c_str());
+      return 1;
+    }
+  }
+
+  return 0;
+}
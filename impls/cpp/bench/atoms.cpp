@@ -0,0 +1,88 @@
+// Contention on a single atom: every thread increments the same counter,
+// once through MalAtom::swap from C++ and once through (swap! counter inc)
+// in pooled interpreters. The final count checks that no update was lost.
+
+#include "../pool.hpp"
+#include "../types.hpp"
+#include "bench.hpp"
+
+static int count(const MalType& atom)
+{
+  return Interpreter::toInt(**dynamic_cast<MalAtom*>(&*atom));
+}
+
+static bool check(const MalType& atom, int expected)
+{
+  if(count(atom) == expected) return true;
+
+  printf("lost updates: expected %d, got %d\n", expected, count(atom));
+
+  return false;
+}
+
+int main(int argc, char* argv[])
+{
+  size_t threads = argc > 1 ? std::stoul(argv[1]) : 16;
+  int increments = argc > 2 ? std::stoi(argv[2]) : 20000;
+  int expected = threads * increments;
+
+  printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+
+  {
+    MalType atom(new MalAtom(Interpreter::toMal(0)));
+    auto* counter = dynamic_cast<MalAtom*>(&*atom);
+    vector<std::thread> workers;
+
+    Stopwatch watch;
+
+    for(size_t i = 0; i < threads; ++i)
+    {
+      workers.emplace_back([=] {
+        for(int n = 0; n < increments; ++n)
+        {
+          counter->swap([](const MalType& value) { return Interpreter::toMal(Interpreter::toInt(value) + 1); });
+        }
+      });
+    }
+
+    for(auto& worker : workers)
+    {
+      worker.join();
+    }
+
+    report(std::to_string(threads) + " threads, MalAtom::swap", expected, watch.seconds(), "increments");
+
+    if(!check(atom, expected)) return 1;
+  }
+
+  {
+    MalType atom(new MalAtom(Interpreter::toMal(0)));
+
+    InterpreterPool pool(threads, [&](Interpreter& interpreter) {
+      interpreter.getEnv()->set("counter", atom);
+      interpreter.eval("(def! inc (fn* [n] (+ n 1)))");
+      interpreter.eval("(def! run (fn* [n] (if (> n 0) (do (swap! counter inc) (run (- n 1))) nil)))");
+    });
+
+    string job = "(run " + std::to_string(increments) + ")";
+    vector<std::future<MalType>> results;
+
+    Stopwatch watch;
+
+    for(size_t i = 0; i < threads; ++i)
+    {
+      results.push_back(pool.submit(job));
+    }
+
+    for(auto& result : results)
+    {
+      result.get();
+    }
+
+    report(std::to_string(threads) + " threads, (swap! counter inc)", expected, watch.seconds(), "increments");
+
+    if(!check(atom, expected)) return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using std::string;
+
+class Stopwatch
+{
+  std::chrono::steady_clock::time_point start_;
+
+public:
+  Stopwatch(): start_(std::chrono::steady_clock::now()) {}
+
+  double seconds() const
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+  }
+};
+
+inline void report(const string& name, const double& count, const double& seconds, const string& unit = "ops")
+{
+  printf("%-40s %14.0f %s/s  (%.3f s)\n", name.c_str(), count / seconds, unit.c_str(), seconds);
+}
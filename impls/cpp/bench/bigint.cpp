@@ -0,0 +1,92 @@
+// Integer arithmetic: native + on small ints (served from the MalInt cache,
+// no allocation), on 64-bit ints outside it, and on results that overflow
+// into bignums; then BigInt multiplication at growing sizes, where
+// Karatsuba's ~n^1.58 shows as roughly 3x per doubling instead of 4x.
+
+#include "../interpreter.hpp"
+#include "../bigint.hpp"
+#include "../numbers.hpp"
+#include "bench.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if(void* block = std::malloc(size ? size : 1)) return block;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept
+{
+  std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+  std::free(block);
+}
+
+static void add(const string& name, const MalType& a, const MalType& b, int count)
+{
+  MalAddOperation plus;
+  vector<MalType> args = { a, b };
+  size_t before = allocations.load();
+  Stopwatch watch;
+
+  for(int i = 0; i < count; ++i)
+  {
+    plus.apply(args);
+  }
+
+  double seconds = watch.seconds();
+
+  report(name, count, seconds);
+  printf("%-40s %14.2f allocations/op\n", "", static_cast<double>(allocations.load() - before) / count);
+}
+
+static BigInt digits(size_t count)
+{
+  return BigInt::parse(string(count, '7'));
+}
+
+int main(int argc, char* argv[])
+{
+  int count = argc > 1 ? std::stoi(argv[1]) : 5000000;
+
+  add("small ints", MalInt::of(3), MalInt::of(4), count);
+  add("64-bit ints", MalInt::of(1ll << 40), MalInt::of(1ll << 41), count);
+  add("overflowing into a bignum", MalInt::of(INT64_MAX), MalInt::of(INT64_MAX), count / 10);
+
+  for(size_t size = 2000; size <= 32000; size *= 2)
+  {
+    auto a = digits(size);
+    auto b = digits(size);
+    int rounds = static_cast<int>(1000000 / size);
+    Stopwatch watch;
+
+    for(int i = 0; i < rounds; ++i)
+    {
+      a * b;
+    }
+
+    report(std::to_string(size) + "-digit multiply", rounds, watch.seconds());
+  }
+
+  Interpreter interpreter;
+
+  interpreter.eval("(def! fact (fn* (n acc) (if (< n 2) acc (fact (- n 1) (* n acc)))))");
+
+  Stopwatch watch;
+  auto result = interpreter.eval("(fact 3000 1)");
+
+  report("(fact 3000)", 1, watch.seconds(), "runs");
+
+  return result->getString(true).size() == 9131 ? 0 : 1;
+}
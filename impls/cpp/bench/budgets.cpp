@@ -0,0 +1,121 @@
+// Allocation budgets: the most heap allocations each hot operation may make
+// per call, counted by replacing operator new. Exits 1 if any operation
+// goes over its budget, so `make budgets` catches a change that starts
+// copying vectors, strings or maps where they used to be shared. The
+// budgets are what the operations need today: lower one when an
+// optimization gets below it, and never raise one without a reason.
+
+#include "../interpreter.hpp"
+#include "../printer.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if(void* block = std::malloc(size ? size : 1)) return block;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept
+{
+  std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+  std::free(block);
+}
+
+struct Budget
+{
+  string name;
+  std::function<void()> run;
+  double maxAllocations;
+};
+
+static const int iterations = 1000;
+
+static const char* setup[] = {
+  "(def! l (list 1 2 3 4 5 6 7 8 9 10))",
+  "(def! v [1 2 3 4 5 6 7 8 9 10])",
+  "(def! m {:a 1 :b 2 :c 3})",
+  "(def! x 7)",
+  "(def! inc1 (fn* (n) (+ n 1)))"
+};
+
+int main()
+{
+  std::ostream discard(nullptr);
+  Interpreter interpreter(discard);
+
+  for(const auto* form : setup)
+  {
+    interpreter.eval(form);
+  }
+
+  // A core function called directly with arguments evaluated once, up front.
+  auto call = [&](const string& name, const string& args) -> std::function<void()> {
+    auto operation = std::dynamic_pointer_cast<MalOperation>(interpreter.getEnv()->get(name));
+    auto values = Interpreter::toVector(interpreter.eval(args));
+
+    return [operation, values] { operation->apply(values); };
+  };
+
+  // A form read once and evaluated each time.
+  auto eval = [&](const string& source) -> std::function<void()> {
+    auto ast = interpreter.read(source);
+    Interpreter* target = &interpreter;
+
+    return [target, ast] { target->eval(ast); };
+  };
+
+  const Budget budgets[] = {
+    { "first", call("first", "[l]"), 0 },
+    { "rest", call("rest", "[l]"), 3 },
+    { "nth", call("nth", "[v 5]"), 0 },
+    { "count", call("count", "[v]"), 0 },
+    { "get", call("get", "[m :b]"), 0 },
+    { "assoc", call("assoc", "[m :d 4]"), 6 },
+    { "+", call("+", "[1 2]"), 0 },
+    { "symbol lookup", eval("x"), 0 },
+    { "user function call", eval("(inc1 5)"), 5 }
+  };
+
+  int failures = 0;
+
+  printf("%-24s %12s %10s\n", "operation", "allocs/op", "budget");
+
+  for(const auto& budget : budgets)
+  {
+    // Once first, so caches and interned names are in place.
+    budget.run();
+
+    size_t before = allocations.load();
+
+    for(int i = 0; i < iterations; ++i)
+    {
+      budget.run();
+    }
+
+    double perCall = static_cast<double>(allocations.load() - before) / iterations;
+    bool over = perCall > budget.maxAllocations;
+
+    printf("%-24s %12.2f %10.0f%s\n", budget.name.c_str(), perCall, budget.maxAllocations, over ? "  OVER BUDGET" : "");
+
+    if(over) ++failures;
+  }
+
+  if(failures) fprintf(stderr, "%d operation(s) over their allocation budget\n", failures);
+
+  return failures ? 1 : 0;
+}
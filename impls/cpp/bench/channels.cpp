@@ -0,0 +1,74 @@
+// 100k go blocks ping-ponging over unbuffered channels: half send a
+// counter and wait for the echo, the other half echo it back. Every block
+// is alive at once, so this also shows what a parked go block costs.
+
+#include "../interpreter.hpp"
+#include "bench.hpp"
+
+#include <fstream>
+#include <thread>
+
+static const char* setup[] = {
+  "(def! pinger (fn* (a b n) (if (> n 0) (do (>! a n) (<! b) (pinger a b (- n 1))) (close! a))))",
+  "(def! ponger (fn* (a b) (let* (v (<! a)) (if v (do (>! b v) (ponger a b)) :done))))",
+  "(def! pair (fn* (n) (let* (a (chan) b (chan)) (do (go (pinger a b n)) (go (ponger a b))))))"
+};
+
+static string peakMemory()
+{
+  std::ifstream status("/proc/self/status");
+  string line;
+
+  while(std::getline(status, line))
+  {
+    if(line.rfind("VmHWM:", 0) == 0) return line.substr(6);
+  }
+
+  return "?";
+}
+
+int main(int argc, char* argv[])
+{
+  int tasks = argc > 1 ? std::stoi(argv[1]) : 100000;
+  int rounds = argc > 2 ? std::stoi(argv[2]) : 10;
+  int pairs = tasks / 2;
+
+  printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+
+  Interpreter interpreter;
+
+  for(const auto* form : setup)
+  {
+    interpreter.eval(form);
+  }
+
+  auto pair = interpreter.getEnv()->get("pair");
+  auto take = interpreter.getEnv()->get("<!");
+  vector<MalType> done;
+
+  Stopwatch watch;
+
+  for(int i = 0; i < pairs; ++i)
+  {
+    done.push_back(interpreter.call(pair, { Interpreter::toMal(rounds) }));
+  }
+
+  double spawned = watch.seconds();
+
+  for(const auto& channel : done)
+  {
+    if(interpreter.call(take, { channel }) == MNil)
+    {
+      printf("a ponger finished without its result\n");
+      return 1;
+    }
+  }
+
+  double seconds = watch.seconds();
+
+  report(std::to_string(tasks) + " go blocks started", tasks, spawned, "blocks");
+  report(std::to_string(rounds) + " round trips each", 2.0 * pairs * rounds, seconds, "messages");
+  printf("peak resident memory: %s\n", peakMemory().c_str());
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+// Interpreter lifecycle throughput: how many independent instances can be
+// created, used for a small program and torn down per second. Also fails
+// if resident memory grows across create/destroy cycles, since a reference
+// cycle an interpreter doesn't break keeps its whole environment alive.
+
+#include "../interpreter.hpp"
+#include "bench.hpp"
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+static const char* program = "(do (def! fib (fn* (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))) (fib 10))";
+
+// Growth above this, per interpreter, means instances aren't being freed;
+// one leaks about 31 KB.
+static const long maxRetainedBytes = 256;
+
+static long residentKilobytes()
+{
+  std::ifstream status("/proc/self/status");
+  string line;
+
+  while(std::getline(status, line))
+  {
+    if(line.rfind("VmRSS:", 0) == 0) return std::stol(line.substr(6));
+  }
+
+  return -1;
+}
+
+int main(int argc, char* argv[])
+{
+  int count = argc > 1 ? std::stoi(argv[1]) : 2000;
+  std::ostringstream sink;
+
+  {
+    Stopwatch watch;
+
+    for(int i = 0; i < count; ++i)
+    {
+      Interpreter interpreter(sink);
+    }
+
+    report("create+destroy", count, watch.seconds(), "interpreters");
+  }
+
+  {
+    Stopwatch watch;
+
+    for(int i = 0; i < count; ++i)
+    {
+      Interpreter interpreter(sink);
+      interpreter.eval(program);
+    }
+
+    report("create+eval (fib 10)+destroy", count, watch.seconds(), "interpreters");
+  }
+
+  {
+    vector<std::unique_ptr<Interpreter>> live;
+    live.reserve(count);
+
+    Stopwatch watch;
+
+    for(int i = 0; i < count; ++i)
+    {
+      live.emplace_back(new Interpreter(sink));
+      live.back()->eval("(def! tenant-state (atom 0))");
+    }
+
+    live.clear();
+
+    report("create all, then destroy all", count, watch.seconds(), "interpreters");
+  }
+
+  // The runs above have grown the heap to its working size; from here it
+  // should stay put.
+  long before = residentKilobytes();
+
+  for(int i = 0; i < count; ++i)
+  {
+    Interpreter interpreter(sink);
+    interpreter.eval(program);
+    interpreter.eval("(def! tenant-state (atom {:handler (fn* (x) x)}))");
+  }
+
+  long retained = (residentKilobytes() - before) * 1024 / count;
+
+  printf("%-40s %14ld bytes/interpreter\n", "retained after destroy", retained);
+
+  if(retained > maxRetainedBytes)
+  {
+    fprintf(stderr, "interpreters are not being freed: %ld bytes retained each\n", retained);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,72 @@
+// Peak memory of summing a mapped range with first/rest, streamed lazily
+// against first materializing it into a list. Each form runs in a child
+// process so one run's peak doesn't hide the other's.
+
+#include "../interpreter.hpp"
+#include "bench.hpp"
+
+#include <fstream>
+
+static const char* sum = "(def! sum (fn* (s acc) (if (empty? s) acc (sum (rest s) (+ acc (first s))))))";
+
+static const char* forms[] = {
+  "(sum (map (fn* (x) (- x (* 2 (/ x 2)))) (range N)) 0)",
+  "(count (apply list (map (fn* (x) (- x (* 2 (/ x 2)))) (range N))))"
+};
+
+static const char* names[] = { "streamed map/range", "materialized list" };
+
+static long peakKilobytes()
+{
+  std::ifstream status("/proc/self/status");
+  string line;
+
+  while(std::getline(status, line))
+  {
+    if(line.rfind("VmHWM:", 0) == 0) return std::stol(line.substr(6));
+  }
+
+  return -1;
+}
+
+static int child(int form, const string& size)
+{
+  Interpreter interpreter;
+  interpreter.eval(sum);
+
+  string code = forms[form];
+  code.replace(code.find('N'), 1, size);
+
+  Stopwatch watch;
+  interpreter.eval(code);
+  printf("%f %ld\n", watch.seconds(), peakKilobytes());
+
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc > 3 && string(argv[1]) == "--child") return child(std::stoi(argv[2]), argv[3]);
+
+  string size = argc > 1 ? argv[1] : "1000000";
+
+  printf("%s elements\n", size.c_str());
+
+  for(int form = 0; form < 2; ++form)
+  {
+    string command = string(argv[0]) + " --child " + std::to_string(form) + " " + size;
+    FILE* output = popen(command.c_str(), "r");
+    double seconds;
+    long peak;
+
+    if(!output || fscanf(output, "%lf %ld", &seconds, &peak) != 2 || pclose(output) != 0)
+    {
+      printf("%s failed\n", names[form]);
+      return 1;
+    }
+
+    printf("%-24s %8.3f s  peak %8ld KB\n", names[form], seconds, peak);
+  }
+
+  return 0;
+}
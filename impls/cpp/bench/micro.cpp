@@ -0,0 +1,478 @@
+// Microbenchmarks for the interpreter's building blocks: the reader and the
+// printer on synthetic inputs, environment lookups through chains of
+// growing depth, every core operation called directly, the timed bodies of
+// tests/perf1-3.mal and a latency sample as rep() takes it. Each case
+// reports the median ns/op of several batches, the spread between batches
+// as noise, heap allocations and bytes per op, and MB/s where it reads or
+// writes text.
+//
+//   micro [--filter text] [--json out.json] [--compare base.json]
+//         [--threshold pct]
+//
+// --compare exits 1 when a case got slower than the baseline by more than
+// the threshold (10% by default) or either run's noise, whichever is
+// larger, or when it allocates over 1% more per op. Timings only compare
+// well between runs on a quiet machine. Run from impls/cpp so the perf
+// tests' load-file paths resolve.
+
+#include "../interpreter.hpp"
+#include "../core.hpp"
+#include "../reader.hpp"
+#include "../printer.hpp"
+#include "../env.hpp"
+#include "../latency.hpp"
+#include "bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <new>
+#include <regex>
+#include <sstream>
+
+static std::atomic<size_t> allocations(0);
+static std::atomic<size_t> allocatedBytes(0);
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+  if(void* block = std::malloc(size ? size : 1)) return block;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept
+{
+  std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+  std::free(block);
+}
+
+struct Case
+{
+  string name;
+  std::function<void()> body;
+  double textBytes;
+};
+
+struct Result
+{
+  string name;
+  double nsPerOp;
+  double minNs;
+  double noise;
+  double allocsPerOp;
+  double bytesPerOp;
+  double mbPerSecond;
+};
+
+static double timeBatch(const Case& item, size_t batch)
+{
+  Stopwatch watch;
+
+  for(size_t i = 0; i < batch; ++i)
+  {
+    item.body();
+  }
+
+  return watch.seconds();
+}
+
+// Grows the batch until one takes 10 ms, then times seven of them.
+static Result measure(const Case& item)
+{
+  size_t batch = 1;
+
+  while(timeBatch(item, batch) < 0.01 && batch < (size_t(1) << 30)) batch *= 2;
+
+  const int rounds = 7;
+  vector<double> samples;
+  size_t allocationsBefore = allocations.load();
+  size_t bytesBefore = allocatedBytes.load();
+
+  for(int i = 0; i < rounds; ++i)
+  {
+    samples.push_back(timeBatch(item, batch) * 1e9 / batch);
+  }
+
+  double ops = static_cast<double>(batch) * rounds;
+  double allocs = (allocations.load() - allocationsBefore) / ops;
+  double bytes = (allocatedBytes.load() - bytesBefore) / ops;
+
+  std::sort(samples.begin(), samples.end());
+
+  double median = samples[rounds / 2];
+  double noise = median > 0 ? (samples[rounds - 2] - samples[1]) / median : 0;
+  double mbPerSecond = item.textBytes > 0 ? item.textBytes / median * 1e3 : 0;
+
+  return { item.name, median, samples[0], noise, allocs, bytes, mbPerSecond };
+}
+
+static string repeat(const string& text, int times)
+{
+  string out;
+
+  for(int i = 0; i < times; ++i)
+  {
+    out += text;
+  }
+
+  return out;
+}
+
+static void addReaderCases(vector<Case>& cases)
+{
+  const std::pair<const char*, string> inputs[] = {
+    { "small form", "(+ 1 (* 2 3))" },
+    { "1000 ints", "[" + repeat("12345 ", 1000) + "]" },
+    { "nested 200 deep", repeat("(a ", 200) + repeat(")", 200) },
+    { "strings", "(" + repeat("\"a \\\"quoted\\\" line\\n\" ", 200) + ")" },
+    { "maps", "[" + repeat("{:name \"x\" :size 3 :tags [:a :b]} ", 200) + "]" },
+    { "program", "(do " + repeat("(def! f (fn* (n acc) (if (<= n 0) acc (f (- n 1) (+ acc n))))) ", 100) + ")" }
+  };
+
+  for(const auto& input : inputs)
+  {
+    string text = input.second;
+
+    cases.push_back({ string("read/") + input.first, [text] { Tokenizer::readStr(text); }, static_cast<double>(text.size()) });
+  }
+}
+
+static void addPrinterCases(vector<Case>& cases, Interpreter& interpreter)
+{
+  const std::pair<const char*, const char*> values[] = {
+    { "10000 ints", "(vec (range 10000))" },
+    { "nested vectors", "(vec (map (fn* (i) [i [i [i]]]) (range 1000)))" },
+    { "strings", "(vec (map (fn* (i) (str \"line \\\"\" i \"\\\"\\n\")) (range 1000)))" },
+    { "maps", "(vec (map (fn* (i) {:id i :name (str \"n\" i)}) (range 1000)))" }
+  };
+
+  for(const auto& value : values)
+  {
+    auto mal = interpreter.eval(value.second);
+    auto size = static_cast<double>(Printer::prStr(mal, true).size());
+
+    cases.push_back({ string("print/") + value.first, [mal] { Printer::prStr(mal, true); }, size });
+  }
+}
+
+static void addEnvCases(vector<Case>& cases, Interpreter& interpreter)
+{
+  for(int depth : { 0, 1, 4, 16, 64 })
+  {
+    Env env = interpreter.getEnv();
+
+    for(int i = 0; i < depth; ++i)
+    {
+      env = Env(new EnvData(env));
+      env->set("local" + std::to_string(i), MalInt::of(i));
+    }
+
+    cases.push_back({ "env/get at depth " + std::to_string(depth), [env] { env->get("+"); }, 0 });
+  }
+}
+
+// Arguments for each core operation, as mal source; setup defines what
+// they refer to. Ops that read stdin, throw by design or act on the whole
+// process are left out and listed as skipped.
+static const char* setup[] = {
+  "(def! l (list 1 2 3 4 5 6 7 8 9 10))",
+  "(def! v [1 2 3 4 5 6 7 8 9 10])",
+  "(def! m {:a 1 :b 2 :c 3})",
+  "(def! s \"hello world\")",
+  "(def! at (atom 0))",
+  "(def! inc1 (fn* (x) (+ x 1)))",
+  "(def! add (fn* (a b) (+ a b)))",
+  "(def! watcher (fn* (& _) nil))",
+  "(def! closed (chan))",
+  "(close! closed)",
+  "(def! sliding (chan (sliding-buffer 1)))",
+  "(def! p (promise))",
+  "(def! t (transient {:a 1}))",
+  "(def! tv (transient []))",
+  "(def! ia (int-array (range 1000)))",
+  "(def! da (double-array (range 1000)))"
+};
+
+static const std::map<string, const char*> coreArgs = {
+  { "prn", "[1 \"a\"]" }, { "println", "[1 \"a\"]" }, { "pr-str", "[v m]" }, { "str", "[1 \"a\" :k]" },
+  { "list", "[1 2 3]" }, { "list?", "[l]" }, { "empty?", "[l]" }, { "count", "[v]" },
+  { "=", "[l v]" }, { "<", "[1 2 3]" }, { "<=", "[1 2 3]" }, { ">", "[3 2 1]" }, { ">=", "[3 2 1]" },
+  { "+", "[1 2]" }, { "-", "[3 2]" }, { "*", "[3 2]" }, { "/", "[6 2]" },
+  { "read-string", "[\"(+ 1 2)\"]" }, { "slurp", "[\"../tests/perf1.mal\"]" }, { "eval", "['(+ 1 2)]" },
+  { "atom", "[1]" }, { "atom?", "[at]" }, { "deref", "[at]" }, { "reset!", "[at 1]" },
+  { "swap!", "[at inc1]" }, { "swap-vals!", "[at inc1]" }, { "compare-and-set!", "[at 1 1]" },
+  { "add-watch", "[at :k watcher]" }, { "remove-watch", "[at :k]" },
+  { "cons", "[0 l]" }, { "concat", "[l v]" }, { "vec", "[l]" }, { "seq", "[v]" }, { "conj", "[v 11]" },
+  { "int-array", "[v]" }, { "double-array", "[v]" }, { "array-sum", "[ia]" }, { "array-min", "[da]" },
+  { "array-max", "[da]" }, { "array-dot", "[da da]" }, { "array-add", "[ia ia]" }, { "array-mul", "[da da]" },
+  { "array-scale", "[da 2.0]" }, { "array-prefix-sum", "[ia]" }, { "array-argsort", "[da]" },
+  { "nth", "[v 5]" }, { "first", "[l]" }, { "rest", "[l]" }, { "apply", "[add 1 [2]]" }, { "map", "[inc1 v]" },
+  { "nil?", "[nil]" }, { "true?", "[true]" }, { "false?", "[false]" }, { "symbol?", "['a]" },
+  { "symbol", "[\"a\"]" }, { "keyword", "[\"a\"]" }, { "keyword?", "[:a]" }, { "vector", "[1 2 3]" },
+  { "vector?", "[v]" }, { "sequential?", "[l]" }, { "hash-map", "[:a 1 :b 2]" }, { "map?", "[m]" },
+  { "assoc", "[m :d 4]" }, { "dissoc", "[m :a]" }, { "get", "[m :b]" }, { "contains?", "[m :c]" },
+  { "keys", "[m]" }, { "vals", "[m]" }, { "string?", "[s]" }, { "number?", "[1]" }, { "fn?", "[inc1]" },
+  { "macro?", "[inc1]" }, { "time-ms", "[]" }, { "time-ns", "[]" }, { "run-in-thread", "['(+ 1 2)]" },
+  { "future-call", "[(fn* () 1)]" }, { "promise", "[]" }, { "deliver", "[p 1]" }, { "realized?", "[p]" },
+  { "pmap", "[inc1 v]" }, { "pfold", "[+ + 0 v]" }, { "preduce", "[+ 0 v]" }, { "psort", "[v]" },
+  { "chan", "[]" }, { "sliding-buffer", "[1]" }, { "dropping-buffer", "[1]" }, { "<!", "[closed]" },
+  { ">!", "[sliding 1]" }, { "close!", "[closed]" }, { "alts!", "[[closed]]" }, { "timeout", "[1000]" },
+  { "go-call", "[(fn* () 1)]" }, { "transient", "[m]" }, { "persistent!", "[t]" }, { "assoc!", "[t :b 2]" },
+  { "conj!", "[tv 1]" }, { "dissoc!", "[t :b]" }, { "pop!", "[tv]" }, { "lazy-seq-call", "[(fn* () l)]" },
+  { "filter", "[inc1 v]" }, { "range", "[10]" }, { "iterate", "[inc1 0]" }, { "take", "[5 v]" },
+  { "drop", "[5 v]" }, { "reduce", "[+ 0 v]" }, { "transduce", "[(map inc1) + 0 v]" },
+  { "reduced", "[1]" }, { "reduced?", "[1]" }, { "comp", "[inc1 inc1]" }, { "partition-all", "[2 v]" },
+  { "dedupe", "[]" }, { "latency-stats", "[]" }, { "heap-census", "[]" }, { "deep-size", "[m]" },
+  { "retainers", "[m]" }
+};
+
+static void addCoreCases(vector<Case>& cases, vector<string>& skipped, Interpreter& interpreter)
+{
+  for(const auto* form : setup)
+  {
+    interpreter.eval(form);
+  }
+
+  for(const auto& pair : Core::ns(interpreter))
+  {
+    auto found = coreArgs.find(pair.first);
+    auto operation = std::dynamic_pointer_cast<MalOperation>(interpreter.getEnv()->get(pair.first));
+
+    if(!operation) continue;
+
+    if(found == coreArgs.end())
+    {
+      skipped.push_back(pair.first);
+      continue;
+    }
+
+    auto args = Interpreter::toVector(interpreter.eval(found->second));
+
+    cases.push_back({ "core/" + pair.first, [operation, args] { operation->apply(args); }, 0 });
+  }
+}
+
+// The forms tests/perf1-3.mal time, after loading what they load.
+static void addEvalCases(vector<Case>& cases, Interpreter& interpreter)
+{
+  const char* loads[] = {
+    "(load-file \"../lib/load-file-once.mal\")",
+    "(load-file-once \"../lib/threading.mal\")",
+    "(load-file-once \"../lib/test_cascade.mal\")",
+    "(load-file-once \"../tests/computations.mal\")",
+    "(def! atm (atom (list 0 1 2 3 4 5 6 7 8 9)))"
+  };
+
+  for(const auto* form : loads)
+  {
+    interpreter.eval(form);
+  }
+
+  const std::pair<const char*, const char*> forms[] = {
+    { "eval/perf1", "(do (or false nil false nil false nil false nil false nil 4) "
+                    "(cond false 1 nil 2 false 3 nil 4 false 5 nil 6 \"else\" 7) "
+                    "(-> (list 1 2 3 4 5 6 7 8 9) rest rest rest rest rest rest first))" },
+    { "eval/perf2", "(do (sumdown 10) (fib 12))" },
+    { "eval/perf3", "(do (or false nil false nil false nil false nil false nil (first @atm)) "
+                    "(cond false 1 nil 2 false 3 nil 4 false 5 nil 6 \"else\" (first @atm)) "
+                    "(-> (deref atm) rest rest rest rest rest rest first) "
+                    "(swap! atm (fn* [a] (concat (rest a) (list (first a))))))" }
+  };
+
+  for(const auto& form : forms)
+  {
+    auto ast = interpreter.read(form.second);
+    Interpreter* target = &interpreter;
+
+    cases.push_back({ form.first, [target, ast] { target->eval(ast); }, 0 });
+  }
+}
+
+// What rep() adds per phase: one clock read (the next phase starts from
+// it) and one histogram record.
+static void addLatencyCases(vector<Case>& cases)
+{
+  auto histogram = std::make_shared<LatencyHistogram>();
+  auto last = std::make_shared<int64_t>(LatencyHistogram::now());
+
+  cases.push_back({ "latency/sample", [histogram, last] {
+    auto now = LatencyHistogram::now();
+    histogram->record(now - *last);
+    *last = now;
+  }, 0 });
+}
+
+static string toJson(const vector<Result>& results)
+{
+  std::ostringstream out;
+
+  out << "{\n  \"cases\": [\n";
+
+  for(size_t i = 0; i < results.size(); ++i)
+  {
+    const auto& result = results[i];
+    char line[512];
+
+    snprintf(line, sizeof(line),
+             "    {\"name\": \"%s\", \"ns_per_op\": %.2f, \"min_ns\": %.2f, \"noise\": %.4f, \"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f, \"mb_per_s\": %.2f}%s\n",
+             result.name.c_str(), result.nsPerOp, result.minNs, result.noise, result.allocsPerOp, result.bytesPerOp,
+             result.mbPerSecond, i + 1 < results.size() ? "," : "");
+    out << line;
+  }
+
+  out << "  ]\n}\n";
+
+  return out.str();
+}
+
+// Reads back what toJson wrote, one case per line.
+static std::map<string, Result> readBaseline(const string& path)
+{
+  std::ifstream file(path);
+  std::map<string, Result> out;
+  std::regex pattern("\"name\": \"([^\"]*)\", \"ns_per_op\": ([-0-9.e+]+), \"min_ns\": ([-0-9.e+]+), "
+                     "\"noise\": ([-0-9.e+]+), \"allocs_per_op\": ([-0-9.e+]+)");
+  string line;
+
+  if(!file) throw std::runtime_error("Cannot read " + path);
+
+  while(std::getline(file, line))
+  {
+    std::smatch match;
+
+    if(!std::regex_search(line, match, pattern)) continue;
+
+    out[match[1]] = { match[1], std::stod(match[2]), std::stod(match[3]), std::stod(match[4]), std::stod(match[5]), 0, 0 };
+  }
+
+  return out;
+}
+
+static int compare(const vector<Result>& results, const string& baselinePath, double threshold)
+{
+  auto baseline = readBaseline(baselinePath);
+  int regressions = 0;
+
+  printf("\nagainst %s:\n", baselinePath.c_str());
+
+  for(const auto& result : results)
+  {
+    auto found = baseline.find(result.name);
+    if(found == baseline.end()) continue;
+
+    const auto& base = found->second;
+    // The fastest batch is the least disturbed by the rest of the machine,
+    // so runs are compared on that.
+    double change = base.minNs > 0 ? result.minNs / base.minNs - 1 : 0;
+    double tolerance = std::max({ threshold, result.noise, base.noise });
+
+    if(change > tolerance)
+    {
+      printf("  SLOWER  %-36s %10.1f -> %10.1f ns/op (%+.1f%%, tolerance %.1f%%)\n", result.name.c_str(),
+             base.minNs, result.minNs, change * 100, tolerance * 100);
+      ++regressions;
+    }
+    else if(change < -tolerance)
+    {
+      printf("  faster  %-36s %10.1f -> %10.1f ns/op (%+.1f%%)\n", result.name.c_str(), base.minNs,
+             result.minNs, change * 100);
+    }
+
+    // Allocation counts are nearly deterministic; thread pools and growing
+    // state make a few cases wobble slightly.
+    if(result.allocsPerOp > base.allocsPerOp * 1.01 + 0.5)
+    {
+      printf("  ALLOCS  %-36s %10.2f -> %10.2f allocs/op\n", result.name.c_str(), base.allocsPerOp, result.allocsPerOp);
+      ++regressions;
+    }
+  }
+
+  printf("%d regression%s\n", regressions, regressions == 1 ? "" : "s");
+
+  return regressions ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+  string filter, jsonPath, baselinePath;
+  double threshold = 0.10;
+
+  for(int i = 1; i + 1 < argc; i += 2)
+  {
+    string flag = argv[i];
+
+    if(flag == "--filter") filter = argv[i + 1];
+    else if(flag == "--json") jsonPath = argv[i + 1];
+    else if(flag == "--compare") baselinePath = argv[i + 1];
+    else if(flag == "--threshold") threshold = std::stod(argv[i + 1]) / 100;
+    else
+    {
+      fprintf(stderr, "usage: micro [--filter text] [--json out.json] [--compare base.json] [--threshold pct]\n");
+      return 2;
+    }
+  }
+
+  std::ostream discard(nullptr);
+  Interpreter interpreter(discard);
+
+  vector<Case> cases;
+  vector<string> skipped;
+
+  addReaderCases(cases);
+  addPrinterCases(cases, interpreter);
+  addEnvCases(cases, interpreter);
+  addCoreCases(cases, skipped, interpreter);
+  addEvalCases(cases, interpreter);
+  addLatencyCases(cases);
+
+  vector<Result> results;
+
+  printf("%-40s %12s %7s %10s %12s %10s\n", "case", "ns/op", "noise", "allocs/op", "bytes/op", "MB/s");
+
+  for(const auto& item : cases)
+  {
+    if(!filter.empty() && item.name.find(filter) == string::npos) continue;
+
+    // Some ops only work so many times on the same arguments: a transient
+    // can be popped until it is empty.
+    Result result;
+
+    try
+    {
+      item.body();
+      result = measure(item);
+    }
+    catch(...)
+    {
+      skipped.push_back(item.name + " (throws)");
+      continue;
+    }
+
+    results.push_back(result);
+
+    printf("%-40s %12.1f %6.1f%% %10.2f %12.1f %10.2f\n", result.name.c_str(), result.nsPerOp,
+           result.noise * 100, result.allocsPerOp, result.bytesPerOp, result.mbPerSecond);
+    fflush(stdout);
+  }
+
+  if(!skipped.empty())
+  {
+    printf("skipped:");
+    for(const auto& name : skipped) printf(" %s", name.c_str());
+    printf("\n");
+  }
+
+  if(!jsonPath.empty()) std::ofstream(jsonPath) << toJson(results);
+
+  return baselinePath.empty() ? 0 : compare(results, baselinePath, threshold);
+}
@@ -0,0 +1,106 @@
+// pmap, preduce and psort on a 1M-element vector against the serial map.
+// The shared pool is sized once per process, so each thread count runs in
+// a child process with MAL_THREADS set; the parent collects the timings.
+
+#include "../interpreter.hpp"
+#include "../types.hpp"
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+
+static const char* setup[] = {
+  "(def! work (fn* (x) (let* (a (* x 3) b (+ a 7)) (- b a))))",
+  "(def! sum (fn* (acc x) (+ acc (work x))))"
+};
+
+static double timed(Interpreter& interpreter, const string& source, MalType& result)
+{
+  Stopwatch watch;
+  result = interpreter.eval(source);
+
+  return watch.seconds();
+}
+
+static int child(int size)
+{
+  Interpreter interpreter;
+
+  for(const auto* form : setup)
+  {
+    interpreter.eval(form);
+  }
+
+  vector<MalType> elements;
+  unsigned int seed = 12345;
+
+  for(int i = 0; i < size; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    elements.push_back(Interpreter::toMal(int(seed >> 8) % 1000000));
+  }
+
+  interpreter.getEnv()->set("v", MalType(new MalVector(elements)));
+
+  MalType mapped, pmapped, reduced, sorted;
+
+  // map is lazy: both sides are realized into vectors, so the map row
+  // times the work and not just building the seq.
+  double mapSeconds = timed(interpreter, "(vec (map work v))", mapped);
+  double pmapSeconds = timed(interpreter, "(vec (pmap work v))", pmapped);
+  double preduceSeconds = timed(interpreter, "(pfold + sum 0 v)", reduced);
+  double psortSeconds = timed(interpreter, "(psort v)", sorted);
+
+  if(!mapped->equals(pmapped) || Interpreter::toInt(reduced) != 7 * size) return 1;
+
+  auto sortedElements = Interpreter::toVector(sorted);
+
+  for(size_t i = 1; i < sortedElements.size(); ++i)
+  {
+    if(Interpreter::toInt(sortedElements[i - 1]) > Interpreter::toInt(sortedElements[i])) return 1;
+  }
+
+  printf("%f %f %f %f\n", mapSeconds, pmapSeconds, preduceSeconds, psortSeconds);
+
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc > 2 && string(argv[1]) == "--child") return child(std::stoi(argv[2]));
+
+  size_t maxThreads = argc > 1 ? std::stoul(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+  int size = argc > 2 ? std::stoi(argv[2]) : 1000000;
+
+  printf("hardware threads: %u, %d elements\n", std::thread::hardware_concurrency(), size);
+  printf("threads      map s     pmap s (vs map)   preduce s (vs 1)    psort s (vs 1)\n");
+
+  double preduceBaseline = 0, psortBaseline = 0;
+
+  for(size_t threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    setenv("MAL_THREADS", std::to_string(threads).c_str(), 1);
+
+    string command = string(argv[0]) + " --child " + std::to_string(size);
+    FILE* output = popen(command.c_str(), "r");
+    double map, pmap, preduce, psort;
+
+    if(!output || fscanf(output, "%lf %lf %lf %lf", &map, &pmap, &preduce, &psort) != 4 || pclose(output) != 0)
+    {
+      printf("%2zu threads: run failed or gave wrong results\n", threads);
+      return 1;
+    }
+
+    if(threads == 1)
+    {
+      preduceBaseline = preduce;
+      psortBaseline = psort;
+    }
+
+    printf("%7zu %10.3f %10.3f (%5.2fx) %11.3f (%5.2fx) %10.3f (%5.2fx)\n", threads,
+           map, pmap, map / pmap, preduce, preduceBaseline / preduce, psort, psortBaseline / psort);
+  }
+
+  return 0;
+}
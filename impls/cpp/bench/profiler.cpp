@@ -0,0 +1,50 @@
+// The cost of profiling: a call-heavy recursive fib timed without the
+// profiler and then while sampling at 1 kHz, which should stay within 5%.
+
+#include "../interpreter.hpp"
+#include "../profiler.hpp"
+#include "bench.hpp"
+
+static double timeFib(Interpreter& interpreter, const string& form, int rounds)
+{
+  Stopwatch watch;
+
+  for(int i = 0; i < rounds; ++i)
+  {
+    interpreter.eval(form);
+  }
+
+  return watch.seconds();
+}
+
+int main(int argc, char* argv[])
+{
+  int n = argc > 1 ? std::stoi(argv[1]) : 22;
+  int rounds = argc > 2 ? std::stoi(argv[2]) : 10;
+
+  Interpreter interpreter;
+
+  interpreter.eval("(def! fib (fn* (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))");
+
+  string form = "(fib " + std::to_string(n) + ")";
+
+  timeFib(interpreter, form, 1);
+
+  double plain = timeFib(interpreter, form, rounds);
+  report("unprofiled", rounds, plain, "runs");
+
+  Profiler::start(1000);
+  double profiled = timeFib(interpreter, form, rounds);
+  auto profile = Profiler::stop();
+  report("profiled at 1 kHz", rounds, profiled, "runs");
+
+  printf("overhead %.1f%%, %zu samples\n", (profiled / plain - 1) * 100, profile.samples);
+
+  if(!profile.total.count("fib"))
+  {
+    printf("expected fib in the profile\n%s", profile.table().c_str());
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,62 @@
+// Scaling of independent interpreters across threads on a perf3-style
+// workload (macros, atoms, list churn). Each worker owns its interpreter
+// and heap, so throughput should grow with cores until they run out.
+
+#include "../pool.hpp"
+#include "bench.hpp"
+
+static const char* workload[] = {
+  "(defmacro! or (fn* (& xs) (if (empty? xs) nil (if (= 1 (count xs)) (first xs) `(let* (or_FIXME ~(first xs)) (if or_FIXME or_FIXME (or ~@(rest xs))))))))",
+  "(def! atm (atom (list 0 1 2 3 4 5 6 7 8 9)))",
+  "(def! step (fn* [] (do"
+  "  (or false nil false nil false nil false nil false nil (first @atm))"
+  "  (cond false 1 nil 2 false 3 nil 4 false 5 nil 6 \"else\" (first @atm))"
+  "  (first (rest (rest (rest (rest (rest (rest @atm)))))))"
+  "  (swap! atm (fn* [a] (concat (rest a) (list (first a))))))))",
+  "(def! run (fn* [n] (if (> n 0) (do (step) (run (- n 1))) nil)))"
+};
+
+int main(int argc, char* argv[])
+{
+  size_t maxThreads = argc > 1 ? std::stoul(argv[1]) : 32;
+  int iterations = argc > 2 ? std::stoi(argv[2]) : 2000;
+  const size_t jobsPerThread = 4;
+
+  printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+
+  double baseline = 0;
+
+  for(size_t threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    InterpreterPool pool(threads, [](Interpreter& interpreter) {
+      for(const auto* form : workload)
+      {
+        interpreter.eval(form);
+      }
+    });
+
+    string job = "(run " + std::to_string(iterations) + ")";
+    vector<std::future<MalType>> results;
+
+    Stopwatch watch;
+
+    for(size_t i = 0; i < threads * jobsPerThread; ++i)
+    {
+      results.push_back(pool.submit(job));
+    }
+
+    for(auto& result : results)
+    {
+      result.get();
+    }
+
+    double seconds = watch.seconds();
+    double rate = threads * jobsPerThread * iterations / seconds;
+
+    if(threads == 1) baseline = rate;
+
+    printf("%2zu threads  %12.0f iterations/s  speedup %5.2fx\n", threads, rate, rate / baseline);
+  }
+
+  return 0;
+}
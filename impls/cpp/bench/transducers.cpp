@@ -0,0 +1,85 @@
+// One filter/map/sum pipeline over a range, written three ways: nested
+// lazy map/filter, nested lists materialized at every stage (what map and
+// filter did before they were lazy), and a single transduce. Reports
+// throughput and heap allocations per input element.
+
+#include "../interpreter.hpp"
+#include "bench.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if(void* block = std::malloc(size ? size : 1)) return block;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept
+{
+  std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+  std::free(block);
+}
+
+static const char* setup[] = {
+  "(def! even? (fn* (x) (= 0 (- x (* 2 (/ x 2))))))",
+  "(def! half (fn* (x) (/ x 2)))"
+};
+
+static const char* names[] = { "lazy map/filter", "materialized map/filter", "transduce" };
+
+static const char* forms[] = {
+  "(reduce + 0 (map half (filter even? (range N))))",
+  "(reduce + 0 (apply list (map half (apply list (filter even? (range N))))))",
+  "(transduce (comp (filter even?) (map half)) + 0 (range N))"
+};
+
+int main(int argc, char* argv[])
+{
+  string size = argc > 1 ? argv[1] : "1000000";
+  double elements = std::stod(size);
+
+  Interpreter interpreter;
+
+  for(const auto* form : setup)
+  {
+    interpreter.eval(form);
+  }
+
+  MalType expected;
+
+  for(int i = 0; i < 3; ++i)
+  {
+    string code = forms[i];
+    code.replace(code.find('N'), 1, size);
+
+    size_t before = allocations.load();
+    Stopwatch watch;
+    auto result = interpreter.eval(code);
+    double seconds = watch.seconds();
+    size_t count = allocations.load() - before;
+
+    if(expected && !expected->equals(result))
+    {
+      printf("%s disagrees: %s\n", names[i], result->getString(true).c_str());
+      return 1;
+    }
+
+    expected = result;
+
+    report(names[i], elements, seconds, "elements");
+    printf("%-40s %14.2f allocations/element\n", "", count / elements);
+  }
+
+  return 0;
+}
@@ -0,0 +1,55 @@
+// Building a map of string keys one entry at a time: with assoc, which
+// copies the map on every call, and with assoc! on a transient, which
+// inserts in place and freezes the result once at the end.
+
+#include "../interpreter.hpp"
+#include "bench.hpp"
+
+static const char* setup[] = {
+  "(def! build (fn* (m i n) (if (< i n) (build (assoc m (str i) i) (+ i 1) n) m)))",
+  "(def! build! (fn* (m i n) (if (< i n) (build! (assoc! m (str i) i) (+ i 1) n) (persistent! m))))"
+};
+
+static bool check(const MalType& built, int expected)
+{
+  auto* malMap = dynamic_cast<MalHashMap*>(&*built);
+
+  if(malMap && static_cast<int>(malMap->size()) == expected) return true;
+
+  printf("expected a map with %d entries\n", expected);
+
+  return false;
+}
+
+int main(int argc, char* argv[])
+{
+  int entries = argc > 1 ? std::stoi(argv[1]) : 200000;
+  int persistentEntries = argc > 2 ? std::stoi(argv[2]) : 5000;
+
+  Interpreter interpreter;
+
+  for(const auto* form : setup)
+  {
+    interpreter.eval(form);
+  }
+
+  {
+    Stopwatch watch;
+    auto built = interpreter.eval("(build {} 0 " + std::to_string(persistentEntries) + ")");
+
+    report(std::to_string(persistentEntries) + " entries, assoc", persistentEntries, watch.seconds(), "entries");
+
+    if(!check(built, persistentEntries)) return 1;
+  }
+
+  {
+    Stopwatch watch;
+    auto built = interpreter.eval("(build! (transient {}) 0 " + std::to_string(entries) + ")");
+
+    report(std::to_string(entries) + " entries, assoc!", entries, watch.seconds(), "entries");
+
+    if(!check(built, entries)) return 1;
+  }
+
+  return 0;
+}
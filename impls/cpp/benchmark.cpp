@@ -0,0 +1,122 @@
+#include "benchmark.hpp"
+#include "allocstats.hpp"
+#include "numbers.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t maxIterations = 1000000;
+
+static int64_t nanosBetween(Clock::time_point start, Clock::time_point end)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+// The least time two back-to-back clock reads have been seen to take.
+static int64_t clockOverhead()
+{
+  static const int64_t overhead = [] {
+    int64_t least = INT64_MAX;
+
+    for(int i = 0; i < 1000; ++i)
+    {
+      auto start = Clock::now();
+      least = std::min(least, nanosBetween(start, Clock::now()));
+    }
+
+    return least;
+  }();
+
+  return overhead;
+}
+
+static int64_t optionValue(MalList& form, size_t index)
+{
+  auto* value = dynamic_cast<MalInt*>(&*form[index + 1]);
+
+  if(!value || **value < 0) throw TypeException("bench options take non-negative integers, not " + Printer::prStr(form[index + 1], true));
+
+  return **value;
+}
+
+FormResult evalBench(MalList& form, MalType& ast, Env& env)
+{
+  if(form.size() < 2 || form.size() % 2 != 0) throw TypeException("bench takes an expression and :warmup or :ms options");
+
+  int64_t warmup = 10;
+  int64_t targetMs = 1000;
+
+  for(size_t i = 2; i < form.size(); i += 2)
+  {
+    auto option = form[i]->getString(true);
+
+    if(option == ":warmup") warmup = optionValue(form, i);
+    else if(option == ":ms") targetMs = optionValue(form, i);
+    else throw TypeException("Unknown bench option " + option);
+  }
+
+  const auto& expr = form[1];
+
+  for(int64_t i = 0; i < warmup; ++i)
+  {
+    EVAL(expr, env);
+  }
+
+  vector<int64_t> samples;
+  auto overhead = clockOverhead();
+  auto deadline = Clock::now() + std::chrono::milliseconds(targetMs);
+
+  // Read around each run only, so growing samples isn't counted.
+  AllocStats::Totals allocated = { 0, 0 };
+
+  do
+  {
+    auto allocatedBefore = AllocStats::threadTotals();
+    auto start = Clock::now();
+    EVAL(expr, env);
+    auto end = Clock::now();
+    auto allocatedAfter = AllocStats::threadTotals();
+
+    allocated.allocations += allocatedAfter.allocations - allocatedBefore.allocations;
+    allocated.bytes += allocatedAfter.bytes - allocatedBefore.bytes;
+
+    samples.push_back(std::max<int64_t>(0, nanosBetween(start, end) - overhead));
+
+    if(end >= deadline) break;
+  }
+  while(samples.size() < maxIterations);
+
+  std::sort(samples.begin(), samples.end());
+
+  double count = static_cast<double>(samples.size());
+  double total = 0;
+
+  for(auto sample : samples)
+  {
+    total += sample;
+  }
+
+  // The sample at or above 99% of the rest.
+  size_t p99 = std::min(samples.size() - 1, static_cast<size_t>(count * 0.99));
+
+  auto perIteration = [&](size_t total) -> MalType {
+    return AllocStats::compiledIn() ? MalType(new MalDouble(total / count)) : MNil;
+  };
+
+  ast = MalType(new MalHashMap(map<string, MalType>{
+    { ":iterations", MalInt::of(samples.size()) },
+    { ":mean-ns", MalType(new MalDouble(total / count)) },
+    { ":median-ns", MalInt::of(samples[samples.size() / 2]) },
+    { ":p99-ns", MalInt::of(samples[p99]) },
+    { ":min-ns", MalInt::of(samples.front()) },
+    { ":max-ns", MalInt::of(samples.back()) },
+    { ":allocs", perIteration(allocated.allocations) },
+    { ":bytes", perIteration(allocated.bytes) }
+  }));
+
+  return FormResult::Return;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "evaluator.hpp"
+
+// (bench expr) and (bench expr :warmup n :ms t) evaluate expr n times (10
+// by default) to warm up, then repeatedly for t milliseconds (1000), timing
+// each run on the monotonic clock less the cost of reading it. Returns a
+// map of :iterations, :mean-ns, :median-ns, :p99-ns, :min-ns and :max-ns,
+// and :allocs and :bytes per iteration: every heap allocation expr made on
+// this thread, from AllocStats' counters, or nil unless they are compiled
+// in. Stops after a million iterations however short they are.
+FormResult evalBench(MalList& form, MalType& ast, Env& env);
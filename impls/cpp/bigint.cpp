@@ -0,0 +1,461 @@
+#include "bigint.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+#include "heap.hpp"
+
+#include <algorithm>
+
+typedef vector<uint32_t> Limbs;
+
+// Below this many limbs in the shorter operand, schoolbook multiplication
+// beats Karatsuba's extra additions.
+static const size_t karatsubaThreshold = 32;
+
+static void trim(Limbs& limbs)
+{
+  while(!limbs.empty() && limbs.back() == 0)
+  {
+    limbs.pop_back();
+  }
+}
+
+static int compareMagnitudes(const Limbs& a, const Limbs& b)
+{
+  if(a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+
+  for(size_t i = a.size(); i-- > 0;)
+  {
+    if(a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+  }
+
+  return 0;
+}
+
+static Limbs addMagnitudes(const Limbs& a, const Limbs& b)
+{
+  const Limbs& longer = a.size() >= b.size() ? a : b;
+  const Limbs& shorter = a.size() >= b.size() ? b : a;
+  Limbs sum(longer.size() + 1);
+  uint64_t carry = 0;
+
+  for(size_t i = 0; i < longer.size(); ++i)
+  {
+    carry += static_cast<uint64_t>(longer[i]) + (i < shorter.size() ? shorter[i] : 0);
+    sum[i] = static_cast<uint32_t>(carry);
+    carry >>= 32;
+  }
+
+  sum[longer.size()] = static_cast<uint32_t>(carry);
+  trim(sum);
+
+  return sum;
+}
+
+// a - b, where a >= b.
+static Limbs subtractMagnitudes(const Limbs& a, const Limbs& b)
+{
+  Limbs difference(a.size());
+  int64_t borrow = 0;
+
+  for(size_t i = 0; i < a.size(); ++i)
+  {
+    int64_t digit = static_cast<int64_t>(a[i]) - borrow - (i < b.size() ? b[i] : 0);
+
+    borrow = digit < 0;
+    difference[i] = static_cast<uint32_t>(digit + (borrow << 32));
+  }
+
+  trim(difference);
+
+  return difference;
+}
+
+// Adds addend shifted up by offset limbs into total, which is big enough.
+static void addAt(Limbs& total, const Limbs& addend, size_t offset)
+{
+  uint64_t carry = 0;
+  size_t i = 0;
+
+  for(; i < addend.size() || carry; ++i)
+  {
+    carry += static_cast<uint64_t>(total[offset + i]) + (i < addend.size() ? addend[i] : 0);
+    total[offset + i] = static_cast<uint32_t>(carry);
+    carry >>= 32;
+  }
+}
+
+static Limbs schoolbookMultiply(const Limbs& a, const Limbs& b)
+{
+  Limbs product(a.size() + b.size());
+
+  for(size_t i = 0; i < a.size(); ++i)
+  {
+    uint64_t carry = 0;
+
+    for(size_t j = 0; j < b.size(); ++j)
+    {
+      carry += static_cast<uint64_t>(a[i]) * b[j] + product[i + j];
+      product[i + j] = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+
+    product[i + b.size()] = static_cast<uint32_t>(carry);
+  }
+
+  trim(product);
+
+  return product;
+}
+
+static Limbs lowLimbs(const Limbs& limbs, size_t count)
+{
+  Limbs low(limbs.begin(), limbs.begin() + std::min(count, limbs.size()));
+  trim(low);
+
+  return low;
+}
+
+static Limbs highLimbs(const Limbs& limbs, size_t from)
+{
+  return from < limbs.size() ? Limbs(limbs.begin() + from, limbs.end()) : Limbs();
+}
+
+// Splits both at half limbs: with a = a1·B + a0 and b = b1·B + b0,
+// a·b = z2·B² + z1·B + z0, where z1 = (a0 + a1)(b0 + b1) - z2 - z0 takes one
+// multiplication instead of two.
+static Limbs multiplyMagnitudes(const Limbs& a, const Limbs& b)
+{
+  if(a.empty() || b.empty()) return Limbs();
+
+  if(std::min(a.size(), b.size()) < karatsubaThreshold) return schoolbookMultiply(a, b);
+
+  size_t half = std::max(a.size(), b.size()) / 2;
+
+  auto a0 = lowLimbs(a, half);
+  auto a1 = highLimbs(a, half);
+  auto b0 = lowLimbs(b, half);
+  auto b1 = highLimbs(b, half);
+
+  auto z0 = multiplyMagnitudes(a0, b0);
+  auto z2 = multiplyMagnitudes(a1, b1);
+  auto z1 = subtractMagnitudes(subtractMagnitudes(multiplyMagnitudes(addMagnitudes(a0, a1), addMagnitudes(b0, b1)), z2), z0);
+
+  Limbs product(a.size() + b.size() + 1);
+
+  addAt(product, z0, 0);
+  addAt(product, z1, half);
+  addAt(product, z2, 2 * half);
+  trim(product);
+
+  return product;
+}
+
+static uint32_t divideBySmall(Limbs& limbs, uint32_t divisor)
+{
+  uint64_t remainder = 0;
+
+  for(size_t i = limbs.size(); i-- > 0;)
+  {
+    uint64_t current = (remainder << 32) | limbs[i];
+
+    limbs[i] = static_cast<uint32_t>(current / divisor);
+    remainder = current % divisor;
+  }
+
+  trim(limbs);
+
+  return static_cast<uint32_t>(remainder);
+}
+
+// Knuth's algorithm D: long division one limb of quotient at a time, with
+// the divisor normalized so each estimated quotient limb is at most two
+// too large.
+static Limbs divideMagnitudes(const Limbs& u, const Limbs& v)
+{
+  if(compareMagnitudes(u, v) < 0) return Limbs();
+
+  if(v.size() == 1)
+  {
+    Limbs quotient = u;
+    divideBySmall(quotient, v[0]);
+
+    return quotient;
+  }
+
+  const uint64_t base = 1ull << 32;
+  size_t n = v.size();
+  size_t m = u.size() - n;
+  int shift = __builtin_clz(v[n - 1]);
+
+  Limbs vn(n);
+  Limbs un(u.size() + 1);
+
+  for(size_t i = n - 1; i > 0; --i)
+  {
+    vn[i] = static_cast<uint32_t>((static_cast<uint64_t>(v[i]) << shift) | (static_cast<uint64_t>(v[i - 1]) >> (32 - shift)));
+  }
+
+  vn[0] = v[0] << shift;
+  un[u.size()] = static_cast<uint32_t>(static_cast<uint64_t>(u[u.size() - 1]) >> (32 - shift));
+
+  for(size_t i = u.size() - 1; i > 0; --i)
+  {
+    un[i] = static_cast<uint32_t>((static_cast<uint64_t>(u[i]) << shift) | (static_cast<uint64_t>(u[i - 1]) >> (32 - shift)));
+  }
+
+  un[0] = u[0] << shift;
+
+  Limbs quotient(m + 1);
+
+  for(size_t j = m + 1; j-- > 0;)
+  {
+    uint64_t numerator = (static_cast<uint64_t>(un[j + n]) << 32) | un[j + n - 1];
+    uint64_t estimate = numerator / vn[n - 1];
+    uint64_t remainder = numerator % vn[n - 1];
+
+    while(estimate >= base || estimate * vn[n - 2] > ((remainder << 32) | un[j + n - 2]))
+    {
+      --estimate;
+      remainder += vn[n - 1];
+
+      if(remainder >= base) break;
+    }
+
+    int64_t borrow = 0;
+    uint64_t carry = 0;
+
+    for(size_t i = 0; i < n; ++i)
+    {
+      uint64_t product = estimate * vn[i] + carry;
+      int64_t digit = static_cast<int64_t>(un[i + j]) - borrow - static_cast<int64_t>(product & 0xffffffff);
+
+      carry = product >> 32;
+      borrow = digit < 0;
+      un[i + j] = static_cast<uint32_t>(digit);
+    }
+
+    int64_t top = static_cast<int64_t>(un[j + n]) - borrow - static_cast<int64_t>(carry);
+    un[j + n] = static_cast<uint32_t>(top);
+
+    if(top < 0)
+    {
+      // The estimate was one too large; add the divisor back.
+      --estimate;
+      carry = 0;
+
+      for(size_t i = 0; i < n; ++i)
+      {
+        carry += static_cast<uint64_t>(un[i + j]) + vn[i];
+        un[i + j] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+      }
+
+      un[j + n] += static_cast<uint32_t>(carry);
+    }
+
+    quotient[j] = static_cast<uint32_t>(estimate);
+  }
+
+  trim(quotient);
+
+  return quotient;
+}
+
+BigInt::BigInt(int64_t value): negative_(value < 0)
+{
+  uint64_t magnitude = negative_ ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+
+  while(magnitude)
+  {
+    limbs_.push_back(static_cast<uint32_t>(magnitude));
+    magnitude >>= 32;
+  }
+}
+
+BigInt BigInt::parse(const string& digits)
+{
+  BigInt result;
+  size_t start = !digits.empty() && digits[0] == '-' ? 1 : 0;
+
+  // Nine decimal digits at a time fit in one limb.
+  for(size_t i = start; i < digits.size(); i += 9)
+  {
+    auto group = digits.substr(i, 9);
+    uint32_t scale = 1;
+
+    for(size_t k = 0; k < group.size(); ++k)
+    {
+      scale *= 10;
+    }
+
+    result.limbs_ = schoolbookMultiply(result.limbs_, { scale });
+    result.limbs_ = addMagnitudes(result.limbs_, { static_cast<uint32_t>(std::stoul(group)) });
+    trim(result.limbs_);
+  }
+
+  result.negative_ = start == 1 && !result.isZero();
+
+  return result;
+}
+
+string BigInt::toString() const
+{
+  if(isZero()) return "0";
+
+  Limbs magnitude = limbs_;
+  string digits;
+
+  while(!magnitude.empty())
+  {
+    auto group = std::to_string(divideBySmall(magnitude, 1000000000));
+
+    if(!magnitude.empty()) group.insert(0, 9 - group.size(), '0');
+
+    digits.insert(0, group);
+  }
+
+  return negative_ ? "-" + digits : digits;
+}
+
+bool BigInt::fitsInt64() const
+{
+  if(limbs_.size() < 2) return true;
+  if(limbs_.size() > 2) return false;
+
+  uint64_t magnitude = (static_cast<uint64_t>(limbs_[1]) << 32) | limbs_[0];
+
+  return magnitude <= (negative_ ? 1ull << 63 : (1ull << 63) - 1);
+}
+
+int64_t BigInt::toInt64() const
+{
+  uint64_t magnitude = 0;
+
+  for(size_t i = limbs_.size(); i-- > 0;)
+  {
+    magnitude = (magnitude << 32) | limbs_[i];
+  }
+
+  return negative_ ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+}
+
+double BigInt::toDouble() const
+{
+  double value = 0;
+
+  for(size_t i = limbs_.size(); i-- > 0;)
+  {
+    value = value * 4294967296.0 + limbs_[i];
+  }
+
+  return negative_ ? -value : value;
+}
+
+int BigInt::compare(const BigInt& other) const
+{
+  if(negative_ != other.negative_) return negative_ ? -1 : 1;
+
+  int magnitude = compareMagnitudes(limbs_, other.limbs_);
+
+  return negative_ ? -magnitude : magnitude;
+}
+
+BigInt BigInt::operator-() const
+{
+  BigInt result = *this;
+  result.negative_ = !negative_ && !isZero();
+
+  return result;
+}
+
+BigInt operator+(const BigInt& a, const BigInt& b)
+{
+  BigInt result;
+
+  if(a.negative_ == b.negative_)
+  {
+    result.limbs_ = addMagnitudes(a.limbs_, b.limbs_);
+    result.negative_ = a.negative_;
+  }
+  else if(compareMagnitudes(a.limbs_, b.limbs_) >= 0)
+  {
+    result.limbs_ = subtractMagnitudes(a.limbs_, b.limbs_);
+    result.negative_ = a.negative_;
+  }
+  else
+  {
+    result.limbs_ = subtractMagnitudes(b.limbs_, a.limbs_);
+    result.negative_ = b.negative_;
+  }
+
+  result.negative_ = result.negative_ && !result.isZero();
+
+  return result;
+}
+
+BigInt operator-(const BigInt& a, const BigInt& b)
+{
+  return a + -b;
+}
+
+BigInt operator*(const BigInt& a, const BigInt& b)
+{
+  BigInt result;
+
+  result.limbs_ = multiplyMagnitudes(a.limbs_, b.limbs_);
+  result.negative_ = a.negative_ != b.negative_ && !result.isZero();
+
+  return result;
+}
+
+BigInt operator/(const BigInt& a, const BigInt& b)
+{
+  BigInt result;
+
+  result.limbs_ = divideMagnitudes(a.limbs_, b.limbs_);
+  result.negative_ = a.negative_ != b.negative_ && !result.isZero();
+
+  return result;
+}
+
+string MalBigInt::getString(bool)
+{
+  return value_.toString();
+}
+
+bool MalBigInt::equals(const MalType& other) const
+{
+  auto* otherBig = dynamic_cast<MalBigInt*>(&*other);
+
+  return otherBig && value_.compare(otherBig->value_) == 0;
+}
+
+MalType MalBigInt::deepCopy() const
+{
+  return MalType(new MalBigInt(value_));
+}
+
+void MalBigInt::traverse(HeapVisitor& visitor) const
+{
+  visitor.buffer(value_.limbs());
+}
+
+MalType MalBigInt::from(BigInt value)
+{
+  if(value.fitsInt64()) return MalInt::of(value.toInt64());
+
+  return MalType(new MalBigInt(std::move(value)));
+}
+
+BigInt MalBigInt::toBig(const MalType& number)
+{
+  if(auto* malInt = dynamic_cast<MalInt*>(&*number)) return BigInt(**malInt);
+  if(auto* malBig = dynamic_cast<MalBigInt*>(&*number)) return malBig->value_;
+
+  throw TypeException("Expected a number but got " + Printer::prStr(number, true));
+}
+
+int MalBigInt::compare(const MalType& a, const MalType& b)
+{
+  return toBig(a).compare(toBig(b));
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstdint>
+
+// An arbitrary-precision integer: a sign and a little-endian magnitude in
+// 32-bit limbs with no leading zero limbs. Zero has no limbs and is never
+// negative.
+class BigInt
+{
+  bool negative_;
+  vector<uint32_t> limbs_;
+
+public:
+  BigInt(int64_t value = 0);
+
+  // An optional '-' followed by decimal digits.
+  static BigInt parse(const string& digits);
+
+  string toString() const;
+
+  bool isZero() const { return limbs_.empty(); }
+
+  // Magnitude, least significant 32 bits first.
+  const vector<uint32_t>& limbs() const { return limbs_; }
+  bool fitsInt64() const;
+  int64_t toInt64() const;
+  double toDouble() const;
+
+  // Negative, zero or positive as this is less than, equal to or greater
+  // than other.
+  int compare(const BigInt& other) const;
+
+  BigInt operator-() const;
+
+  friend BigInt operator+(const BigInt& a, const BigInt& b);
+  friend BigInt operator-(const BigInt& a, const BigInt& b);
+  friend BigInt operator*(const BigInt& a, const BigInt& b);
+
+  // Truncates toward zero, like int64_t division. b must not be zero.
+  friend BigInt operator/(const BigInt& a, const BigInt& b);
+};
+
+// An integer outside the int64_t range. Arithmetic only produces one when
+// a result overflows, and turns results that fit back into a MalInt, so
+// equal values always have the same type.
+class MalBigInt : public MalTypeData
+{
+  BigInt value_;
+
+public:
+  MalBigInt(BigInt value): value_(std::move(value)) {}
+
+  virtual string getString(bool printReadably) override;
+
+  virtual bool equals(const MalType& other) const override;
+
+  virtual MalType deepCopy() const override;
+
+  virtual void traverse(HeapVisitor& visitor) const override;
+
+  const BigInt& value() const { return value_; }
+
+  // A MalInt if value fits in 64 bits, otherwise a MalBigInt.
+  static MalType from(BigInt value);
+
+  // The value of a MalInt or MalBigInt; throws a TypeException for anything
+  // else.
+  static BigInt toBig(const MalType& number);
+
+  static int compare(const MalType& a, const MalType& b);
+};
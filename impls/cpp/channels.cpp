@@ -0,0 +1,492 @@
+#include "channels.hpp"
+#include "interpreter.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <thread>
+
+// An alts! that completes elsewhere leaves its registration behind on the
+// other channels. A queue is swept of those each time it doubles past the
+// size it had after its last sweep, which keeps the cost amortized O(1).
+static const size_t minSweep = 64;
+
+template<typename Queue, typename WaiterOf>
+static void sweep(Queue& queue, size_t& sweepAt, WaiterOf waiterOf)
+{
+  if(queue.size() < sweepAt) return;
+
+  auto isStale = [&waiterOf](const typename Queue::value_type& entry) { return !waiterOf(entry)->isActive(); };
+
+  queue.erase(std::remove_if(queue.begin(), queue.end(), isStale), queue.end());
+
+  sweepAt = std::max(minSweep, 2 * queue.size());
+}
+
+ChannelWaiter::ChannelWaiter(): fiber_(Fiber::current()), active_(true), done_(false), parked_(false), index_(0)
+{
+}
+
+bool ChannelWaiter::claim()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if(!active_) return false;
+
+  active_ = false;
+
+  return true;
+}
+
+bool ChannelWaiter::isActive()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return active_;
+}
+
+ChannelWaiter::Claim ChannelWaiter::claimPair(ChannelWaiter& ours, ChannelWaiter& theirs)
+{
+  std::unique_lock<std::mutex> oursLock(ours.mutex_, std::defer_lock);
+  std::unique_lock<std::mutex> theirsLock(theirs.mutex_, std::defer_lock);
+  std::lock(oursLock, theirsLock);
+
+  if(!ours.active_) return Claim::OursInactive;
+  if(!theirs.active_) return Claim::TheirsInactive;
+
+  ours.active_ = false;
+  theirs.active_ = false;
+
+  return Claim::Both;
+}
+
+void ChannelWaiter::complete(const MalType& value, size_t index)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  value_ = value;
+  index_ = index;
+  done_ = true;
+
+  if(!fiber_)
+  {
+    completed_.notify_one();
+  }
+  else if(parked_)
+  {
+    fiber_->resume();
+  }
+}
+
+void ChannelWaiter::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if(!fiber_)
+  {
+    completed_.wait(lock, [this] { return done_; });
+    return;
+  }
+
+  if(done_) return;
+
+  // Once parked_ is visible, complete() may queue the fiber before it has
+  // switched out. That's fine: it only runs on this thread, after park().
+  parked_ = true;
+  lock.unlock();
+
+  Fiber::park();
+}
+
+MalChannel::MalChannel(size_t capacity, Buffer kind):
+  capacity_(capacity), kind_(kind), closed_(false), sweepTakersAt_(minSweep), sweepPuttersAt_(minSweep)
+{
+}
+
+string MalChannel::getString(bool)
+{
+  return "#<channel>";
+}
+
+bool MalChannel::take(const Waiter& waiter, size_t index)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if(!buffer_.empty())
+  {
+    if(!waiter->claim()) return true;
+
+    auto value = buffer_.front();
+    buffer_.pop_front();
+
+    // The first live putter parked on a full buffer moves into the space.
+    while(!putters_.empty())
+    {
+      auto [putter, putValue, putIndex] = putters_.front();
+      putters_.pop_front();
+
+      if(putter->claim())
+      {
+        buffer_.push_back(putValue);
+        putter->complete(MTrue, putIndex);
+        break;
+      }
+    }
+
+    waiter->complete(value, index);
+    return true;
+  }
+
+  for(auto itr = putters_.begin(); itr != putters_.end();)
+  {
+    auto [putter, putValue, putIndex] = *itr;
+
+    if(putter == waiter)
+    {
+      ++itr;
+      continue;
+    }
+
+    auto claim = ChannelWaiter::claimPair(*waiter, *putter);
+
+    if(claim == ChannelWaiter::Claim::OursInactive) return true;
+
+    itr = putters_.erase(itr);
+
+    if(claim == ChannelWaiter::Claim::Both)
+    {
+      putter->complete(MTrue, putIndex);
+      waiter->complete(putValue, index);
+      return true;
+    }
+  }
+
+  if(closed_)
+  {
+    if(waiter->claim()) waiter->complete(MNil, index);
+    return true;
+  }
+
+  sweep(takers_, sweepTakersAt_, [](const std::pair<Waiter, size_t>& taker) { return taker.first; });
+  takers_.emplace_back(waiter, index);
+  return false;
+}
+
+bool MalChannel::put(const Waiter& waiter, const MalType& value, size_t index)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if(closed_)
+  {
+    if(waiter->claim()) waiter->complete(MFalse, index);
+    return true;
+  }
+
+  for(auto itr = takers_.begin(); itr != takers_.end();)
+  {
+    auto [taker, takeIndex] = *itr;
+
+    if(taker == waiter)
+    {
+      ++itr;
+      continue;
+    }
+
+    auto claim = ChannelWaiter::claimPair(*waiter, *taker);
+
+    if(claim == ChannelWaiter::Claim::OursInactive) return true;
+
+    itr = takers_.erase(itr);
+
+    if(claim == ChannelWaiter::Claim::Both)
+    {
+      taker->complete(value, takeIndex);
+      waiter->complete(MTrue, index);
+      return true;
+    }
+  }
+
+  // Sliding and dropping buffers never make a put wait.
+  if(buffer_.size() < capacity_ || (capacity_ > 0 && kind_ != Buffer::Fixed))
+  {
+    if(!waiter->claim()) return true;
+
+    if(buffer_.size() < capacity_)
+    {
+      buffer_.push_back(value);
+    }
+    else if(kind_ == Buffer::Sliding)
+    {
+      buffer_.pop_front();
+      buffer_.push_back(value);
+    }
+
+    waiter->complete(MTrue, index);
+    return true;
+  }
+
+  sweep(putters_, sweepPuttersAt_, [](const std::tuple<Waiter, MalType, size_t>& putter) { return std::get<0>(putter); });
+  putters_.emplace_back(waiter, value, index);
+  return false;
+}
+
+void MalChannel::close()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if(closed_) return;
+
+  closed_ = true;
+
+  for(auto& [taker, takeIndex] : takers_)
+  {
+    if(taker->claim()) taker->complete(MNil, takeIndex);
+  }
+
+  for(auto& [putter, putValue, putIndex] : putters_)
+  {
+    if(putter->claim()) putter->complete(MFalse, putIndex);
+  }
+
+  takers_.clear();
+  putters_.clear();
+}
+
+string MalBufferSpec::getString(bool)
+{
+  return string(kind_ == MalChannel::Buffer::Sliding ? "(sliding-buffer " : "(dropping-buffer ") + std::to_string(capacity_) + ")";
+}
+
+static MalChannel* toChannel(const MalType& value)
+{
+  auto* channel = dynamic_cast<MalChannel*>(&*value);
+
+  if(!channel) throw TypeException("Expected a channel but got " + Printer::prStr(value, true));
+
+  return channel;
+}
+
+static size_t toCapacity(const MalType& value)
+{
+  auto* capacity = dynamic_cast<MalInt*>(&*value);
+
+  if(!capacity || *(*capacity) < 0) throw TypeException("Expected a buffer size but got " + Printer::prStr(value, true));
+
+  return *(*capacity);
+}
+
+MalType MalChanOperation::apply(const vector<MalType>& args)
+{
+  if(args.empty() || args[0] == MNil) return MalType(new MalChannel());
+
+  if(auto* spec = dynamic_cast<MalBufferSpec*>(&*args[0]))
+  {
+    return MalType(new MalChannel(spec->getCapacity(), spec->getKind()));
+  }
+
+  return MalType(new MalChannel(toCapacity(args[0])));
+}
+
+MalType MalBufferOperation::apply(const vector<MalType>& args)
+{
+  auto capacity = toCapacity(args[0]);
+
+  if(capacity == 0) throw TypeException("A sliding or dropping buffer needs room for at least one value");
+
+  return MalType(new MalBufferSpec(kind_, capacity));
+}
+
+MalType MalTakeOperation::apply(const vector<MalType>& args)
+{
+  auto waiter = std::make_shared<ChannelWaiter>();
+
+  toChannel(args[0])->take(waiter, 0);
+  waiter->wait();
+
+  return waiter->getValue();
+}
+
+MalType MalPutOperation::apply(const vector<MalType>& args)
+{
+  auto* channel = toChannel(args[0]);
+
+  if(args[1] == MNil) throw TypeException("Cannot put nil on a channel");
+
+  auto waiter = std::make_shared<ChannelWaiter>();
+
+  channel->put(waiter, args[1], 0);
+  waiter->wait();
+
+  return waiter->getValue();
+}
+
+MalType MalCloseOperation::apply(const vector<MalType>& args)
+{
+  toChannel(args[0])->close();
+
+  return MNil;
+}
+
+MalType MalAltsOperation::apply(const vector<MalType>& args)
+{
+  auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0]);
+
+  if(!enumerable || enumerable->isEmpty()) throw TypeException("alts! takes a non-empty vector of operations");
+
+  vector<MalType> ports;
+  vector<MalType> values;
+
+  for(const auto& operation : *enumerable)
+  {
+    auto* put = dynamic_cast<MalVector*>(&*operation);
+
+    if(put && put->size() != 2) throw TypeException("A put in alts! is [channel value]");
+
+    auto port = put ? (*put)[0] : operation;
+    auto value = put ? (*put)[1] : nullptr;
+
+    toChannel(port);
+    if(value == MNil) throw TypeException("Cannot put nil on a channel");
+
+    ports.push_back(port);
+    values.push_back(value);
+  }
+
+  // Start at a different operation each time, so one always-ready channel
+  // can't starve the others.
+  static std::atomic<size_t> rotation(0);
+  auto start = rotation.fetch_add(1, std::memory_order_relaxed);
+  auto waiter = std::make_shared<ChannelWaiter>();
+
+  for(size_t i = 0; i < ports.size(); ++i)
+  {
+    auto index = (start + i) % ports.size();
+    auto* channel = static_cast<MalChannel*>(&*ports[index]);
+
+    bool done = values[index] ? channel->put(waiter, values[index], index) : channel->take(waiter, index);
+
+    if(done) break;
+  }
+
+  waiter->wait();
+
+  return MalType(new MalVector({ waiter->getValue(), ports[waiter->getIndex()] }));
+}
+
+// Closes timeout channels when they are due, from one lazily started thread.
+class ChannelTimer
+{
+  typedef std::pair<std::chrono::steady_clock::time_point, MalType> Entry;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::priority_queue<Entry, vector<Entry>, std::greater<Entry>> due_;
+
+  ChannelTimer()
+  {
+    std::thread([this] { run(); }).detach();
+  }
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while(true)
+    {
+      if(due_.empty())
+      {
+        changed_.wait(lock);
+        continue;
+      }
+
+      auto next = due_.top();
+
+      if(std::chrono::steady_clock::now() < next.first)
+      {
+        changed_.wait_until(lock, next.first);
+        continue;
+      }
+
+      due_.pop();
+
+      lock.unlock();
+      static_cast<MalChannel*>(&*next.second)->close();
+      lock.lock();
+    }
+  }
+
+public:
+  static ChannelTimer& shared()
+  {
+    static auto* timer = new ChannelTimer();
+
+    return *timer;
+  }
+
+  void closeAfter(const MalType& channel, int milliseconds)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      due_.emplace(std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds), channel);
+    }
+
+    changed_.notify_one();
+  }
+};
+
+MalType MalTimeoutOperation::apply(const vector<MalType>& args)
+{
+  auto* milliseconds = dynamic_cast<MalInt*>(&*args[0]);
+
+  if(!milliseconds) throw TypeException("timeout takes milliseconds but got " + Printer::prStr(args[0], true));
+
+  MalType channel(new MalChannel());
+  ChannelTimer::shared().closeAfter(channel, *(*milliseconds));
+
+  return channel;
+}
+
+MalType MalGoCallOperation::apply(const vector<MalType>& args)
+{
+  auto function = args[0];
+
+  if(!dynamic_cast<MalOperation*>(&*function)) throw TypeException("Cannot call " + Printer::prStr(function, true));
+
+  interpreter_.shareEnvironments();
+
+  MalType result(new MalChannel(1));
+  auto* interpreter = &interpreter_;
+
+  FiberScheduler::shared().spawn([function, result, interpreter] {
+    auto* channel = static_cast<MalChannel*>(&*result);
+    string error;
+
+    try
+    {
+      auto value = static_cast<MalOperation*>(&*function)->apply({});
+
+      if(value != MNil) channel->put(std::make_shared<ChannelWaiter>(), value, 0);
+    }
+    catch(MalTypeException& err)
+    {
+      error = Printer::prStr(err.getMal(), true);
+    }
+    catch(MalException& err)
+    {
+      error = err.getMsg();
+    }
+
+    if(!error.empty())
+    {
+      std::lock_guard<std::mutex> lock(interpreter->getOutputMutex());
+      interpreter->getOutput() << "Uncaught exception in go block: " << error << std::endl;
+    }
+
+    channel->close();
+  });
+
+  return result;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "types.hpp"
+#include "fiber.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <tuple>
+
+// Someone waiting on channel operations: a go block, which parks its fiber,
+// or an ordinary thread, which blocks. alts! registers one waiter on several
+// channels; the first operation to claim it wins and the rest find it
+// inactive and drop it.
+class ChannelWaiter
+{
+  std::mutex mutex_;
+  std::condition_variable completed_;
+  Fiber* fiber_;
+  bool active_;
+  bool done_;
+  bool parked_;
+  MalType value_;
+  size_t index_;
+
+public:
+  ChannelWaiter();
+
+  bool claim();
+  bool isActive();
+
+  enum class Claim { Both, OursInactive, TheirsInactive };
+
+  // Claims two waiters atomically, so a match between two alts! never
+  // consumes one side without the other.
+  static Claim claimPair(ChannelWaiter& ours, ChannelWaiter& theirs);
+
+  // Hands over the result of a claimed waiter and wakes it.
+  void complete(const MalType& value, size_t index);
+
+  // Returns once complete() has been called.
+  void wait();
+
+  MalType getValue() const { return value_; }
+  size_t getIndex() const { return index_; }
+};
+
+typedef shared_ptr<ChannelWaiter> Waiter;
+
+class MalChannel : public MalTypeData
+{
+public:
+  enum class Buffer { Fixed, Sliding, Dropping };
+
+private:
+  std::mutex mutex_;
+  std::deque<MalType> buffer_;
+  size_t capacity_;
+  Buffer kind_;
+  bool closed_;
+  std::deque<std::pair<Waiter, size_t>> takers_;
+  std::deque<std::tuple<Waiter, MalType, size_t>> putters_;
+  size_t sweepTakersAt_;
+  size_t sweepPuttersAt_;
+
+public:
+  MalChannel(size_t capacity = 0, Buffer kind = Buffer::Fixed);
+
+  virtual string getString(bool printReadably) override;
+
+  // Each completes the operation for waiter at once and returns true, or
+  // queues it and returns false. index is reported back to alts!. A put
+  // completes with true, or false if the channel is closed; a take
+  // completes with the value, or nil once the channel is closed and empty.
+  bool take(const Waiter& waiter, size_t index);
+  bool put(const Waiter& waiter, const MalType& value, size_t index);
+
+  void close();
+};
+
+// (sliding-buffer n) and (dropping-buffer n), to pass to chan.
+class MalBufferSpec : public MalTypeData
+{
+  MalChannel::Buffer kind_;
+  size_t capacity_;
+
+public:
+  MalBufferSpec(MalChannel::Buffer kind, size_t capacity): kind_(kind), capacity_(capacity) {}
+
+  virtual string getString(bool printReadably) override;
+
+  MalChannel::Buffer getKind() const { return kind_; }
+  size_t getCapacity() const { return capacity_; }
+};
+
+class MalChanOperation : public MalOperation
+{
+public:
+  MalChanOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalBufferOperation : public MalOperation
+{
+  MalChannel::Buffer kind_;
+
+public:
+  MalBufferOperation(MalChannel::Buffer kind): kind_(kind) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalTakeOperation : public MalOperation
+{
+public:
+  MalTakeOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalPutOperation : public MalOperation
+{
+public:
+  MalPutOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalCloseOperation : public MalOperation
+{
+public:
+  MalCloseOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalAltsOperation : public MalOperation
+{
+public:
+  MalAltsOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalTimeoutOperation : public MalOperation
+{
+public:
+  MalTimeoutOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (go-call f) runs f in a new go block and returns a channel that receives
+// its result (unless nil) and then closes.
+class MalGoCallOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalGoCallOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
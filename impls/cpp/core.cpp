@@ -1,59 +1,146 @@
 #include "core.hpp"
+#include "numbers.hpp"
+#include "arrays.hpp"
+#include "pool.hpp"
+#include "futures.hpp"
+#include "parallel.hpp"
+#include "channels.hpp"
+#include "transients.hpp"
+#include "lazy.hpp"
+#include "transducers.hpp"
+#include "profiler.hpp"
+#include "allocstats.hpp"
+#include "tracer.hpp"
+#include "latency.hpp"
+#include "heap.hpp"
 
 #include <memory>
 
-map<string, MalType> Core::ns = {
-  { "prn", MalType(new MalPrnOperation()) },
-  { "list", MalType(new MalListOperation()) },
-  { "list?", MalType(new MalIsListOperation()) },
-  { "empty?", MalType(new MalIsEmptyOperation()) },
-  { "count", MalType(new MalCountOperation()) },
-  { "=", MalType(new MalEqualsOperation()) },
-  { "<", MalType(new MalLTOperation()) },
-  { "<=", MalType(new MalLTEOperation()) },
-  { ">", MalType(new MalGTOperation()) },
-  { ">=", MalType(new MalGTEOperation()) },
-  { "+", MalType(new MalAddOperation()) },
-  { "-", MalType(new MalSubOperation()) },
-  { "*", MalType(new MalMultOperation()) },
-  { "/", MalType(new MalDivOperation()) },
-  { "pr-str", MalType(new MalPrStrOperation()) },
-  { "str", MalType(new MalStrOperation()) },
-  { "println", MalType(new MalPrintlnOperation()) },
-  { "read-string", MalType(new MalReadStringOperation()) },
-  { "slurp", MalType(new MalSlurpOperation()) },
-  { "eval", MalType(new MalEvalOperation()) },
-  { "atom", MalType(new MalAtomOperation()) },
-  { "atom?", MalType(new MalIsAtomOperation()) },
-  { "deref", MalType(new MalDerefOperation()) },
-  { "reset!", MalType(new MalResetOperation()) },
-  { "swap!", MalType(new MalSwapOperation()) },
-  { "*ARGV*", MalType(new MalList({})) },
-  { "cons", MalType(new MalConsOperation()) },
-  { "concat", MalType(new MalConcatOperation()) },
-  { "vec", MalType(new MalVecOperation()) },
-  { "nth", MalType(new MalNthOperation()) },
-  { "first", MalType(new MalFirstOperation()) },
-  { "rest", MalType(new MalRestOperation()) },
-  { "throw", MalType(new MalThrowOperation()) },
-  { "apply", MalType(new MalApplyOperation()) },
-  { "map", MalType(new MalMapOperation()) },
-  { "nil?", MalType(new MalIsNilOperation()) },
-  { "true?", MalType(new MalIsTrueOperation()) },
-  { "false?", MalType(new MalIsFalseOperation()) },
-  { "symbol?", MalType(new MalIsSymbolOperation()) },
-  { "symbol", MalType(new MalSymbolOperation()) },
-  { "keyword", MalType(new MalKeywordOperation()) },
-  { "keyword?", MalType(new MalIsKeywordOperation()) },
-  { "vector", MalType(new MalVectorOperation()) },
-  { "vector?", MalType(new MalIsVectorOperation()) },
-  { "sequential?", MalType(new MalIsSequentialOperation()) },
-  { "hash-map", MalType(new MalHashMapOperation()) },
-  { "map?", MalType(new MalIsMapOperation()) },
-  { "assoc", MalType(new MalAssocOperation()) },
-  { "dissoc", MalType(new MalDissocOperation()) },
-  { "get", MalType(new MalGetOperation()) },
-  { "contains?", MalType(new MalContainsOperation()) },
-  { "keys", MalType(new MalKeysOperation()) },
-  { "vals", MalType(new MalValsOperation()) }
-};
+map<string, MalType> Core::ns(Interpreter& interpreter)
+{
+  return {
+    { "prn", MalType(new MalPrnOperation(interpreter)) },
+    { "list", MalType(new MalListOperation()) },
+    { "list?", MalType(new MalIsListOperation()) },
+    { "empty?", MalType(new MalIsEmptyOperation()) },
+    { "count", MalType(new MalCountOperation()) },
+    { "=", MalType(new MalEqualsOperation()) },
+    { "<", MalType(new MalLTOperation()) },
+    { "<=", MalType(new MalLTEOperation()) },
+    { ">", MalType(new MalGTOperation()) },
+    { ">=", MalType(new MalGTEOperation()) },
+    { "+", MalType(new MalAddOperation()) },
+    { "-", MalType(new MalSubOperation()) },
+    { "*", MalType(new MalMultOperation()) },
+    { "/", MalType(new MalDivOperation()) },
+    { "pr-str", MalType(new MalPrStrOperation()) },
+    { "str", MalType(new MalStrOperation()) },
+    { "println", MalType(new MalPrintlnOperation(interpreter)) },
+    { "read-string", MalType(new MalReadStringOperation()) },
+    { "slurp", MalType(new MalSlurpOperation()) },
+    { "eval", MalType(new MalEvalOperation(interpreter)) },
+    { "atom", MalType(new MalAtomOperation()) },
+    { "atom?", MalType(new MalIsAtomOperation()) },
+    { "deref", MalType(new MalDerefOperation()) },
+    { "reset!", MalType(new MalResetOperation()) },
+    { "swap!", MalType(new MalSwapOperation()) },
+    { "swap-vals!", MalType(new MalSwapValsOperation()) },
+    { "compare-and-set!", MalType(new MalCompareAndSetOperation()) },
+    { "add-watch", MalType(new MalAddWatchOperation()) },
+    { "remove-watch", MalType(new MalRemoveWatchOperation()) },
+    { "*ARGV*", MalType(new MalList({})) },
+    { "cons", MalType(new MalConsOperation()) },
+    { "concat", MalType(new MalConcatOperation()) },
+    { "vec", MalType(new MalVecOperation()) },
+    { "seq", MalType(new MalSeqOperation()) },
+    { "conj", MalType(new MalConjOperation()) },
+    { "int-array", MalType(new MalIntArrayOperation()) },
+    { "double-array", MalType(new MalDoubleArrayOperation()) },
+    { "array-sum", MalType(new MalArraySumOperation()) },
+    { "array-min", MalType(new MalArrayMinOperation()) },
+    { "array-max", MalType(new MalArrayMaxOperation()) },
+    { "array-dot", MalType(new MalArrayDotOperation()) },
+    { "array-add", MalType(new MalArrayAddOperation()) },
+    { "array-mul", MalType(new MalArrayMulOperation()) },
+    { "array-scale", MalType(new MalArrayScaleOperation()) },
+    { "array-prefix-sum", MalType(new MalArrayPrefixSumOperation()) },
+    { "array-argsort", MalType(new MalArrayArgsortOperation()) },
+    { "nth", MalType(new MalNthOperation()) },
+    { "first", MalType(new MalFirstOperation()) },
+    { "rest", MalType(new MalRestOperation()) },
+    { "throw", MalType(new MalThrowOperation()) },
+    { "apply", MalType(new MalApplyOperation()) },
+    { "map", MalType(new MalMapOperation()) },
+    { "nil?", MalType(new MalIsNilOperation()) },
+    { "true?", MalType(new MalIsTrueOperation()) },
+    { "false?", MalType(new MalIsFalseOperation()) },
+    { "symbol?", MalType(new MalIsSymbolOperation()) },
+    { "symbol", MalType(new MalSymbolOperation()) },
+    { "keyword", MalType(new MalKeywordOperation()) },
+    { "keyword?", MalType(new MalIsKeywordOperation()) },
+    { "vector", MalType(new MalVectorOperation()) },
+    { "vector?", MalType(new MalIsVectorOperation()) },
+    { "sequential?", MalType(new MalIsSequentialOperation()) },
+    { "hash-map", MalType(new MalHashMapOperation()) },
+    { "map?", MalType(new MalIsMapOperation()) },
+    { "assoc", MalType(new MalAssocOperation()) },
+    { "dissoc", MalType(new MalDissocOperation()) },
+    { "get", MalType(new MalGetOperation()) },
+    { "contains?", MalType(new MalContainsOperation()) },
+    { "keys", MalType(new MalKeysOperation()) },
+    { "vals", MalType(new MalValsOperation()) },
+    { "readline", MalType(new MalReadlineOperation(interpreter)) },
+    { "string?", MalType(new MalIsStringOperation()) },
+    { "number?", MalType(new MalIsNumberOperation()) },
+    { "fn?", MalType(new MalIsFnOperation()) },
+    { "macro?", MalType(new MalIsMacroOperation()) },
+    { "time-ms", MalType(new MalTimeMsOperation()) },
+    { "time-ns", MalType(new MalTimeNsOperation()) },
+    { "run-in-thread", MalType(new MalRunInThreadOperation()) },
+    { "future-call", MalType(new MalFutureCallOperation(interpreter)) },
+    { "promise", MalType(new MalPromiseOperation()) },
+    { "deliver", MalType(new MalDeliverOperation()) },
+    { "realized?", MalType(new MalIsRealizedOperation()) },
+    { "pmap", MalType(new MalPmapOperation(interpreter)) },
+    { "pfold", MalType(new MalPfoldOperation(interpreter)) },
+    { "preduce", MalType(new MalPreduceOperation(interpreter)) },
+    { "psort", MalType(new MalPsortOperation(interpreter)) },
+    { "chan", MalType(new MalChanOperation()) },
+    { "sliding-buffer", MalType(new MalBufferOperation(MalChannel::Buffer::Sliding)) },
+    { "dropping-buffer", MalType(new MalBufferOperation(MalChannel::Buffer::Dropping)) },
+    { "<!", MalType(new MalTakeOperation()) },
+    { ">!", MalType(new MalPutOperation()) },
+    { "close!", MalType(new MalCloseOperation()) },
+    { "alts!", MalType(new MalAltsOperation()) },
+    { "timeout", MalType(new MalTimeoutOperation()) },
+    { "go-call", MalType(new MalGoCallOperation(interpreter)) },
+    { "transient", MalType(new MalTransientOperation()) },
+    { "persistent!", MalType(new MalPersistentOperation()) },
+    { "assoc!", MalType(new MalTransientAssocOperation()) },
+    { "conj!", MalType(new MalTransientConjOperation()) },
+    { "dissoc!", MalType(new MalTransientDissocOperation()) },
+    { "pop!", MalType(new MalTransientPopOperation()) },
+    { "lazy-seq-call", MalType(new MalLazySeqOperation()) },
+    { "filter", MalType(new MalFilterOperation()) },
+    { "range", MalType(new MalRangeOperation()) },
+    { "iterate", MalType(new MalIterateOperation()) },
+    { "take", MalType(new MalSeqTakeOperation()) },
+    { "drop", MalType(new MalSeqDropOperation()) },
+    { "reduce", MalType(new MalReduceOperation()) },
+    { "transduce", MalType(new MalTransduceOperation()) },
+    { "reduced", MalType(new MalReducedOperation()) },
+    { "reduced?", MalType(new MalIsReducedOperation()) },
+    { "comp", MalType(new MalCompOperation()) },
+    { "partition-all", MalType(new MalPartitionAllOperation()) },
+    { "dedupe", MalType(new MalDedupeOperation()) },
+    { "profile-start", MalType(new MalProfileStartOperation()) },
+    { "profile-stop", MalType(new MalProfileStopOperation(interpreter)) },
+    { "alloc-stats", MalType(new MalAllocStatsOperation()) },
+    { "alloc-sites", MalType(new MalAllocSitesOperation(interpreter)) },
+    { "trace-to", MalType(new MalTraceToOperation()) },
+    { "latency-stats", MalType(new MalLatencyStatsOperation(interpreter)) },
+    { "heap-census", MalType(new MalHeapCensusOperation(interpreter)) },
+    { "deep-size", MalType(new MalDeepSizeOperation(interpreter)) },
+    { "retainers", MalType(new MalRetainersOperation(interpreter)) }
+  };
+}
@@ -6,8 +6,11 @@
 
 using std::map;
 
+class Interpreter;
+
 class Core
 {
 public:
-  static map<string, MalType> ns;
-};
\ No newline at end of file
+  // Builds a fresh set of core operations bound to one interpreter.
+  static map<string, MalType> ns(Interpreter& interpreter);
+};
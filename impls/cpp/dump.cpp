@@ -0,0 +1,208 @@
+#include "dump.hpp"
+#include "allocstats.hpp"
+#include "heap.hpp"
+#include "interpreter.hpp"
+#include "printer.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
+
+#include <signal.h>
+#include <unistd.h>
+
+std::atomic<bool> StateDump::requested_(false);
+
+namespace
+{
+  string dumpPath;
+  std::mutex dumpMutex;
+
+  const size_t maxTypes = 12;
+
+  string clip(const string& text, size_t length = 80)
+  {
+    return text.size() <= length ? text : text.substr(0, length - 3) + "...";
+  }
+
+  string bindings(const EnvData& env)
+  {
+    string out;
+
+    for(const auto& binding : env.getBindings())
+    {
+      if(!out.empty()) out += ", ";
+      out += binding.first + "=" + Printer::summarize(binding.second, 1);
+    }
+
+    return clip(out, 160);
+  }
+
+  string kilobytes(size_t bytes)
+  {
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+
+    return text;
+  }
+
+  string now()
+  {
+    char text[32];
+    time_t seconds = time(nullptr);
+    tm local;
+
+    localtime_r(&seconds, &local);
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+
+    return text;
+  }
+
+  void writeTypes(std::ostream& out, vector<std::pair<string, Heap::Counts>> types)
+  {
+    std::sort(types.begin(), types.end(), [](const auto& a, const auto& b) {
+      return a.second.bytes > b.second.bytes;
+    });
+
+    if(types.size() > maxTypes) types.resize(maxTypes);
+
+    for(const auto& type : types)
+    {
+      char line[128];
+      snprintf(line, sizeof(line), "  %-32s %10zu %12s\n", clip(type.first, 32).c_str(), type.second.objects,
+               kilobytes(type.second.bytes).c_str());
+      out << line;
+    }
+  }
+}
+
+void StateDump::onSignal(int)
+{
+  requested_.store(true, std::memory_order_relaxed);
+}
+
+void StateDump::install(const string& path)
+{
+  dumpPath = path;
+
+  struct sigaction action;
+  action.sa_handler = onSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+
+  sigaction(SIGUSR1, &action, nullptr);
+}
+
+void StateDump::atSafepoint(const MalType& form, const Env& env)
+{
+  if(!requested_.exchange(false)) return;
+
+  auto text = describe(form, env);
+
+  std::lock_guard<std::mutex> lock(dumpMutex);
+
+  if(dumpPath.empty())
+  {
+    fputs(text.c_str(), stderr);
+    return;
+  }
+
+  FILE* file = fopen(dumpPath.c_str(), "a");
+
+  if(!file)
+  {
+    fprintf(stderr, "Cannot append the state dump to %s\n%s", dumpPath.c_str(), text.c_str());
+    return;
+  }
+
+  fputs(text.c_str(), file);
+  fclose(file);
+}
+
+string StateDump::describe(const MalType& form, const Env& env)
+{
+  std::ostringstream out;
+  const EnvData* innermostCall = nullptr;
+
+  out << "=== mal state dump: pid " << getpid() << ", thread " << std::this_thread::get_id() << ", " << now() << " ===\n";
+  out << "evaluating: " << clip(Printer::summarize(form, 3), 200) << "\n";
+
+  if(CallStack::enabled())
+  {
+    const auto& frames = CallStack::current();
+    size_t depth = frames.depth.load(std::memory_order_relaxed);
+    size_t recorded = std::min(depth, CallStack::maxDepth);
+
+    out << "call stack, innermost first, " << depth << " calls:\n";
+
+    if(depth > recorded) out << "  (" << depth - recorded << " innermost calls not recorded)\n";
+
+    for(size_t i = recorded; i-- > 0;)
+    {
+      out << "  #" << depth - 1 - i << " " << SymbolTable::name(frames.ids[i]);
+
+      if(frames.envs[i]) out << " " << bindings(*frames.envs[i]);
+
+      out << "\n";
+    }
+
+    if(recorded == depth && depth) innermostCall = frames.envs[depth - 1];
+  }
+  else
+  {
+    out << "call stack: not kept; run with --call-stacks to see it\n";
+  }
+
+  size_t scopes = env->depth();
+  out << "environment: " << scopes << " scopes above the global one\n";
+
+  if(scopes && &*env != innermostCall) out << "  innermost: " << bindings(*env) << "\n";
+
+  // Everything reachable from the global environment, under its lock while
+  // futures may be defining things in it.
+  auto* interpreter = env->getInterpreter();
+  Heap::Census global;
+
+  if(interpreter->isShared())
+  {
+    std::shared_lock<std::shared_mutex> lock(interpreter->getEnvMutex());
+    global = Heap::reachable({}, { interpreter->getEnv() });
+  }
+  else
+  {
+    global = Heap::reachable({}, { interpreter->getEnv() });
+  }
+
+  if(AllocStats::compiledIn())
+  {
+    vector<std::pair<string, Heap::Counts>> live;
+
+    for(const auto& pair : AllocStats::byType())
+    {
+      Heap::Counts counts;
+      counts.objects = pair.second.liveObjects;
+      counts.bytes = pair.second.liveBytes;
+      live.push_back({ pair.first, counts });
+    }
+
+    out << "live values by type:\n";
+    writeTypes(out, live);
+  }
+  else
+  {
+    out << "values by type, reachable from the global environment (make instrumented counts all live ones):\n";
+    writeTypes(out, vector<std::pair<string, Heap::Counts>>(global.byType.begin(), global.byType.end()));
+  }
+
+  size_t envs = global.byType.count("EnvData") ? global.byType["EnvData"].objects : 0;
+
+  out << "global environment holds " << global.total.objects - envs << " values and " << envs << " environments, "
+      << kilobytes(global.total.bytes) << "\n";
+
+  return out.str();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "types.hpp"
+#include "env.hpp"
+
+#include <atomic>
+#include <string>
+
+using std::string;
+
+// A report of what a running interpreter is doing, for jobs that seem
+// stuck: the form being evaluated, the mal call stack with each call's
+// arguments, how deep the current environment is, live values by type and
+// what the global environment holds. SIGUSR1 only sets a flag; the next
+// thread to go round the EVAL loop writes the dump from there, where it is
+// safe to allocate and to walk values.
+//
+// The call stack is only there while CallStack is being kept (--call-stacks,
+// profiling, tracing or an instrumented build); otherwise the dump falls
+// back to the bindings of the current environment.
+class StateDump
+{
+public:
+  // Installs the SIGUSR1 handler. Dumps are appended to path, or written to
+  // stderr if it is empty.
+  static void install(const string& path = "");
+
+  // The one check EVAL makes per iteration.
+  static bool requested() { return requested_.load(std::memory_order_relaxed); }
+
+  // Writes the dump if no other thread has taken the request yet.
+  static void atSafepoint(const MalType& form, const Env& env);
+
+  // The dump for the calling thread, evaluating form in env.
+  static string describe(const MalType& form, const Env& env);
+
+private:
+  static std::atomic<bool> requested_;
+
+  static void onSignal(int);
+};
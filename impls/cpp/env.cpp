@@ -1,9 +1,20 @@
 #include "env.hpp"
 #include "error.hpp"
+#include "interpreter.hpp"
+#include "heap.hpp"
+
+#include <mutex>
+#include <shared_mutex>
+
+EnvData::EnvData(Interpreter* interpreter)
+{
+    interpreter_ = interpreter;
+}
 
 EnvData::EnvData(Env outer, const vector<MalType>& binds, const vector<MalType>& exprs)
 {
     outer_ = outer;
+    interpreter_ = outer ? outer->interpreter_ : nullptr;
     for(size_t i = 0; i < binds.size(); ++i)
     {
         auto* symbol = dynamic_cast<MalSymbol*>(&*binds[i]);
@@ -19,35 +30,105 @@ EnvData::EnvData(Env outer, const vector<MalType>& binds, const vector<MalType>&
 
             auto* bindingSymbol = dynamic_cast<MalSymbol*>(&*binds[i + 1]);
 
-            set(bindingSymbol->getSymbol(), MalType(new MalList(args)));
+            data_[bindingSymbol->getSymbol()] = MalType(new MalList(args));
 
             break;
         }
 
-        set(symbol->getSymbol(), exprs[i]);
+        if(i >= exprs.size())
+        {
+            throw TypeException("Function expects an argument for '" + symbol->getSymbol() + "' but got " + std::to_string(exprs.size()) + " argument(s)");
+        }
+
+        data_[symbol->getSymbol()] = exprs[i];
     }
 }
 
+bool EnvData::isShared() const
+{
+    return interpreter_ != nullptr && interpreter_->isShared();
+}
+
 MalType EnvData::set(const string& key, MalType operation)
 {
+    if(isShared())
+    {
+        std::unique_lock<std::shared_mutex> lock(interpreter_->getEnvMutex());
+
+        return data_[key] = operation;
+    }
+
     return data_[key] = operation;
 }
 
-EnvData* EnvData::find(const string& key)
+void EnvData::clear()
+{
+    // Swapped out under the lock and freed after it, since freeing a
+    // binding can run code that uses this environment.
+    map<string, MalType> bindings;
+
+    if(isShared())
+    {
+        std::unique_lock<std::shared_mutex> lock(interpreter_->getEnvMutex());
+        bindings.swap(data_);
+    }
+    else
+    {
+        bindings.swap(data_);
+    }
+}
+
+MalType* EnvData::find(const string& key)
 {
-    if(data_.find(key) == data_.end())
+    for(auto* env = this; env != nullptr; env = &*env->outer_)
     {
-        if(outer_ == nullptr) throw InvalidSymbolException("'" + key + "' not found");
+        auto itr = env->data_.find(key);
 
-        return outer_->find(key);
+        if(itr != env->data_.end()) return &itr->second;
     }
 
-    return this;
+    return nullptr;
 }
 
 MalType EnvData::get(const string& key)
 {
-    auto* env = find(key);
+    auto value = lookup(key);
+
+    if(!value) throw InvalidSymbolException("'" + key + "' not found");
+
+    return value;
+}
+
+MalType EnvData::lookup(const string& key)
+{
+    if(isShared())
+    {
+        std::shared_lock<std::shared_mutex> lock(interpreter_->getEnvMutex());
+
+        auto* value = find(key);
+
+        return value ? *value : nullptr;
+    }
+
+    auto* value = find(key);
+
+    return value ? *value : nullptr;
+}
+
+void EnvData::traverse(HeapVisitor& visitor) const
+{
+    visitor.entries(data_);
+    visitor.env(outer_);
+}
+
+size_t EnvData::depth() const
+{
+    size_t depth = 0;
+
+    for(auto* env = &*outer_; env != nullptr; env = &*env->outer_)
+    {
+        ++depth;
+    }
 
-    return env->data_[key];
+    return depth;
 }
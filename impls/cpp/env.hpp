@@ -13,6 +13,7 @@ using std::shared_ptr;
 using std::vector;
 
 class EnvData;
+class Interpreter;
 
 typedef shared_ptr<EnvData> Env;
 
@@ -20,13 +21,33 @@ class EnvData
 {
   map<string, MalType> data_;
   Env outer_;
+  Interpreter* interpreter_;
 
 public:
+  // Root environment of an interpreter; nested environments inherit it.
+  explicit EnvData(Interpreter* interpreter);
   EnvData(Env outer = nullptr, const vector<MalType>& binds = {}, const vector<MalType>& exprs = {});
 
+  Interpreter* getInterpreter() const { return interpreter_; }
+
+  const map<string, MalType>& getBindings() const { return data_; }
+
   MalType set(const string& key, MalType operation);
   MalType get(const string& key);
+  MalType lookup(const string& key);
+
+  // Hands the bindings and the outer environment to visitor (heap.hpp). The
+  // caller holds the interpreter's environment lock if it is shared.
+  void traverse(HeapVisitor& visitor) const;
+
+  // Drops every binding. Closures defined here hold this environment, and
+  // it holds them, so nothing else would ever free either.
+  void clear();
+
+  // Scopes between this one and the interpreter's global environment.
+  size_t depth() const;
 
 private:
-  EnvData* find(const string& key);
+  bool isShared() const;
+  MalType* find(const string& key);
 };
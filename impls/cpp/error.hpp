@@ -66,6 +66,28 @@ public:
   }
 };
 
+class TypeException : public MalException
+{
+public:
+  TypeException(string msg): MalException(msg) {};
+
+  void log() override
+  {
+    cout << "Type Exception: " << msg_ << endl;
+  }
+};
+
+class StackOverflowException : public MalException
+{
+public:
+  StackOverflowException(string msg): MalException(msg) {};
+
+  void log() override
+  {
+    cout << "Stack Overflow Exception: " << msg_ << endl;
+  }
+};
+
 class MalTypeException : public std::exception
 {
   MalType mal_;
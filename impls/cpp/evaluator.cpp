@@ -0,0 +1,449 @@
+#include "evaluator.hpp"
+#include "reader.hpp"
+#include "error.hpp"
+#include "interpreter.hpp"
+#include "fiber.hpp"
+#include "lazy.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+#include "benchmark.hpp"
+#include "perfcounters.hpp"
+#include "dump.hpp"
+
+#include <typeinfo>
+
+static MalFunction* macroFor(const MalType& ast, const Env& env)
+{
+  auto* astList = dynamic_cast<MalList*>(&*ast);
+  if(!astList || astList->isEmpty()) return nullptr;
+
+  auto* symbol = dynamic_cast<MalSymbol*>(&*(*astList)[0]);
+  if(!symbol) return nullptr;
+
+  auto envMal = env->lookup(symbol->getSymbol());
+  if(!envMal) return nullptr;
+
+  auto* envFunc = dynamic_cast<MalFunction*>(&*envMal);
+  if(!envFunc || !envFunc->isMacro()) return nullptr;
+
+  return envFunc;
+}
+
+// Macros build code with cons, rest and concat, which may hand back lazy
+// seqs. Turning every one of them into a list once, here, keeps a function
+// body a macro wrote from being realized again on each call. Returns code
+// itself when it holds no lazy seqs.
+static MalType realizeCode(const MalType& code)
+{
+  bool lazy = typeid(*code) == typeid(MalLazySeq);
+
+  if(!lazy && typeid(*code) != typeid(MalList) && typeid(*code) != typeid(MalVector)) return code;
+
+  auto* enumerable = static_cast<MalEnumerable*>(&*code);
+  vector<MalType> elements;
+  bool changed = lazy;
+
+  elements.reserve(enumerable->size());
+
+  for(const auto& element : *enumerable)
+  {
+    elements.push_back(realizeCode(element));
+    changed = changed || elements.back() != element;
+  }
+
+  if(!changed) return code;
+
+  if(typeid(*code) == typeid(MalVector)) return MalType(new MalVector(std::move(elements)));
+
+  return MalType(new MalList(std::move(elements)));
+}
+
+MalType macroexpand(MalType ast, const Env& env)
+{
+  bool expanded = false;
+  int64_t traceStart = -1;
+  SymbolId firstMacro = 0;
+
+  while(auto* macro = macroFor(ast, env))
+  {
+    if(!expanded && Tracer::enabled())
+    {
+      traceStart = Tracer::now();
+      firstMacro = macro->getName();
+    }
+
+    auto* astList = dynamic_cast<MalList*>(&*ast);
+
+    vector<MalType> args(astList->begin() + 1, astList->end());
+
+    ast = macro->apply(args);
+    expanded = true;
+
+    if(typeid(*ast) == typeid(MalLazySeq)) ast = static_cast<MalLazySeq*>(&*ast)->toList();
+  }
+
+  if(!expanded) return ast;
+
+  ast = realizeCode(ast);
+
+  if(traceStart >= 0) Tracer::completeIfLong("macroexpand", SymbolTable::name(firstMacro), traceStart, Tracer::now());
+
+  return ast;
+}
+
+MalType quasiquote(const MalType& ast)
+{
+  static const SymbolId unquoteId = SymbolTable::intern("unquote");
+  static const SymbolId spliceUnquoteId = SymbolTable::intern("splice-unquote");
+
+  if(auto* malList = dynamic_cast<MalEnumerable*>(&*ast))
+  {
+    if(dynamic_cast<MalList*>(&*ast) && !malList->isEmpty())
+    {
+      if(auto* symbol = dynamic_cast<MalSymbol*>(&*(*malList)[0]))
+      {
+        if(symbol->getId() == unquoteId) return (*malList)[1];
+      }
+    }
+
+    MalType ret = MalType(new MalList({}));
+
+    for(int i = static_cast<int>(malList->size()) - 1; i >= 0; --i)
+    {
+      auto elt = (*malList)[i];
+
+      auto* eltList = dynamic_cast<MalEnumerable*>(&*elt);
+      auto* eltSymbol = eltList && !eltList->isEmpty() ? dynamic_cast<MalSymbol*>(&*(*eltList)[0]) : nullptr;
+
+      if(eltSymbol && eltSymbol->getId() == spliceUnquoteId)
+      {
+        ret = MalType(new MalList({ MalType(new MalSymbol("concat")), (*eltList)[1], ret }));
+      }
+      else
+      {
+        ret = MalType(new MalList({ MalType(new MalSymbol("cons")), quasiquote(elt), ret }));
+      }
+    }
+
+    if(dynamic_cast<MalVector*>(&*ast))
+      ret = MalType(new MalList({ MalType(new MalSymbol("vec")), ret }));
+
+    return ret;
+  }
+
+  auto* astMap = dynamic_cast<MalHashMap*>(&*ast);
+  auto* astSymbol = dynamic_cast<MalSymbol*>(&*ast);
+
+  if(astMap || astSymbol)
+  {
+    return MalType(new MalList({ MalType(new MalSymbol("quote")), ast }));
+  }
+
+  return ast;
+}
+
+MalType evalAst(const MalType& ast, Env& env)
+{
+  if(typeid(*ast) == typeid(MalSymbol))
+  {
+    auto* symbol = static_cast<MalSymbol*>(&*ast);
+
+    return env->get(symbol->getSymbol());
+  }
+
+  if(typeid(*ast) == typeid(MalList))
+  {
+    vector<MalType> elements;
+
+    auto* malList = static_cast<MalList*>(&*ast);
+    elements.reserve(malList->size());
+
+    for(const auto& mal : *malList)
+    {
+      elements.push_back(EVAL(mal, env));
+    }
+
+    return MalType(new MalList(elements));
+  }
+
+  if(typeid(*ast) == typeid(MalVector))
+  {
+    vector<MalType> elements;
+
+    auto* malVector = static_cast<MalVector*>(&*ast);
+    elements.reserve(malVector->size());
+
+    for(const auto& mal : *malVector)
+    {
+      elements.push_back(EVAL(mal, env));
+    }
+
+    return MalType(new MalVector(elements));
+  }
+
+  if(typeid(*ast) == typeid(MalHashMap))
+  {
+    vector<MalType> elements;
+
+    auto* malHashMap = static_cast<MalHashMap*>(&*ast);
+
+    for(const auto& pair : *malHashMap)
+    {
+      elements.push_back(Tokenizer::readStr(pair.first));
+      elements.push_back(EVAL(pair.second, env));
+    }
+
+    return MalType(new MalHashMap(elements));
+  }
+
+  return ast;
+}
+
+static FormResult evalDef(MalList& form, MalType& ast, Env& env)
+{
+  auto* key = dynamic_cast<MalSymbol*>(&*form[1]);
+  auto value = EVAL(form[2], env);
+
+  if(auto* function = dynamic_cast<MalFunction*>(&*value)) function->nameIfAnonymous(key->getId());
+
+  ast = env->set(key->getSymbol(), value);
+
+  return FormResult::Return;
+}
+
+static FormResult evalLet(MalList& form, MalType& ast, Env& env)
+{
+  auto newEnv = Env(new EnvData(env));
+  auto* defs = dynamic_cast<MalEnumerable*>(&*form[1]);
+
+  for(auto itr = defs->begin(); itr != defs->end(); ++itr)
+  {
+    auto* key = dynamic_cast<MalSymbol*>(&*(*itr));
+    ++itr;
+    auto value = EVAL(*itr, newEnv);
+
+    newEnv->set(key->getSymbol(), value);
+  }
+
+  env = newEnv;
+  ast = form[2];
+
+  return FormResult::TailCall;
+}
+
+static FormResult evalDo(MalList& form, MalType& ast, Env& env)
+{
+  if(form.size() == 1)
+  {
+    ast = MNil;
+    return FormResult::Return;
+  }
+
+  for(auto itr = form.begin() + 1; itr != form.end() - 1; ++itr)
+  {
+    EVAL(*itr, env);
+  }
+
+  ast = *(form.end() - 1);
+
+  return FormResult::TailCall;
+}
+
+static FormResult evalIf(MalList& form, MalType& ast, Env& env)
+{
+  auto result = EVAL(form[1], env);
+
+  if(result != MNil && result != MFalse)
+  {
+    ast = form[2];
+    return FormResult::TailCall;
+  }
+
+  if(form.size() == 3)
+  {
+    ast = MNil;
+    return FormResult::Return;
+  }
+
+  ast = form[3];
+
+  return FormResult::TailCall;
+}
+
+static FormResult evalFn(MalList& form, MalType& ast, Env& env)
+{
+  auto* argsList = dynamic_cast<MalEnumerable*>(&*form[1]);
+
+  vector<MalType> bindings(argsList->begin(), argsList->end());
+
+  ast = MalType(new MalFunction(bindings, form[2], env));
+
+  return FormResult::Return;
+}
+
+static FormResult evalQuote(MalList& form, MalType& ast, Env&)
+{
+  ast = form[1];
+
+  return FormResult::Return;
+}
+
+static FormResult evalQuasiquote(MalList& form, MalType& ast, Env&)
+{
+  ast = quasiquote(form[1]);
+
+  return FormResult::TailCall;
+}
+
+static FormResult evalQuasiquoteExpand(MalList& form, MalType& ast, Env&)
+{
+  ast = quasiquote(form[1]);
+
+  return FormResult::Return;
+}
+
+static FormResult evalDefMacro(MalList& form, MalType& ast, Env& env)
+{
+  auto* key = dynamic_cast<MalSymbol*>(&*form[1]);
+  auto funcType = EVAL(form[2], env);
+  auto* func = dynamic_cast<MalFunction*>(&*funcType);
+  func->makeMacro();
+  func->nameIfAnonymous(key->getId());
+
+  ast = env->set(key->getSymbol(), funcType);
+
+  return FormResult::Return;
+}
+
+static FormResult evalMacroexpand(MalList& form, MalType& ast, Env& env)
+{
+  ast = macroexpand(form[1], env);
+
+  return FormResult::Return;
+}
+
+static FormResult evalTry(MalList& form, MalType& ast, Env& env)
+{
+  MalType caught;
+
+  // The handler only records what was thrown: the catch* body runs after it
+  // has exited, since a go block may park in there and another fiber on the
+  // same thread must not see this exception as still being handled.
+  try
+  {
+    ast = EVAL(form[1], env);
+    return FormResult::Return;
+  }
+  catch(MalTypeException& err)
+  {
+    if(form.size() <= 2) throw;
+
+    caught = err.getMal();
+  }
+  catch(MalException& err)
+  {
+    if(form.size() <= 2) throw;
+
+    caught = MalType(new MalString(err.getMsg()));
+  }
+
+  auto* catchEnumerable = dynamic_cast<MalEnumerable*>(&*form[2]);
+
+  env = Env(new EnvData(env, {(*catchEnumerable)[1]}, {caught}));
+  ast = (*catchEnumerable)[2];
+  return FormResult::TailCall;
+}
+
+SpecialForms::SpecialForms()
+{
+  define("def!", evalDef);
+  define("let*", evalLet);
+  define("do", evalDo);
+  define("if", evalIf);
+  define("fn*", evalFn);
+  define("quote", evalQuote);
+  define("quasiquote", evalQuasiquote);
+  define("quasiquoteexpand", evalQuasiquoteExpand);
+  define("defmacro!", evalDefMacro);
+  define("macroexpand", evalMacroexpand);
+  define("try*", evalTry);
+  define("bench", evalBench);
+  define("with-perf-counters", evalWithPerfCounters);
+}
+
+void SpecialForms::define(const string& name, const SpecialForm& form)
+{
+  auto id = SymbolTable::intern(name);
+
+  if(id >= forms_.size()) forms_.resize(id + 1);
+
+  forms_[id] = form;
+}
+
+MalType EVAL(MalType input, Env env)
+{
+  checkFiberStack();
+
+  const auto& specialForms = env->getInterpreter()->getSpecialForms();
+  CallStack::Frame frame;
+
+  while(true)
+  {
+    if(StateDump::requested()) StateDump::atSafepoint(input, env);
+
+    if(typeid(*input) != typeid(MalList))
+    {
+      // Code built with map, filter and friends is lazy; run it as a list.
+      if(typeid(*input) != typeid(MalLazySeq)) return evalAst(input, env);
+
+      input = static_cast<MalLazySeq*>(&*input)->toList();
+    }
+
+    input = macroexpand(input, env);
+
+    if(typeid(*input) != typeid(MalList)) return evalAst(input, env);
+
+    // Keep the form alive while a special form rebinds input.
+    MalType form = input;
+    auto* malList = static_cast<MalList*>(&*form);
+
+    if(malList->isEmpty())
+    {
+      return input;
+    }
+
+    const auto& head = (*malList)[0];
+
+    if(typeid(*head) == typeid(MalSymbol))
+    {
+      if(const auto* specialForm = specialForms.find(*static_cast<MalSymbol*>(&*head)))
+      {
+        if((*specialForm)(*malList, input, env) == FormResult::Return) return input;
+
+        continue;
+      }
+    }
+
+    auto operationType = EVAL(head, env);
+
+    vector<MalType> args;
+    args.reserve(malList->size() - 1);
+
+    for(auto itr = malList->begin() + 1; itr != malList->end(); ++itr)
+    {
+      args.push_back(EVAL(*itr, env));
+    }
+
+    auto* operation = dynamic_cast<MalOperation*>(&*operationType);
+
+    if(const auto* function = dynamic_cast<MalFunction*>(operation))
+    {
+      input = function->getBody();
+      env = function->makeEnv(args);
+      frame.enter(function->getName(), &*env);
+      continue;
+    }
+
+    return operation->apply(args);
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "types.hpp"
+#include "env.hpp"
+
+#include <functional>
+#include <vector>
+
+using std::function;
+using std::vector;
+
+MalType EVAL(MalType input, Env env);
+MalType evalAst(const MalType& ast, Env& env);
+MalType macroexpand(MalType ast, const Env& env);
+MalType quasiquote(const MalType& ast);
+
+// A special form either produces the value of the whole form (Return) or
+// replaces ast/env with the expression EVAL should continue with (TailCall).
+enum class FormResult { Return, TailCall };
+
+typedef function<FormResult(MalList& form, MalType& ast, Env& env)> SpecialForm;
+
+// Special forms indexed by the interned id of their symbol, so dispatch is
+// a bounds check and a load instead of a chain of string compares. Each
+// Interpreter owns one, pre-populated with the standard forms.
+class SpecialForms
+{
+  vector<SpecialForm> forms_;
+
+public:
+  SpecialForms();
+
+  void define(const string& name, const SpecialForm& form);
+
+  const SpecialForm* find(const MalSymbol& symbol) const
+  {
+    auto id = symbol.getId();
+    if(id >= forms_.size() || !forms_[id]) return nullptr;
+
+    return &forms_[id];
+  }
+};
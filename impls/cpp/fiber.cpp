@@ -0,0 +1,213 @@
+#include "fiber.hpp"
+#include "error.hpp"
+
+#include <cstdlib>
+#include <thread>
+
+#include <sys/mman.h>
+
+// ThreadSanitizer can't see a swapcontext on its own; tell it about each
+// switch so a -fsanitize=thread build checks go blocks too.
+#ifdef __SANITIZE_THREAD__
+#include <sanitizer/tsan_interface.h>
+
+static void* currentSanitizerFiber() { return __tsan_get_current_fiber(); }
+static void* createSanitizerFiber() { return __tsan_create_fiber(0); }
+static void destroySanitizerFiber(void* fiber) { __tsan_destroy_fiber(fiber); }
+static void switchSanitizerFiber(void* fiber) { __tsan_switch_to_fiber(fiber, 0); }
+#else
+static void* currentSanitizerFiber() { return nullptr; }
+static void* createSanitizerFiber() { return nullptr; }
+static void destroySanitizerFiber(void*) {}
+static void switchSanitizerFiber(void*) {}
+#endif
+
+// Stacks come from mappings of this many at a time. Giving each stack its
+// own mapping (and guard page) would run into the kernel's per-process
+// mapping limit long before 100k parked go blocks.
+static const size_t stacksPerSlab = 64;
+
+// Head room left below the limit EVAL checks against, for the native code
+// that runs between two EVALs and for unwinding the overflow exception.
+static const size_t stackReserve = 32 * 1024;
+
+static thread_local Fiber* currentFiber = nullptr;
+static thread_local ucontext_t* schedulerContext = nullptr;
+static thread_local void* schedulerSanitizerFiber = nullptr;
+
+thread_local const char* fiberStackLimit = nullptr;
+
+void throwFiberStackOverflow()
+{
+  throw StackOverflowException("go block recursed deeper than its " + std::to_string(FiberScheduler::stackSize / 1024) + "K stack");
+}
+
+Fiber::Fiber(FiberScheduler& scheduler, size_t worker, function<void()> body):
+  stack_(nullptr), sanitizerFiber_(nullptr), body_(std::move(body)), scheduler_(scheduler), worker_(worker), finished_(false)
+{
+}
+
+Fiber* Fiber::current()
+{
+  return currentFiber;
+}
+
+void Fiber::park()
+{
+  auto* fiber = currentFiber;
+
+  switchSanitizerFiber(schedulerSanitizerFiber);
+  swapcontext(&fiber->context_, schedulerContext);
+}
+
+void Fiber::resume()
+{
+  scheduler_.enqueue(this);
+}
+
+FiberScheduler::FiberScheduler(size_t threads): next_(0)
+{
+  threads = std::max<size_t>(threads, 1);
+
+  for(size_t i = 0; i < threads; ++i)
+  {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+
+  for(size_t i = 0; i < threads; ++i)
+  {
+    std::thread([this, i] { work(i); }).detach();
+  }
+}
+
+FiberScheduler& FiberScheduler::shared()
+{
+  static auto* scheduler = [] {
+    const char* threads = std::getenv("MAL_THREADS");
+
+    return new FiberScheduler(threads ? std::strtoul(threads, nullptr, 10) : std::thread::hardware_concurrency());
+  }();
+
+  return *scheduler;
+}
+
+void FiberScheduler::spawn(function<void()> body)
+{
+  auto worker = next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+  enqueue(new Fiber(*this, worker, std::move(body)));
+}
+
+void FiberScheduler::enqueue(Fiber* fiber)
+{
+  auto& worker = *workers_[fiber->worker_];
+
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.fibers.push_back(fiber);
+  }
+
+  worker.ready.notify_one();
+}
+
+char* FiberScheduler::allocateStack(Worker& worker)
+{
+  if(!worker.freeStacks.empty())
+  {
+    auto* stack = worker.freeStacks.back();
+    worker.freeStacks.pop_back();
+
+    return stack;
+  }
+
+  std::lock_guard<std::mutex> lock(slabMutex_);
+
+  if(slabStacks_.empty())
+  {
+    // Reserved but not committed: a stack only costs the pages it touches.
+    void* slab = mmap(nullptr, stackSize * stacksPerSlab, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+
+    if(slab == MAP_FAILED) throw std::bad_alloc();
+
+    for(size_t i = 0; i < stacksPerSlab; ++i)
+    {
+      slabStacks_.push_back(static_cast<char*>(slab) + i * stackSize);
+    }
+  }
+
+  auto* stack = slabStacks_.back();
+  slabStacks_.pop_back();
+
+  return stack;
+}
+
+void FiberScheduler::start()
+{
+  auto* fiber = currentFiber;
+
+  // Nothing may escape: there is no frame above this one to unwind into.
+  try
+  {
+    fiber->body_();
+  }
+  catch(...)
+  {
+  }
+
+  fiber->finished_ = true;
+  switchSanitizerFiber(schedulerSanitizerFiber);
+  swapcontext(&fiber->context_, schedulerContext);
+}
+
+void FiberScheduler::makeContext(Fiber* fiber)
+{
+  getcontext(&fiber->context_);
+  fiber->context_.uc_stack.ss_sp = fiber->stack_;
+  fiber->context_.uc_stack.ss_size = stackSize;
+  fiber->context_.uc_link = nullptr;
+  makecontext(&fiber->context_, &FiberScheduler::start, 0);
+}
+
+void FiberScheduler::work(size_t self)
+{
+  auto& worker = *workers_[self];
+  schedulerContext = &worker.context;
+  schedulerSanitizerFiber = currentSanitizerFiber();
+
+  while(true)
+  {
+    Fiber* fiber;
+
+    {
+      std::unique_lock<std::mutex> lock(worker.mutex);
+      worker.ready.wait(lock, [&worker] { return !worker.fibers.empty(); });
+
+      fiber = worker.fibers.front();
+      worker.fibers.pop_front();
+    }
+
+    if(!fiber->stack_)
+    {
+      fiber->stack_ = allocateStack(worker);
+      makeContext(fiber);
+      fiber->sanitizerFiber_ = createSanitizerFiber();
+    }
+
+    currentFiber = fiber;
+    fiberStackLimit = fiber->stack_ + stackReserve;
+
+    switchSanitizerFiber(fiber->sanitizerFiber_);
+    swapcontext(&worker.context, &fiber->context_);
+
+    currentFiber = nullptr;
+    fiberStackLimit = nullptr;
+
+    if(fiber->finished_)
+    {
+      worker.freeStacks.push_back(fiber->stack_);
+      destroySanitizerFiber(fiber->sanitizerFiber_);
+      delete fiber;
+    }
+  }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ucontext.h>
+
+using std::function;
+using std::vector;
+
+class FiberScheduler;
+
+// A green thread for go blocks. It runs on a small stack of its own, so a
+// parked go block holds no OS thread. A fiber stays on the worker thread
+// that first ran it: thread_locals seen before a park are the same ones
+// seen after it, and a resume can never run it before it has parked.
+class Fiber
+{
+  friend class FiberScheduler;
+
+  ucontext_t context_;
+  char* stack_;
+  void* sanitizerFiber_;
+  function<void()> body_;
+  FiberScheduler& scheduler_;
+  size_t worker_;
+  bool finished_;
+
+  Fiber(FiberScheduler& scheduler, size_t worker, function<void()> body);
+
+public:
+  // The fiber running on this thread, or nullptr on an ordinary thread.
+  static Fiber* current();
+
+  // Suspends the current fiber until someone calls resume() on it.
+  static void park();
+
+  // Queues the fiber to run again on its worker. Safe from any thread.
+  void resume();
+};
+
+// The lowest address EVAL may reach on this thread's fiber stack, or
+// nullptr outside fibers. EVAL checks it so deep recursion in a go block
+// raises a mal error instead of writing past the end of the stack.
+extern thread_local const char* fiberStackLimit;
+
+[[noreturn]] void throwFiberStackOverflow();
+
+inline void checkFiberStack()
+{
+  char probe;
+
+  if(&probe < fiberStackLimit) throwFiberStackOverflow();
+}
+
+// A small fixed set of worker threads, each running its own queue of
+// fibers. Stacks are carved out of large lazily-committed mappings and
+// reused, so spawning a fiber costs neither a thread nor a system call.
+class FiberScheduler
+{
+  struct Worker
+  {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Fiber*> fibers;
+    vector<char*> freeStacks;
+    ucontext_t context;
+  };
+
+  vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_;
+  std::mutex slabMutex_;
+  vector<char*> slabStacks_;
+
+  explicit FiberScheduler(size_t threads);
+
+public:
+  static const size_t stackSize = 1024 * 1024;
+
+  FiberScheduler(const FiberScheduler&) = delete;
+  FiberScheduler& operator=(const FiberScheduler&) = delete;
+
+  // One worker per hardware thread (or $MAL_THREADS), started on first use
+  // and never torn down.
+  static FiberScheduler& shared();
+
+  size_t size() const { return workers_.size(); }
+
+  void spawn(function<void()> body);
+
+private:
+  void enqueue(Fiber* fiber);
+  char* allocateStack(Worker& worker);
+  void work(size_t self);
+
+  static void start();
+
+  // Kept out of work(): getcontext can return twice, and the compiler
+  // can't keep work()'s locals in registers across it.
+  static void makeContext(Fiber* fiber);
+
+  friend class Fiber;
+};
@@ -0,0 +1,91 @@
+#include "futures.hpp"
+#include "pool.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+
+MalType MalPendingRef::deref()
+{
+  WorkStealingPool::shared().await(result_);
+
+  return result_.get();
+}
+
+MalType MalPendingRef::deref(int timeoutMs, const MalType& timeoutValue)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  if(!WorkStealingPool::shared().await(result_, deadline)) return timeoutValue;
+
+  return result_.get();
+}
+
+bool MalPendingRef::isRealized() const
+{
+  return result_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+string MalFuture::getString(bool)
+{
+  return isRealized() ? "#<future :ready>" : "#<future :pending>";
+}
+
+MalPromise::MalPromise(): MalPromise(std::promise<MalType>())
+{
+}
+
+MalPromise::MalPromise(std::promise<MalType> promise):
+  MalPendingRef(promise.get_future().share()), promise_(std::move(promise)), delivered_(false)
+{
+}
+
+string MalPromise::getString(bool)
+{
+  return isRealized() ? "#<promise :ready>" : "#<promise :pending>";
+}
+
+bool MalPromise::deliver(const MalType& value)
+{
+  if(delivered_.exchange(true)) return false;
+
+  promise_.set_value(value);
+
+  return true;
+}
+
+MalType MalFutureCallOperation::apply(const vector<MalType>& args)
+{
+  auto function = args[0];
+
+  if(!dynamic_cast<MalOperation*>(&*function)) throw TypeException("Cannot call " + Printer::prStr(function, true));
+
+  interpreter_.shareEnvironments();
+
+  auto result = WorkStealingPool::shared().submit<MalType>([function] {
+    return dynamic_cast<MalOperation*>(&*function)->apply({});
+  });
+
+  return MalType(new MalFuture(std::move(result)));
+}
+
+MalType MalPromiseOperation::apply(const vector<MalType>&)
+{
+  return MalType(new MalPromise());
+}
+
+MalType MalDeliverOperation::apply(const vector<MalType>& args)
+{
+  auto* promise = dynamic_cast<MalPromise*>(&*args[0]);
+
+  if(!promise) throw TypeException("Cannot deliver to " + Printer::prStr(args[0], true));
+
+  return promise->deliver(args[1]) ? args[0] : MNil;
+}
+
+MalType MalIsRealizedOperation::apply(const vector<MalType>& args)
+{
+  auto* pending = dynamic_cast<MalPendingRef*>(&*args[0]);
+
+  if(!pending) throw TypeException("Cannot check whether " + Printer::prStr(args[0], true) + " is realized");
+
+  return pending->isRealized() ? MTrue : MFalse;
+}
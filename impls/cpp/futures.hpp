@@ -0,0 +1,83 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <atomic>
+#include <future>
+
+// A value that arrives later. deref blocks until it does, optionally up to a
+// timeout. The value itself is shared with the waiting thread as-is, which
+// is safe because mal data is immutable and atoms synchronize themselves.
+class MalPendingRef : public MalDerefable
+{
+protected:
+  std::shared_future<MalType> result_;
+
+public:
+  MalPendingRef(std::shared_future<MalType> result): result_(result) {}
+
+  virtual MalType deref() override;
+
+  MalType deref(int timeoutMs, const MalType& timeoutValue);
+
+  bool isRealized() const;
+};
+
+// The handle for (future-call f); f runs on the shared work-stealing pool.
+class MalFuture : public MalPendingRef
+{
+public:
+  MalFuture(std::future<MalType> result): MalPendingRef(result.share()) {}
+
+  virtual string getString(bool printReadably) override;
+};
+
+class MalPromise : public MalPendingRef
+{
+  std::promise<MalType> promise_;
+  std::atomic<bool> delivered_;
+
+  MalPromise(std::promise<MalType> promise);
+
+public:
+  MalPromise();
+
+  virtual string getString(bool printReadably) override;
+
+  // Only the first delivery wins; later ones return false.
+  bool deliver(const MalType& value);
+};
+
+class MalFutureCallOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalFutureCallOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalPromiseOperation : public MalOperation
+{
+public:
+  MalPromiseOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalDeliverOperation : public MalOperation
+{
+public:
+  MalDeliverOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalIsRealizedOperation : public MalOperation
+{
+public:
+  MalIsRealizedOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
@@ -0,0 +1,522 @@
+#include "heap.hpp"
+#include "allocstats.hpp"
+#include "error.hpp"
+#include "interpreter.hpp"
+#include "printer.hpp"
+
+#include <algorithm>
+#include <shared_mutex>
+#include <typeindex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <malloc.h>
+
+// A std::map node: the red-black links and colour, then the entry.
+static const size_t mapNodeBytes = 4 * sizeof(void*) + sizeof(std::pair<const string, MalType>);
+
+void HeapVisitor::text(const string& text)
+{
+  // Short strings live inside the string object itself.
+  const char* data = text.data();
+  bool inPlace = data >= reinterpret_cast<const char*>(&text) && data < reinterpret_cast<const char*>(&text + 1);
+
+  if(!inPlace) block(data);
+}
+
+void HeapVisitor::elements(const vector<MalType>& elements)
+{
+  buffer(elements);
+
+  for(const auto& element : elements)
+  {
+    value(element);
+  }
+}
+
+void HeapVisitor::entries(const map<string, MalType>& entries)
+{
+  bytes(entries.size() * mapNodeBytes);
+
+  for(const auto& entry : entries)
+  {
+    text(entry.first);
+    value(entry.second);
+  }
+}
+
+size_t Heap::blockSize(const void* block)
+{
+  return block ? malloc_usable_size(const_cast<void*>(block)) : 0;
+}
+
+namespace
+{
+  // Depth first with explicit stacks, since lazy seqs and environments can
+  // chain further than the native stack goes.
+  class Walker : public HeapVisitor
+  {
+    std::unordered_set<const void*> seen_;
+    vector<MalType> values_;
+    vector<Env> envs_;
+    std::unordered_map<std::type_index, Heap::Counts> types_;
+    Heap::Counts* charged_ = nullptr;
+
+    void charge(size_t count)
+    {
+      charged_->bytes += count;
+    }
+
+  public:
+    void value(const MalType& value) override
+    {
+      // nil, true and false are statics with no control block: nothing to
+      // count.
+      if(value.use_count() == 0) return;
+
+      if(seen_.insert(&*value).second) values_.push_back(value);
+    }
+
+    void env(const Env& env) override
+    {
+      if(env && seen_.insert(&*env).second) envs_.push_back(env);
+    }
+
+    bool once(const void* object) override
+    {
+      return seen_.insert(object).second;
+    }
+
+    void block(const void* block) override
+    {
+      charge(Heap::blockSize(block));
+    }
+
+    void bytes(size_t count) override
+    {
+      charge(count);
+    }
+
+    // A live value from AllocStats, which holds no reference to it.
+    void live(const MalTypeData* value)
+    {
+      if(seen_.insert(value).second) values_.push_back(MalType(MalType(), const_cast<MalTypeData*>(value)));
+    }
+
+    // Marks env as walked without walking it.
+    void skip(const Env& env)
+    {
+      seen_.insert(&*env);
+    }
+
+    void walk()
+    {
+      while(!values_.empty() || !envs_.empty())
+      {
+        if(!values_.empty())
+        {
+          auto value = std::move(values_.back());
+          values_.pop_back();
+
+          charged_ = &types_[typeid(*value)];
+          ++charged_->objects;
+          charge(AllocStats::sizeOf(&*value));
+
+          value->traverse(*this);
+        }
+        else
+        {
+          auto env = std::move(envs_.back());
+          envs_.pop_back();
+
+          charged_ = &types_[typeid(EnvData)];
+          ++charged_->objects;
+          charge(Heap::blockSize(&*env));
+
+          env->traverse(*this);
+        }
+      }
+    }
+
+    // Drops the counts so far, keeping what has been seen.
+    void forget()
+    {
+      types_.clear();
+    }
+
+    Heap::Census census() const
+    {
+      Heap::Census census;
+
+      for(const auto& pair : types_)
+      {
+        census.byType[AllocStats::typeName(pair.first)] = pair.second;
+        census.total.objects += pair.second.objects;
+        census.total.bytes += pair.second.bytes;
+      }
+
+      return census;
+    }
+  };
+}
+
+namespace
+{
+  // A value or an environment, by address.
+  struct Node
+  {
+    const MalTypeData* value;
+    const EnvData* env;
+
+    const void* key() const
+    {
+      return value ? static_cast<const void*>(value) : env;
+    }
+  };
+
+  // What a value or an environment refers to directly. A lazy seq chunk is
+  // followed only for the first seq that reaches it.
+  class Children : public HeapVisitor
+  {
+    std::unordered_set<const void*> chunks_;
+
+  public:
+    vector<MalType> values;
+    vector<Env> envs;
+
+    void value(const MalType& value) override
+    {
+      if(value.use_count() != 0) values.push_back(value);
+    }
+
+    void env(const Env& env) override
+    {
+      if(env) envs.push_back(env);
+    }
+
+    bool once(const void* object) override
+    {
+      return chunks_.insert(object).second;
+    }
+
+    void block(const void*) override {}
+    void bytes(size_t) override {}
+
+    void of(const Node& node)
+    {
+      values.clear();
+      envs.clear();
+
+      if(node.value) node.value->traverse(*this);
+      else node.env->traverse(*this);
+    }
+  };
+
+  string describe(const Node& node)
+  {
+    if(node.value) return Printer::summarize(MalType(MalType(), const_cast<MalTypeData*>(node.value)), 1);
+
+    size_t depth = node.env->depth();
+
+    return depth ? "environment " + std::to_string(depth) + " deep" : "global environment";
+  }
+
+  // How holder refers to child.
+  string via(const Node& holder, const Node& child)
+  {
+    if(holder.env)
+    {
+      for(const auto& binding : holder.env->getBindings())
+      {
+        if(&*binding.second == child.value) return "binding " + binding.first;
+      }
+
+      return "outer environment";
+    }
+
+    const auto& type = typeid(*holder.value);
+
+    if(type == typeid(MalHashMap))
+    {
+      for(const auto& entry : static_cast<const MalHashMap*>(holder.value)->getEntries())
+      {
+        if(&*entry.second == child.value) return "key " + entry.first;
+      }
+    }
+
+    if(type == typeid(MalList) || type == typeid(MalVector))
+    {
+      auto* enumerable = const_cast<MalEnumerable*>(static_cast<const MalEnumerable*>(holder.value));
+
+      for(size_t i = 0; i < enumerable->size(); ++i)
+      {
+        if(&*(*enumerable)[i] == child.value) return "index " + std::to_string(i);
+      }
+    }
+
+    if(type == typeid(MalAtom)) return "deref";
+
+    if(type == typeid(MalFunction))
+    {
+      if(child.env) return "closure";
+
+      return &*static_cast<const MalFunction*>(holder.value)->getBody() == child.value ? "body" : "parameters";
+    }
+
+    return "element";
+  }
+
+  // The links from the first node to the last, each node holding the next.
+  vector<Heap::Link> chain(const vector<Node>& nodes)
+  {
+    vector<Heap::Link> links;
+
+    for(size_t i = 0; i + 1 < nodes.size(); ++i)
+    {
+      links.push_back({ describe(nodes[i]), via(nodes[i], nodes[i + 1]) });
+    }
+
+    return links;
+  }
+}
+
+Heap::Census Heap::reachable(const vector<MalType>& values, const vector<Env>& envs)
+{
+  Walker walker;
+
+  for(const auto& value : values)
+  {
+    walker.value(value);
+  }
+
+  for(const auto& env : envs)
+  {
+    walker.env(env);
+  }
+
+  walker.walk();
+
+  return walker.census();
+}
+
+Heap::Counts Heap::deepSize(const MalType& value, const MalType& excluding, const Env& boundary)
+{
+  Walker walker;
+
+  if(boundary) walker.skip(boundary);
+
+  if(excluding)
+  {
+    walker.value(excluding);
+    walker.walk();
+    walker.forget();
+  }
+
+  walker.value(value);
+  walker.walk();
+
+  return walker.census().total;
+}
+
+Heap::Census Heap::live(const vector<Env>& envs)
+{
+  Census census;
+
+  AllocStats::inspectLive([&](const vector<const MalTypeData*>& values) {
+    Walker walker;
+
+    for(const auto* value : values)
+    {
+      walker.live(value);
+    }
+
+    for(const auto& env : envs)
+    {
+      walker.env(env);
+    }
+
+    walker.walk();
+    census = walker.census();
+  });
+
+  return census;
+}
+
+vector<Heap::Link> Heap::retainers(const MalType& value, const Env& root)
+{
+  // nil, true and false are held by nothing.
+  if(value.use_count() == 0) return {};
+
+  const Node target = { &*value, nullptr };
+
+  // Breadth first from root, so the chain is a shortest one. Everything
+  // visited is kept, so the holders on it can still be described if other
+  // threads drop them meanwhile.
+  struct Visited
+  {
+    MalType value;
+    Env env;
+  };
+
+  vector<Visited> visited = { { nullptr, root } };
+  std::unordered_map<const void*, Node> heldBy = { { &*root, { nullptr, &*root } } };
+  Children children;
+
+  for(size_t i = 0; i < visited.size() && !heldBy.count(target.key()); ++i)
+  {
+    Node holder = { visited[i].value ? &*visited[i].value : nullptr, visited[i].env ? &*visited[i].env : nullptr };
+    children.of(holder);
+
+    for(const auto& child : children.values)
+    {
+      if(heldBy.emplace(&*child, holder).second) visited.push_back({ child, nullptr });
+    }
+
+    for(const auto& env : children.envs)
+    {
+      if(heldBy.emplace(&*env, holder).second) visited.push_back({ nullptr, env });
+    }
+  }
+
+  if(heldBy.count(target.key()))
+  {
+    vector<Node> nodes = { target };
+
+    for(const void* key = target.key(); key != &*root;)
+    {
+      nodes.push_back(heldBy.at(key));
+      key = nodes.back().key();
+    }
+
+    std::reverse(nodes.begin(), nodes.end());
+
+    return chain(nodes);
+  }
+
+  if(!AllocStats::compiledIn()) return {};
+
+  vector<Link> links;
+
+  // Back from value through every live value and the environments they
+  // reach, to the nearest holder nothing else holds.
+  AllocStats::inspectLive([&](const vector<const MalTypeData*>& values) {
+    std::unordered_map<const void*, vector<Node>> holders;
+    vector<Env> envs = { root };
+    std::unordered_set<const void*> seenEnvs = { &*root };
+    Children children;
+
+    auto record = [&](const Node& holder) {
+      children.of(holder);
+
+      for(const auto& child : children.values)
+      {
+        holders[&*child].push_back(holder);
+      }
+
+      for(const auto& env : children.envs)
+      {
+        holders[&*env].push_back(holder);
+
+        if(seenEnvs.insert(&*env).second) envs.push_back(env);
+      }
+    };
+
+    for(const auto* live : values)
+    {
+      record({ live, nullptr });
+    }
+
+    for(size_t i = 0; i < envs.size(); ++i)
+    {
+      record({ nullptr, &*envs[i] });
+    }
+
+    vector<Node> queue = { target };
+    std::unordered_map<const void*, Node> holds;
+    Node top = target;
+
+    for(size_t i = 0; i < queue.size(); ++i)
+    {
+      top = queue[i];
+      auto found = holders.find(top.key());
+
+      if(found == holders.end()) break;
+
+      for(const auto& holder : found->second)
+      {
+        if(holder.key() != target.key() && holds.emplace(holder.key(), top).second) queue.push_back(holder);
+      }
+    }
+
+    vector<Node> nodes = { top };
+
+    while(nodes.back().key() != target.key())
+    {
+      nodes.push_back(holds.at(nodes.back().key()));
+    }
+
+    links.push_back({ "running code", "" });
+
+    for(auto& link : chain(nodes))
+    {
+      links.push_back(std::move(link));
+    }
+  });
+
+  return links;
+}
+
+// Walks read environments, which futures may be defining things in.
+static std::shared_lock<std::shared_mutex> lockEnvs(Interpreter& interpreter)
+{
+  if(!interpreter.isShared()) return {};
+
+  return std::shared_lock<std::shared_mutex>(interpreter.getEnvMutex());
+}
+
+MalType MalHeapCensusOperation::apply(const vector<MalType>&)
+{
+  auto lock = lockEnvs(interpreter_);
+  auto census = AllocStats::compiledIn() ? Heap::live({ interpreter_.getEnv() })
+                                         : Heap::reachable({}, { interpreter_.getEnv() });
+
+  map<string, MalType> types;
+
+  for(const auto& pair : census.byType)
+  {
+    types['"' + pair.first + '"'] = MalType(new MalHashMap(map<string, MalType>{
+      { ":objects", MalInt::of(pair.second.objects) },
+      { ":bytes", MalInt::of(pair.second.bytes) }
+    }));
+  }
+
+  return MalType(new MalHashMap(std::move(types)));
+}
+
+MalType MalDeepSizeOperation::apply(const vector<MalType>& args)
+{
+  if(args.empty() || args.size() > 2) throw TypeException("deep-size takes a value and optionally a base value");
+
+  auto lock = lockEnvs(interpreter_);
+
+  return MalInt::of(Heap::deepSize(args[0], args.size() == 2 ? args[1] : nullptr, interpreter_.getEnv()).bytes);
+}
+
+MalType MalRetainersOperation::apply(const vector<MalType>& args)
+{
+  if(args.size() != 1) throw TypeException("retainers takes one value");
+
+  auto lock = lockEnvs(interpreter_);
+  auto links = Heap::retainers(args[0], interpreter_.getEnv());
+
+  if(links.empty()) return MNil;
+
+  vector<MalType> steps;
+
+  for(const auto& link : links)
+  {
+    steps.push_back(MalType(new MalString(link.via.empty() ? link.holder : link.holder + ": " + link.via)));
+  }
+
+  return MalType(new MalList(std::move(steps)));
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "types.hpp"
+#include "env.hpp"
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// What MalTypeData::traverse reports to: the values and environments a
+// value refers to, and the memory it owns besides its own allocation.
+class HeapVisitor
+{
+public:
+  virtual ~HeapVisitor() = default;
+
+  virtual void value(const MalType& value) = 0;
+  virtual void env(const Env& env) = 0;
+
+  // True the first time it is given object, for shared parts that aren't
+  // values, like lazy seq chunks.
+  virtual bool once(const void* object) = 0;
+
+  // A block from operator new the value owns outright, or nullptr.
+  virtual void block(const void* block) = 0;
+
+  // Memory that isn't one block, like a map's nodes, estimated.
+  virtual void bytes(size_t count) = 0;
+
+  void text(const string& text);
+  void elements(const vector<MalType>& elements);
+  void entries(const map<string, MalType>& entries);
+
+  template<typename T>
+  void buffer(const vector<T>& buffer)
+  {
+    if(buffer.capacity()) block(buffer.data());
+  }
+};
+
+// Walks the values and environments reachable from a set of roots. Each is
+// counted once however many paths lead to it, so structure that values
+// share is not counted twice. Sizes are what the allocator handed out,
+// rounding included; the shared_ptr control blocks aren't counted. The
+// contents of channels, futures and unrealized lazy seqs aren't followed.
+class Heap
+{
+public:
+  struct Counts
+  {
+    size_t objects = 0;
+    size_t bytes = 0;
+  };
+
+  struct Census
+  {
+    Counts total;
+
+    // Keyed by demangled type name; environments count as EnvData.
+    map<string, Counts> byType;
+  };
+
+  static Census reachable(const vector<MalType>& values, const vector<Env>& envs = {});
+
+  // What value reaches, leaving out what excluding reaches, if given: the
+  // memory value adds to excluding rather than shares with it. The walk
+  // doesn't go into boundary, usually the global environment, which every
+  // closure reaches.
+  static Counts deepSize(const MalType& value, const MalType& excluding = nullptr, const Env& boundary = nullptr);
+
+  // Every live value, with the memory it owns, and the environments they
+  // and envs reach. Needs AllocStats' list of live values; empty unless
+  // AllocStats::compiledIn(). Other threads should be idle.
+  static Census live(const vector<Env>& envs);
+
+  // One step in a chain keeping a value alive: a description of a holder
+  // and how it holds the next one, like "key :users" or "binding cache".
+  struct Link
+  {
+    string holder;
+    string via;
+  };
+
+  // The shortest chain from root to value, root first, or nothing if root
+  // doesn't reach it. In instrumented builds, a value root doesn't reach is
+  // traced back through the live values instead, to a holder that no value
+  // or environment holds: that one is held by running code.
+  static vector<Link> retainers(const MalType& value, const Env& root);
+
+  // The size of a block from operator new.
+  static size_t blockSize(const void* block);
+};
+
+// (heap-census) maps each type name, EnvData included, to a map of
+// :objects and :bytes. In an instrumented build it counts every live
+// value; otherwise only what the global environment reaches. Bytes
+// include the buffers and strings values own.
+class MalHeapCensusOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalHeapCensusOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (deep-size x) is the bytes x and everything it reaches take, counting
+// what x shares with itself once and leaving out the global environment.
+// (deep-size x base) counts only what x doesn't share with base, like the
+// cost of an assoc over the map it was made from.
+class MalDeepSizeOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalDeepSizeOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (retainers x) lists how x is kept alive, outermost holder first, like
+// ("global environment: binding cache" "(atom {...}): deref" ...), or nil
+// if nothing found holds it. See Heap::retainers.
+class MalRetainersOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalRetainersOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
@@ -0,0 +1,209 @@
+#include "interpreter.hpp"
+#include "reader.hpp"
+#include "printer.hpp"
+#include "evaluator.hpp"
+#include "error.hpp"
+#include "core.hpp"
+#include "tracer.hpp"
+
+static const char* prelude[] = {
+  "(def! not (fn* (a) (if a false true)))",
+  "(def! load-file (fn* (f) (eval (read-string (str \"(do \" (slurp f) \"\nnil)\")))))",
+  "(defmacro! cond (fn* (& xs) (if (> (count xs) 0) (list 'if (first xs) (if (> (count xs) 1) (nth xs 1) (throw \"odd number of forms to cond\")) (cons 'cond (rest (rest xs)))))))",
+  "(defmacro! future (fn* (& body) (list 'future-call (list 'fn* () (cons 'do body)))))",
+  "(defmacro! go (fn* (& body) (list 'go-call (list 'fn* () (cons 'do body)))))",
+  "(defmacro! lazy-seq (fn* (& body) (list 'lazy-seq-call (list 'fn* () (cons 'do body)))))"
+};
+
+Interpreter::Interpreter(ostream& output, istream& input): shared_(false)
+{
+  Tracer::startFromEnvironment();
+
+  env_ = Env(new EnvData(this));
+  output_ = &output;
+  input_ = &input;
+
+  for(const auto& pair : Core::ns(*this))
+  {
+    env_->set(pair.first, pair.second);
+  }
+
+  env_->set("*host-language*", MalType(new MalString("c++")));
+
+  // The prelude is parsed once per process and copied into each instance,
+  // so interpreters on different threads never share its reference counts.
+  static const vector<MalType> preludeForms = [] {
+    vector<MalType> forms;
+
+    for(const auto* source : prelude)
+    {
+      forms.push_back(Tokenizer::readStr(source));
+    }
+
+    return forms;
+  }();
+
+  for(const auto& form : preludeForms)
+  {
+    eval(form->deepCopy());
+  }
+}
+
+Interpreter::~Interpreter()
+{
+  env_->clear();
+}
+
+MalType Interpreter::read(const string& input)
+{
+  Tracer::Span span("read", "read");
+
+  return Tokenizer::readStr(input);
+}
+
+MalType Interpreter::eval(const MalType& ast)
+{
+  return EVAL(ast, env_);
+}
+
+MalType Interpreter::eval(const string& input)
+{
+  return eval(read(input));
+}
+
+string Interpreter::print(const MalType& value)
+{
+  return Printer::prStr(value, true);
+}
+
+string Interpreter::rep(const string& input)
+{
+  auto start = LatencyHistogram::now();
+  auto ast = read(input);
+  auto readDone = LatencyHistogram::now();
+  latency_.read.record(readDone - start);
+
+  auto value = eval(ast);
+  auto evalDone = LatencyHistogram::now();
+  latency_.eval.record(evalDone - readDone);
+
+  auto printed = print(value);
+  latency_.print.record(LatencyHistogram::now() - evalDone);
+
+  return printed;
+}
+
+MalType Interpreter::call(const MalType& function, const vector<MalType>& args)
+{
+  auto* operation = dynamic_cast<MalOperation*>(&*function);
+
+  if(!operation) throw TypeException("Cannot call " + Printer::prStr(function, true));
+
+  return operation->apply(args);
+}
+
+MalType Interpreter::call(const string& name, const vector<MalType>& args)
+{
+  return call(env_->get(name), args);
+}
+
+void Interpreter::setArgv(const vector<string>& args)
+{
+  vector<MalType> elements;
+
+  for(const auto& arg : args)
+  {
+    elements.push_back(toMal(arg));
+  }
+
+  env_->set("*ARGV*", toMal(elements));
+}
+
+MalType Interpreter::loadFile(const string& path)
+{
+  Tracer::Span span("io", "load-file", Tracer::enabled() ? "\"path\": " + Tracer::quote(path) : "");
+
+  // Unlike mal's load-file, which evaluates the whole file as one do
+  // form, this reads and evaluates a form at a time to time each one.
+  auto source = toString(call("slurp", { toMal(path) }));
+  auto tokenizer = std::make_shared<Tokenizer>(source);
+
+  while(!tokenizer->eof())
+  {
+    auto start = LatencyHistogram::now();
+    MalType ast;
+
+    {
+      // The same span read() makes, so traced scripts show their reads.
+      Tracer::Span span("read", "read");
+      ast = Tokenizer::readFrom(tokenizer);
+    }
+
+    auto readDone = LatencyHistogram::now();
+    latency_.read.record(readDone - start);
+
+    eval(ast);
+    latency_.eval.record(LatencyHistogram::now() - readDone);
+  }
+
+  return MNil;
+}
+
+MalType Interpreter::toMal(int64_t value)
+{
+  return MalInt::of(value);
+}
+
+MalType Interpreter::toMal(const string& value)
+{
+  return MalType(new MalString(value));
+}
+
+MalType Interpreter::toMal(const char* value)
+{
+  return toMal(string(value));
+}
+
+MalType Interpreter::toMal(bool value)
+{
+  return value ? MTrue : MFalse;
+}
+
+MalType Interpreter::toMal(const vector<MalType>& elements)
+{
+  return MalType(new MalList(elements));
+}
+
+int64_t Interpreter::toInt(const MalType& value)
+{
+  auto* malInt = dynamic_cast<MalInt*>(&*value);
+
+  if(!malInt) throw TypeException("Expected a number but got " + Printer::prStr(value, true));
+
+  return *(*malInt);
+}
+
+string Interpreter::toString(const MalType& value)
+{
+  auto* malString = dynamic_cast<MalString*>(&*value);
+
+  if(!malString) throw TypeException("Expected a string but got " + Printer::prStr(value, true));
+
+  return *(*malString);
+}
+
+bool Interpreter::toBool(const MalType& value)
+{
+  return value != MNil && value != MFalse;
+}
+
+vector<MalType> Interpreter::toVector(const MalType& value)
+{
+  if(value == MNil) return {};
+
+  auto* enumerable = dynamic_cast<MalEnumerable*>(&*value);
+
+  if(!enumerable) throw TypeException("Expected a list or vector but got " + Printer::prStr(value, true));
+
+  return vector<MalType>(enumerable->begin(), enumerable->end());
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "types.hpp"
+#include "env.hpp"
+#include "evaluator.hpp"
+#include "latency.hpp"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::istream;
+
+// An independent mal instance: it owns its global environment, its own copy
+// of the core namespace and its special forms, and writes to its own sinks.
+// Values created by one interpreter must not outlive it, since functions and
+// I/O operations refer back to the interpreter that made them.
+class Interpreter
+{
+  SpecialForms specialForms_;
+  Env env_;
+  ostream* output_;
+  istream* input_;
+
+  std::atomic<bool> shared_;
+  std::shared_mutex envMutex_;
+  std::mutex outputMutex_;
+
+  LatencyStats latency_;
+
+public:
+  Interpreter(ostream& output = std::cout, istream& input = std::cin);
+
+  // Clears the global environment, which every top-level closure holds a
+  // reference cycle with.
+  ~Interpreter();
+
+  Interpreter(const Interpreter&) = delete;
+  Interpreter& operator=(const Interpreter&) = delete;
+
+  MalType read(const string& input);
+  MalType eval(const MalType& ast);
+  MalType eval(const string& input);
+  string print(const MalType& value);
+
+  string rep(const string& input);
+
+  MalType call(const MalType& function, const vector<MalType>& args);
+  MalType call(const string& name, const vector<MalType>& args);
+
+  void setArgv(const vector<string>& args);
+  MalType loadFile(const string& path);
+
+  Env getEnv() const { return env_; }
+
+  SpecialForms& getSpecialForms() { return specialForms_; }
+  const SpecialForms& getSpecialForms() const { return specialForms_; }
+
+  ostream& getOutput() { return *output_; }
+  istream& getInput() { return *input_; }
+  void setOutput(ostream& output) { output_ = &output; }
+  void setInput(istream& input) { input_ = &input; }
+
+  // Futures evaluate closures of this interpreter on pool threads. The first
+  // one flips the interpreter into shared mode, after which environment
+  // reads take envMutex_ shared and def! takes it exclusively.
+  void shareEnvironments() { shared_.store(true); }
+  bool isShared() const { return shared_.load(std::memory_order_relaxed); }
+  std::shared_mutex& getEnvMutex() { return envMutex_; }
+
+  // Per-form read, eval and print times from rep() and loadFile().
+  const LatencyStats& getLatencyStats() const { return latency_; }
+
+  // Held while prn/println write, so lines from futures don't interleave.
+  std::mutex& getOutputMutex() { return outputMutex_; }
+
+  static MalType toMal(int64_t value);
+  static MalType toMal(int value) { return toMal(static_cast<int64_t>(value)); }
+  static MalType toMal(const string& value);
+  static MalType toMal(const char* value);
+  static MalType toMal(bool value);
+  static MalType toMal(const vector<MalType>& elements);
+
+  static int64_t toInt(const MalType& value);
+  static string toString(const MalType& value);
+  static bool toBool(const MalType& value);
+  static vector<MalType> toVector(const MalType& value);
+};
@@ -0,0 +1,143 @@
+#include "latency.hpp"
+#include "interpreter.hpp"
+#include "numbers.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+int64_t LatencyHistogram::now()
+{
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+// Values below subBuckets get a bucket each. Above that, a value whose top
+// bit is e falls in group e - subBucketBits + 1, and its next subBucketBits
+// bits pick the bucket within the group.
+int LatencyHistogram::bucketOf(uint64_t nanos)
+{
+  if(nanos < static_cast<uint64_t>(subBuckets)) return static_cast<int>(nanos);
+
+  int exponent = 63 - __builtin_clzll(nanos);
+
+  if(exponent > maxExponent) return bucketCount - 1;
+
+  int shift = exponent - subBucketBits;
+  int group = shift + 1;
+
+  return group * subBuckets + static_cast<int>((nanos >> shift) - subBuckets);
+}
+
+uint64_t LatencyHistogram::highestIn(int bucket)
+{
+  int group = bucket / subBuckets;
+  uint64_t sub = bucket % subBuckets;
+
+  if(group == 0) return sub;
+
+  int shift = group - 1;
+
+  return ((subBuckets + sub) << shift) + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t nanos)
+{
+  uint64_t value = nanos > 0 ? static_cast<uint64_t>(nanos) : 0;
+
+  counts_[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t max = max_.load(std::memory_order_relaxed);
+
+  while(value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+uint64_t LatencyHistogram::percentile(double q) const
+{
+  uint64_t count = count_.load(std::memory_order_relaxed);
+
+  if(count == 0) return 0;
+
+  uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * count)));
+  uint64_t seen = 0;
+  uint64_t max = max_.load(std::memory_order_relaxed);
+
+  for(int bucket = 0; bucket < bucketCount; ++bucket)
+  {
+    seen += counts_[bucket].load(std::memory_order_relaxed);
+
+    if(seen >= rank) return std::min(highestIn(bucket), max);
+  }
+
+  return max;
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const
+{
+  uint64_t count = count_.load(std::memory_order_relaxed);
+
+  return {
+    count,
+    count ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / count : 0.0,
+    percentile(0.5),
+    percentile(0.9),
+    percentile(0.99),
+    percentile(0.999),
+    max_.load(std::memory_order_relaxed)
+  };
+}
+
+string LatencyStats::table() const
+{
+  const std::pair<const char*, const LatencyHistogram*> phases[] = {
+    { "read", &read }, { "eval", &eval }, { "print", &print }
+  };
+
+  char line[128];
+  string out;
+
+  snprintf(line, sizeof(line), "%-6s %10s %10s %10s %10s %10s %10s  (us)\n", "phase", "count", "p50", "p90", "p99", "p999", "max");
+  out += line;
+
+  for(const auto& phase : phases)
+  {
+    auto summary = phase.second->summary();
+
+    snprintf(line, sizeof(line), "%-6s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", phase.first,
+             static_cast<unsigned long long>(summary.count), summary.p50 / 1e3, summary.p90 / 1e3,
+             summary.p99 / 1e3, summary.p999 / 1e3, summary.max / 1e3);
+    out += line;
+  }
+
+  return out;
+}
+
+static MalType toMap(const LatencyHistogram& histogram)
+{
+  auto summary = histogram.summary();
+
+  return MalType(new MalHashMap(map<string, MalType>{
+    { ":count", MalInt::of(static_cast<int64_t>(summary.count)) },
+    { ":mean", MalType(new MalDouble(summary.mean)) },
+    { ":p50", MalInt::of(static_cast<int64_t>(summary.p50)) },
+    { ":p90", MalInt::of(static_cast<int64_t>(summary.p90)) },
+    { ":p99", MalInt::of(static_cast<int64_t>(summary.p99)) },
+    { ":p999", MalInt::of(static_cast<int64_t>(summary.p999)) },
+    { ":max", MalInt::of(static_cast<int64_t>(summary.max)) }
+  }));
+}
+
+MalType MalLatencyStatsOperation::apply(const vector<MalType>&)
+{
+  const auto& stats = interpreter_.getLatencyStats();
+
+  return MalType(new MalHashMap(map<string, MalType>{
+    { ":read", toMap(stats.read) },
+    { ":eval", toMap(stats.eval) },
+    { ":print", toMap(stats.print) }
+  }));
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+using std::string;
+
+class Interpreter;
+
+// A log-bucketed histogram of nanosecond durations, in the manner of
+// HdrHistogram: each power of two is split into 32 linear sub-buckets, so a
+// percentile is within about 3% of the true value, from 1 ns up to about
+// half an hour (longer samples land in the last bucket, but max is exact).
+// Recording is a few relaxed atomic adds, safe from any thread.
+class LatencyHistogram
+{
+public:
+  static constexpr int subBucketBits = 5;
+  static constexpr int subBuckets = 1 << subBucketBits;
+  static constexpr int maxExponent = 40;
+  static constexpr int bucketCount = subBuckets * (maxExponent - subBucketBits + 2);
+
+  struct Summary
+  {
+    uint64_t count;
+    double mean;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+  };
+
+  static int64_t now();
+
+  void record(int64_t nanos);
+
+  // The highest value in the bucket holding the sample at rank q, or 0
+  // when empty.
+  uint64_t percentile(double q) const;
+
+  Summary summary() const;
+
+private:
+  std::atomic<uint64_t> counts_[bucketCount] = {};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> max_{0};
+
+  static int bucketOf(uint64_t nanos);
+  static uint64_t highestIn(int bucket);
+};
+
+// Time spent reading, evaluating and printing each top-level form that an
+// interpreter's rep() and loadFile() handle. Forms that throw are left out
+// of the phase they failed in.
+struct LatencyStats
+{
+  LatencyHistogram read;
+  LatencyHistogram eval;
+  LatencyHistogram print;
+
+  // One line per phase with its count and percentiles in microseconds.
+  string table() const;
+};
+
+// (latency-stats) maps :read, :eval and :print to maps of :count, :mean,
+// :p50, :p90, :p99, :p999 and :max, in nanoseconds.
+class MalLatencyStatsOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalLatencyStatsOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
@@ -0,0 +1,574 @@
+#include "lazy.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+#include "transducers.hpp"
+#include "heap.hpp"
+
+// One run of a lazy sequence. It starts out holding only the function that
+// produces it; realizing it fills in its elements and where the sequence
+// goes on, which is rest from restOffset, or nowhere at the end. A chunk
+// with no elements but a rest forwards to it, which is how (lazy-seq ...)
+// hands over to the sequence its body returns without copying it. A view
+// chunk reads the elements of a list or vector in place instead.
+class LazyChunk
+{
+public:
+  typedef function<void(LazyChunk& chunk)> Producer;
+
+  // Filled in by the producer.
+  vector<MalType> elements;
+  shared_ptr<LazyChunk> rest;
+  size_t restOffset;
+
+  LazyChunk(Producer producer);
+  LazyChunk(vector<MalType> elements, shared_ptr<LazyChunk> rest, size_t restOffset);
+  LazyChunk(const MalType& enumerable);
+  ~LazyChunk();
+
+  void realize();
+  bool isRealized() const { return realized_.load(std::memory_order_acquire); }
+
+  // Once realized.
+  size_t size() const { return size_; }
+  const MalType* begin() const { return data_; }
+  const MalType* end() const { return data_ + size_; }
+  const MalType& operator[](size_t index) const { return data_[index]; }
+
+  // This chunk's elements and storage, once realized; not its rest.
+  void traverse(HeapVisitor& visitor) const;
+
+private:
+  std::atomic<bool> realized_;
+  bool realizing_;
+  std::recursive_mutex mutex_;
+  Producer producer_;
+  MalType viewed_;
+  const MalType* data_;
+  size_t size_;
+};
+
+LazyChunk::LazyChunk(Producer producer):
+  restOffset(0), realized_(false), realizing_(false), producer_(std::move(producer)), data_(nullptr), size_(0)
+{
+}
+
+LazyChunk::LazyChunk(vector<MalType> elements, shared_ptr<LazyChunk> rest, size_t restOffset):
+  elements(std::move(elements)), rest(std::move(rest)), restOffset(restOffset), realized_(true), realizing_(false),
+  data_(this->elements.data()), size_(this->elements.size())
+{
+}
+
+LazyChunk::LazyChunk(const MalType& enumerable):
+  restOffset(0), realized_(true), realizing_(false), viewed_(enumerable), data_(nullptr), size_(0)
+{
+  auto* viewed = static_cast<MalEnumerable*>(&*viewed_);
+
+  size_ = viewed->size();
+  data_ = size_ ? &*viewed->begin() : nullptr;
+}
+
+LazyChunk::~LazyChunk()
+{
+  // Free a long realized sequence a link at a time, not through one nested
+  // destructor call per chunk.
+  auto next = std::move(rest);
+
+  while(next && next.use_count() == 1)
+  {
+    auto after = std::move(next->rest);
+    next = std::move(after);
+  }
+}
+
+void LazyChunk::realize()
+{
+  if(realized_.load(std::memory_order_acquire)) return;
+
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+  if(realized_.load(std::memory_order_relaxed)) return;
+
+  // Only the thread already producing this chunk gets past the lock.
+  if(realizing_) throw TypeException("Lazy sequence depends on its own unrealized elements");
+
+  realizing_ = true;
+
+  try
+  {
+    producer_(*this);
+  }
+  catch(...)
+  {
+    elements.clear();
+    rest.reset();
+    realizing_ = false;
+    throw;
+  }
+
+  producer_ = nullptr;
+  data_ = elements.data();
+  size_ = elements.size();
+  realizing_ = false;
+  realized_.store(true, std::memory_order_release);
+}
+
+void LazyChunk::traverse(HeapVisitor& visitor) const
+{
+  // Made with make_shared: the chunk shares a block with its count.
+  visitor.bytes(sizeof(LazyChunk) + 2 * sizeof(void*));
+
+  if(!isRealized()) return;
+
+  if(viewed_)
+  {
+    visitor.value(viewed_);
+    return;
+  }
+
+  visitor.buffer(elements);
+
+  for(const auto& element : *this)
+  {
+    visitor.value(element);
+  }
+}
+
+// Moves chunk and offset on to the chunk holding element offset, realizing
+// chunks on the way. Returns false if the sequence ends first.
+static bool locate(shared_ptr<LazyChunk>& chunk, size_t& offset)
+{
+  while(chunk)
+  {
+    chunk->realize();
+
+    if(offset < chunk->size()) return true;
+
+    offset = offset - chunk->size() + chunk->restOffset;
+    chunk = chunk->rest;
+  }
+
+  return false;
+}
+
+static void produce(const shared_ptr<MalLazySeq::ChunkSource>& source, LazyChunk& chunk)
+{
+  bool more;
+
+  do
+  {
+    more = (*source)(chunk.elements);
+  }
+  while(more && chunk.elements.empty());
+
+  if(more) chunk.rest = std::make_shared<LazyChunk>([source](LazyChunk& next) { produce(source, next); });
+}
+
+static MalOperation* toOperation(const MalType& value)
+{
+  auto* operation = dynamic_cast<MalOperation*>(&*value);
+
+  if(!operation) throw TypeException("Cannot call " + Printer::prStr(value, true));
+
+  return operation;
+}
+
+static int64_t toInt(const MalType& value)
+{
+  auto* malInt = dynamic_cast<MalInt*>(&*value);
+
+  if(!malInt) throw TypeException("Expected a number but got " + Printer::prStr(value, true));
+
+  return **malInt;
+}
+
+static bool buffered(const vector<SeqCursor>& cursors)
+{
+  for(const auto& cursor : cursors)
+  {
+    if(!cursor.buffered()) return false;
+  }
+
+  return true;
+}
+
+// Mal expects an error from the function given to map to be raised by the
+// call itself, so map and filter produce their first chunk straight away
+// when their input is at hand. Over another lazy seq they wait, so a
+// sequence can still be defined in terms of itself.
+static MalType startEarly(const MalType& seq, bool ready)
+{
+  if(ready) static_cast<MalLazySeq*>(&*seq)->hasFirst();
+
+  return seq;
+}
+
+static bool isTruthy(const MalType& value)
+{
+  return !dynamic_cast<MalNil*>(&*value) && !dynamic_cast<MalFalse*>(&*value);
+}
+
+MalLazySeq::MalLazySeq(shared_ptr<LazyChunk> chunk, size_t offset):
+  chunk_(std::move(chunk)), offset_(offset), realized_(false)
+{
+}
+
+void MalLazySeq::realize()
+{
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+  if(realized_) return;
+
+  vector<MalType> elements;
+  auto chunk = chunk_;
+  auto offset = offset_;
+
+  while(locate(chunk, offset))
+  {
+    elements.insert(elements.end(), chunk->begin() + offset, chunk->end());
+    offset = chunk->size();
+  }
+
+  elements_ = std::move(elements);
+  realized_ = true;
+  markRealized();
+}
+
+MalType MalLazySeq::generate(ChunkSource source)
+{
+  auto shared = std::make_shared<ChunkSource>(std::move(source));
+
+  return MalType(new MalLazySeq(std::make_shared<LazyChunk>([shared](LazyChunk& chunk) { produce(shared, chunk); })));
+}
+
+MalType MalLazySeq::defer(const MalType& thunk)
+{
+  toOperation(thunk);
+
+  return MalType(new MalLazySeq(std::make_shared<LazyChunk>([thunk](LazyChunk& chunk) {
+    auto seq = static_cast<MalOperation*>(&*thunk)->apply({});
+
+    if(dynamic_cast<MalNil*>(&*seq)) return;
+
+    if(!dynamic_cast<MalLazySeq*>(&*seq))
+    {
+      seq = dynamic_cast<MalEnumerable*>(&*seq) ? view(seq, 0) : from(SeqCursor(seq));
+    }
+
+    auto* lazySeq = static_cast<MalLazySeq*>(&*seq);
+
+    chunk.rest = lazySeq->chunk_;
+    chunk.restOffset = lazySeq->offset_;
+  })));
+}
+
+MalType MalLazySeq::cons(const MalType& first, const MalLazySeq& rest)
+{
+  return MalType(new MalLazySeq(std::make_shared<LazyChunk>(vector<MalType>{ first }, rest.chunk_, rest.offset_)));
+}
+
+MalType MalLazySeq::view(const MalType& enumerable, size_t offset)
+{
+  if(auto* lazySeq = dynamic_cast<MalLazySeq*>(&*enumerable))
+  {
+    return MalType(new MalLazySeq(lazySeq->chunk_, lazySeq->offset_ + offset));
+  }
+
+  return MalType(new MalLazySeq(std::make_shared<LazyChunk>(enumerable), offset));
+}
+
+MalType MalLazySeq::from(SeqCursor cursor)
+{
+  return generate([cursor](vector<MalType>& chunk) mutable {
+    MalType value;
+
+    while(chunk.size() < chunkSize && (chunk.empty() || cursor.buffered()))
+    {
+      if(!cursor.next(value)) return false;
+
+      chunk.push_back(value);
+    }
+
+    return true;
+  });
+}
+
+string MalLazySeq::getString(bool printReadably)
+{
+  string out = "(";
+
+  for(auto itr = begin(); itr != end(); ++itr)
+  {
+    if(itr != begin()) out += " ";
+    out += (*itr)->getString(printReadably);
+  }
+
+  return out + ")";
+}
+
+MalType MalLazySeq::deepCopy() const
+{
+  // The copy goes to another thread's interpreter, which can't run this
+  // sequence's producers, so it is realized into a list.
+  auto* self = const_cast<MalLazySeq*>(this);
+  vector<MalType> elements;
+
+  for(const auto& element : *self)
+  {
+    elements.push_back(element->deepCopy());
+  }
+
+  return MalType(new MalList(std::move(elements)));
+}
+
+// Holds only the chunk it is reading, never the head of the seq.
+class ChunkCursor : public Cursor
+{
+  shared_ptr<LazyChunk> chunk_;
+  size_t offset_;
+
+public:
+  ChunkCursor(shared_ptr<LazyChunk> chunk, size_t offset): chunk_(std::move(chunk)), offset_(offset) {}
+
+  virtual bool next(MalType& value) override
+  {
+    if(!locate(chunk_, offset_)) return false;
+
+    value = (*chunk_)[offset_++];
+    return true;
+  }
+
+  virtual bool buffered() const override
+  {
+    return chunk_ && chunk_->isRealized() && offset_ < chunk_->size();
+  }
+};
+
+shared_ptr<Cursor> MalLazySeq::cursor(const MalType&)
+{
+  return std::make_shared<ChunkCursor>(chunk_, offset_);
+}
+
+void MalLazySeq::traverse(HeapVisitor& visitor) const
+{
+  MalEnumerable::traverse(visitor);
+
+  // Iteratively, since a long realized seq is a long chain of chunks.
+  for(auto* chunk = chunk_.get(); chunk && visitor.once(chunk); chunk = chunk->rest.get())
+  {
+    chunk->traverse(visitor);
+
+    if(!chunk->isRealized()) break;
+  }
+}
+
+bool MalLazySeq::isBuffered() const
+{
+  for(auto chunk = chunk_.get(); chunk; chunk = chunk->rest.get())
+  {
+    if(!chunk->isRealized()) return false;
+  }
+
+  return true;
+}
+
+bool MalLazySeq::hasFirst() const
+{
+  auto chunk = chunk_;
+  auto offset = offset_;
+
+  return locate(chunk, offset);
+}
+
+MalType MalLazySeq::first() const
+{
+  auto value = nth(0);
+
+  return value ? value : MNil;
+}
+
+MalType MalLazySeq::rest() const
+{
+  auto chunk = chunk_;
+  auto offset = offset_;
+
+  if(!locate(chunk, offset)) return MalType(new MalList({}));
+
+  return MalType(new MalLazySeq(chunk, offset + 1));
+}
+
+size_t MalLazySeq::count() const
+{
+  size_t count = 0;
+  auto chunk = chunk_;
+  auto offset = offset_;
+
+  while(locate(chunk, offset))
+  {
+    count += chunk->size() - offset;
+    offset = chunk->size();
+  }
+
+  return count;
+}
+
+MalType MalLazySeq::nth(size_t index) const
+{
+  auto chunk = chunk_;
+  auto offset = offset_ + index;
+
+  if(!locate(chunk, offset)) return nullptr;
+
+  return (*chunk)[offset];
+}
+
+MalType MalLazySeq::toList()
+{
+  return MalType(new MalList(vector<MalType>(begin(), end())));
+}
+
+MalType MalLazySeqOperation::apply(const vector<MalType>& args)
+{
+  return MalLazySeq::defer(args[0]);
+}
+
+MalType MalMapOperation::apply(const vector<MalType>& args)
+{
+  if(args.size() == 1) return MalTransducer::map(args[0]);
+
+  auto function = args[0];
+  auto* operation = toOperation(function);
+  vector<SeqCursor> cursors(args.begin() + 1, args.end());
+  bool ready = buffered(cursors);
+
+  auto seq = MalLazySeq::generate([function, operation, cursors](vector<MalType>& chunk) mutable {
+    vector<MalType> callArgs(cursors.size());
+
+    while(chunk.size() < MalLazySeq::chunkSize && (chunk.empty() || buffered(cursors)))
+    {
+      for(size_t i = 0; i < cursors.size(); ++i)
+      {
+        if(!cursors[i].next(callArgs[i])) return false;
+      }
+
+      chunk.push_back(operation->apply(callArgs));
+    }
+
+    return true;
+  });
+
+  return startEarly(seq, ready);
+}
+
+MalType MalFilterOperation::apply(const vector<MalType>& args)
+{
+  if(args.size() == 1) return MalTransducer::filter(args[0]);
+
+  auto predicate = args[0];
+  auto* operation = toOperation(predicate);
+  SeqCursor cursor(args[1]);
+  bool ready = cursor.buffered();
+
+  auto seq = MalLazySeq::generate([predicate, operation, cursor](vector<MalType>& chunk) mutable {
+    MalType value;
+
+    while(chunk.size() < MalLazySeq::chunkSize && (chunk.empty() || cursor.buffered()))
+    {
+      if(!cursor.next(value)) return false;
+
+      if(isTruthy(operation->apply({ value }))) chunk.push_back(value);
+    }
+
+    return true;
+  });
+
+  return startEarly(seq, ready);
+}
+
+MalType MalRangeOperation::apply(const vector<MalType>& args)
+{
+  int64_t start = args.size() > 1 ? toInt(args[0]) : 0;
+  int64_t step = args.size() > 2 ? toInt(args[2]) : 1;
+  bool bounded = !args.empty();
+  int64_t end = args.size() == 1 ? toInt(args[0]) : bounded ? toInt(args[1]) : 0;
+
+  return MalLazySeq::generate([start, step, bounded, end](vector<MalType>& chunk) mutable {
+    while(chunk.size() < MalLazySeq::chunkSize)
+    {
+      if(bounded && ((step > 0 && start >= end) || (step < 0 && start <= end))) return false;
+
+      chunk.push_back(MalInt::of(start));
+
+      // Past the last int64 there is nothing left to produce.
+      if(__builtin_add_overflow(start, step, &start)) return false;
+    }
+
+    return true;
+  });
+}
+
+MalType MalIterateOperation::apply(const vector<MalType>& args)
+{
+  auto function = args[0];
+  auto* operation = toOperation(function);
+  auto value = args[1];
+  bool started = false;
+
+  return MalLazySeq::generate([function, operation, value, started](vector<MalType>& chunk) mutable {
+    while(chunk.size() < MalLazySeq::chunkSize)
+    {
+      if(started) value = operation->apply({ value });
+
+      started = true;
+      chunk.push_back(value);
+    }
+
+    return true;
+  });
+}
+
+MalType MalSeqTakeOperation::apply(const vector<MalType>& args)
+{
+  int64_t remaining = toInt(args[0]);
+
+  if(args.size() == 1) return MalTransducer::take(remaining);
+
+  SeqCursor cursor(args[1]);
+
+  return MalLazySeq::generate([remaining, cursor](vector<MalType>& chunk) mutable {
+    MalType value;
+
+    while(chunk.size() < MalLazySeq::chunkSize && (chunk.empty() || cursor.buffered()))
+    {
+      if(remaining <= 0 || !cursor.next(value)) return false;
+
+      chunk.push_back(value);
+      --remaining;
+    }
+
+    return remaining > 0;
+  });
+}
+
+MalType MalSeqDropOperation::apply(const vector<MalType>& args)
+{
+  int64_t skip = toInt(args[0]);
+  SeqCursor cursor(args[1]);
+
+  return MalLazySeq::generate([skip, cursor](vector<MalType>& chunk) mutable {
+    MalType value;
+
+    for(; skip > 0; --skip)
+    {
+      if(!cursor.next(value)) return false;
+    }
+
+    while(chunk.size() < MalLazySeq::chunkSize && (chunk.empty() || cursor.buffered()))
+    {
+      if(!cursor.next(value)) return false;
+
+      chunk.push_back(value);
+    }
+
+    return true;
+  });
+}
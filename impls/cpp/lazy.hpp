@@ -0,0 +1,129 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <mutex>
+
+class LazyChunk;
+
+// A sequence realized on demand, chunkSize elements at a time. Realized
+// chunks are cached and shared by every seq that reaches them through rest,
+// and are freed once no seq or cursor refers to them any more, so walking a
+// long sequence with first/rest holds only the chunk in hand.
+//
+// Core functions read it through its cursor and realize only what they
+// use. C++ code that takes it as a MalEnumerable realizes all of it first,
+// which never finishes on an infinite one. The functions that produce
+// elements run on whichever thread first reads them.
+class MalLazySeq : public MalEnumerable
+{
+  shared_ptr<LazyChunk> chunk_;
+  size_t offset_;
+  std::recursive_mutex mutex_;
+  bool realized_;
+
+  virtual void realize() override;
+
+public:
+  static const size_t chunkSize = 32;
+
+  // Fills chunk with up to chunkSize elements and returns false once the
+  // sequence has ended; the last call may still add elements.
+  typedef function<bool(vector<MalType>& chunk)> ChunkSource;
+
+  MalLazySeq(shared_ptr<LazyChunk> chunk, size_t offset = 0);
+
+  static MalType generate(ChunkSource source);
+
+  // The sequence thunk returns when called with no arguments, which may be
+  // another lazy seq, a list or vector, or nil.
+  static MalType defer(const MalType& thunk);
+
+  static MalType cons(const MalType& first, const MalLazySeq& rest);
+
+  // The elements of a list or vector from offset on, sharing its storage.
+  static MalType view(const MalType& enumerable, size_t offset);
+
+  // Whatever cursor has left to read, produced as it is read.
+  static MalType from(SeqCursor cursor);
+
+  virtual string getString(bool printReadably) override;
+
+  virtual MalType deepCopy() const override;
+
+  virtual shared_ptr<Cursor> cursor(const MalType& self) override;
+
+  // Follows only the chunks realized so far.
+  virtual void traverse(HeapVisitor& visitor) const override;
+
+  // Whether every element is realized already, so reading it all runs no
+  // producers. Always true for a view.
+  bool isBuffered() const;
+
+  bool hasFirst() const;
+  MalType first() const;
+  MalType rest() const;
+  size_t count() const;
+
+  // nullptr past the end.
+  MalType nth(size_t index) const;
+
+  MalType toList();
+};
+
+// (lazy-seq-call f), behind the lazy-seq macro.
+class MalLazySeqOperation : public MalOperation
+{
+public:
+  MalLazySeqOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalMapOperation : public MalOperation
+{
+public:
+  MalMapOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalFilterOperation : public MalOperation
+{
+public:
+  MalFilterOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalRangeOperation : public MalOperation
+{
+public:
+  MalRangeOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalIterateOperation : public MalOperation
+{
+public:
+  MalIterateOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalSeqTakeOperation : public MalOperation
+{
+public:
+  MalSeqTakeOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalSeqDropOperation : public MalOperation
+{
+public:
+  MalSeqDropOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
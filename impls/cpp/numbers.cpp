@@ -0,0 +1,266 @@
+#include "numbers.hpp"
+#include "bigint.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <functional>
+#include <typeinfo>
+
+string MalDouble::getString(bool)
+{
+  if(std::isnan(value_)) return "##NaN";
+  if(std::isinf(value_)) return value_ > 0 ? "##Inf" : "##-Inf";
+
+  char buffer[32];
+  auto end = std::to_chars(buffer, buffer + sizeof(buffer), value_).ptr;
+  string out(buffer, end);
+
+  if(out.find_first_of(".e") == string::npos) out += ".0";
+
+  return out;
+}
+
+bool MalDouble::equals(const MalType& other) const
+{
+  auto* otherDouble = dynamic_cast<MalDouble*>(&*other);
+
+  return otherDouble && value_ == otherDouble->value_;
+}
+
+MalType MalDouble::deepCopy() const
+{
+  return MalType(new MalDouble(value_));
+}
+
+// Ordered so that the kind of a mixed operation is the larger of the two.
+enum NumberKind { IntKind, BigKind, DoubleKind };
+
+static NumberKind kindOf(const MalType& value)
+{
+  const auto& type = typeid(*value);
+
+  if(type == typeid(MalInt)) return IntKind;
+  if(type == typeid(MalDouble)) return DoubleKind;
+  if(type == typeid(MalBigInt)) return BigKind;
+
+  throw TypeException("Expected a number but got " + Printer::prStr(value, true));
+}
+
+static int64_t toInt64(const MalType& value)
+{
+  return **static_cast<MalInt*>(&*value);
+}
+
+double MalDouble::toDouble(const MalType& value)
+{
+  switch(kindOf(value))
+  {
+    case IntKind: return static_cast<double>(toInt64(value));
+    case BigKind: return static_cast<MalBigInt*>(&*value)->value().toDouble();
+    default: return **static_cast<MalDouble*>(&*value);
+  }
+}
+
+typedef MalType (*Binary)(const MalType& a, const MalType& b);
+typedef bool (*Test)(const MalType& a, const MalType& b);
+
+// Op supplies the operation on int64_t (returning false on overflow), on
+// BigInt and on double; this builds the table that picks one by kind.
+template<class Op>
+struct Arithmetic
+{
+  static MalType ints(const MalType& a, const MalType& b)
+  {
+    int64_t result;
+
+    if(Op::ints(toInt64(a), toInt64(b), result)) return MalInt::of(result);
+
+    return bigs(a, b);
+  }
+
+  static MalType bigs(const MalType& a, const MalType& b)
+  {
+    return MalBigInt::from(Op::bigs(MalBigInt::toBig(a), MalBigInt::toBig(b)));
+  }
+
+  static MalType doubles(const MalType& a, const MalType& b)
+  {
+    return MalType(new MalDouble(Op::doubles(MalDouble::toDouble(a), MalDouble::toDouble(b))));
+  }
+
+  static constexpr Binary table[3][3] = {
+    { ints, bigs, doubles },
+    { bigs, bigs, doubles },
+    { doubles, doubles, doubles }
+  };
+
+  static MalType apply(const MalType& a, const MalType& b)
+  {
+    return table[kindOf(a)][kindOf(b)](a, b);
+  }
+
+  // (op) is identity, (op x) is (op identity x), and longer calls fold left.
+  static MalType fold(const vector<MalType>& args)
+  {
+    if(args.empty())
+    {
+      if(Op::variadic) return MalInt::of(Op::identity);
+
+      throw TypeException(string(Op::name) + " takes at least one argument");
+    }
+
+    if(args.size() == 1) return apply(MalInt::of(Op::identity), args[0]);
+
+    auto result = apply(args[0], args[1]);
+
+    for(size_t i = 2; i < args.size(); ++i)
+    {
+      result = apply(result, args[i]);
+    }
+
+    return result;
+  }
+};
+
+struct Add
+{
+  static constexpr const char* name = "+";
+  static const bool variadic = true;
+  static const int64_t identity = 0;
+
+  static bool ints(int64_t a, int64_t b, int64_t& result) { return !__builtin_add_overflow(a, b, &result); }
+  static BigInt bigs(const BigInt& a, const BigInt& b) { return a + b; }
+  static double doubles(double a, double b) { return a + b; }
+};
+
+struct Sub
+{
+  static constexpr const char* name = "-";
+  static const bool variadic = false;
+  static const int64_t identity = 0;
+
+  static bool ints(int64_t a, int64_t b, int64_t& result) { return !__builtin_sub_overflow(a, b, &result); }
+  static BigInt bigs(const BigInt& a, const BigInt& b) { return a - b; }
+  static double doubles(double a, double b) { return a - b; }
+};
+
+struct Mult
+{
+  static constexpr const char* name = "*";
+  static const bool variadic = true;
+  static const int64_t identity = 1;
+
+  static bool ints(int64_t a, int64_t b, int64_t& result) { return !__builtin_mul_overflow(a, b, &result); }
+  static BigInt bigs(const BigInt& a, const BigInt& b) { return a * b; }
+  static double doubles(double a, double b) { return a * b; }
+};
+
+struct Div
+{
+  static constexpr const char* name = "/";
+  static const bool variadic = false;
+  static const int64_t identity = 1;
+
+  static bool ints(int64_t a, int64_t b, int64_t& result)
+  {
+    if(b == 0) throw TypeException("Divide by zero");
+
+    // INT64_MIN / -1 is the one quotient that overflows.
+    if(a == INT64_MIN && b == -1) return false;
+
+    result = a / b;
+    return true;
+  }
+
+  static BigInt bigs(const BigInt& a, const BigInt& b)
+  {
+    if(b.isZero()) throw TypeException("Divide by zero");
+
+    return a / b;
+  }
+
+  static double doubles(double a, double b) { return a / b; }
+};
+
+// Compare is a std:: comparison function object. Bignums are compared
+// through BigInt::compare, and NaN makes every comparison false.
+template<class Compare>
+struct Comparison
+{
+  static bool ints(const MalType& a, const MalType& b)
+  {
+    return Compare()(toInt64(a), toInt64(b));
+  }
+
+  static bool bigs(const MalType& a, const MalType& b)
+  {
+    return Compare()(MalBigInt::toBig(a).compare(MalBigInt::toBig(b)), 0);
+  }
+
+  static bool doubles(const MalType& a, const MalType& b)
+  {
+    return Compare()(MalDouble::toDouble(a), MalDouble::toDouble(b));
+  }
+
+  static constexpr Test table[3][3] = {
+    { ints, bigs, doubles },
+    { bigs, bigs, doubles },
+    { doubles, doubles, doubles }
+  };
+
+  static MalType chain(const vector<MalType>& args)
+  {
+    if(args.empty()) throw TypeException("A comparison takes at least one argument");
+
+    if(args.size() == 1) kindOf(args[0]);
+
+    for(size_t i = 1; i < args.size(); ++i)
+    {
+      if(!table[kindOf(args[i - 1])][kindOf(args[i])](args[i - 1], args[i])) return MFalse;
+    }
+
+    return MTrue;
+  }
+};
+
+MalType MalAddOperation::apply(const vector<MalType>& args)
+{
+  return Arithmetic<Add>::fold(args);
+}
+
+MalType MalSubOperation::apply(const vector<MalType>& args)
+{
+  return Arithmetic<Sub>::fold(args);
+}
+
+MalType MalMultOperation::apply(const vector<MalType>& args)
+{
+  return Arithmetic<Mult>::fold(args);
+}
+
+MalType MalDivOperation::apply(const vector<MalType>& args)
+{
+  return Arithmetic<Div>::fold(args);
+}
+
+MalType MalGTOperation::apply(const vector<MalType>& args)
+{
+  return Comparison<std::greater<>>::chain(args);
+}
+
+MalType MalGTEOperation::apply(const vector<MalType>& args)
+{
+  return Comparison<std::greater_equal<>>::chain(args);
+}
+
+MalType MalLTOperation::apply(const vector<MalType>& args)
+{
+  return Comparison<std::less<>>::chain(args);
+}
+
+MalType MalLTEOperation::apply(const vector<MalType>& args)
+{
+  return Comparison<std::less_equal<>>::chain(args);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "types.hpp"
+
+class MalDouble : public MalTypeData
+{
+  double value_;
+
+public:
+  MalDouble(double value): value_(value) {}
+
+  // Shortest form that reads back as the same double, always with a '.' or
+  // exponent so it reads back as a double; ##Inf, ##-Inf and ##NaN otherwise.
+  virtual string getString(bool printReadably) override;
+
+  virtual bool equals(const MalType& other) const override;
+
+  virtual MalType deepCopy() const override;
+
+  double operator*() const { return value_; }
+
+  // The value of any number as a double; throws a TypeException for
+  // anything else.
+  static double toDouble(const MalType& number);
+};
+
+// The arithmetic operations take any number of arguments and fold them left
+// to right. Each step picks a function specialized for its two operands'
+// types from a table: two ints take an overflow-checked int64_t fast path,
+// a bignum makes it exact arbitrary precision, and a double makes it a
+// double. Only / on two integers truncates.
+class MalAddOperation : public MalOperation
+{
+public:
+  MalAddOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalSubOperation : public MalOperation
+{
+public:
+  MalSubOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalMultOperation : public MalOperation
+{
+public:
+  MalMultOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalDivOperation : public MalOperation
+{
+public:
+  MalDivOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// The comparisons hold when they hold between every adjacent pair, so
+// (< a b c) means a < b < c.
+class MalGTOperation : public MalOperation
+{
+public:
+  MalGTOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalGTEOperation : public MalOperation
+{
+public:
+  MalGTEOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalLTOperation : public MalOperation
+{
+public:
+  MalLTOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalLTEOperation : public MalOperation
+{
+public:
+  MalLTEOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
@@ -0,0 +1,251 @@
+#include "parallel.hpp"
+#include "pool.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <typeinfo>
+
+// Below these many elements per chunk the fork-join bookkeeping costs more
+// than it saves. Calling back into mal is far dearer than comparing two
+// native values, so those chunks can be much smaller.
+static const size_t minCallChunk = 256;
+static const size_t minNativeChunk = 4096;
+
+// Extra chunks per worker give stealing something to even out when some
+// elements cost more than others.
+static const size_t chunksPerWorker = 4;
+
+static size_t chunkCount(size_t size, size_t minChunk)
+{
+  auto workers = WorkStealingPool::shared().size();
+
+  if(workers < 2) return 1;
+
+  return std::max<size_t>(1, std::min(size / minChunk, workers * chunksPerWorker));
+}
+
+// Runs body(0..tasks-1): task 0 on the calling thread, the rest on the
+// pool. Returns once all of them finished and rethrows the first failure.
+static void parallelFor(size_t tasks, const function<void(size_t)>& body)
+{
+  auto& pool = WorkStealingPool::shared();
+  vector<std::shared_future<void>> pending;
+
+  for(size_t task = 1; task < tasks; ++task)
+  {
+    pending.push_back(pool.submit<void>([&body, task] { body(task); }).share());
+  }
+
+  std::exception_ptr error;
+
+  try
+  {
+    body(0);
+  }
+  catch(...)
+  {
+    error = std::current_exception();
+  }
+
+  for(auto& result : pending)
+  {
+    pool.await(result);
+
+    try
+    {
+      result.get();
+    }
+    catch(...)
+    {
+      if(!error) error = std::current_exception();
+    }
+  }
+
+  if(error) std::rethrow_exception(error);
+}
+
+// Chunk boundaries for size elements cut into chunks pieces.
+static vector<size_t> chunkBounds(size_t size, size_t chunks)
+{
+  vector<size_t> bounds;
+
+  for(size_t chunk = 0; chunk <= chunks; ++chunk)
+  {
+    bounds.push_back(size * chunk / chunks);
+  }
+
+  return bounds;
+}
+
+static MalOperation* toOperation(const MalType& value)
+{
+  auto* operation = dynamic_cast<MalOperation*>(&*value);
+
+  if(!operation) throw TypeException("Cannot call " + Printer::prStr(value, true));
+
+  return operation;
+}
+
+static vector<MalType> toElements(const MalType& value)
+{
+  if(value == MNil) return {};
+
+  auto* enumerable = dynamic_cast<MalEnumerable*>(&*value);
+
+  if(!enumerable) throw TypeException("Expected a list or vector but got " + Printer::prStr(value, true));
+
+  return vector<MalType>(enumerable->begin(), enumerable->end());
+}
+
+MalType MalPmapOperation::apply(const vector<MalType>& args)
+{
+  auto* operation = toOperation(args[0]);
+  auto elements = toElements(args[1]);
+
+  auto chunks = chunkCount(elements.size(), minCallChunk);
+  auto bounds = chunkBounds(elements.size(), chunks);
+
+  if(chunks > 1) interpreter_.shareEnvironments();
+
+  parallelFor(chunks, [&](size_t chunk) {
+    for(auto i = bounds[chunk]; i < bounds[chunk + 1]; ++i)
+    {
+      elements[i] = operation->apply({ elements[i] });
+    }
+  });
+
+  return MalType(new MalList(elements));
+}
+
+static MalType fold(Interpreter& interpreter, const MalType& combine, const MalType& reduce, const MalType& init, const MalType& coll)
+{
+  auto* combineOperation = toOperation(combine);
+  auto* reduceOperation = toOperation(reduce);
+  auto elements = toElements(coll);
+
+  auto chunks = chunkCount(elements.size(), minCallChunk);
+  auto bounds = chunkBounds(elements.size(), chunks);
+  vector<MalType> partials(chunks, init);
+
+  if(chunks > 1) interpreter.shareEnvironments();
+
+  parallelFor(chunks, [&](size_t chunk) {
+    for(auto i = bounds[chunk]; i < bounds[chunk + 1]; ++i)
+    {
+      partials[chunk] = reduceOperation->apply({ partials[chunk], elements[i] });
+    }
+  });
+
+  auto result = partials[0];
+
+  for(size_t chunk = 1; chunk < chunks; ++chunk)
+  {
+    result = combineOperation->apply({ result, partials[chunk] });
+  }
+
+  return result;
+}
+
+MalType MalPfoldOperation::apply(const vector<MalType>& args)
+{
+  return fold(interpreter_, args[0], args[1], args[2], args[3]);
+}
+
+MalType MalPreduceOperation::apply(const vector<MalType>& args)
+{
+  return fold(interpreter_, args[0], args[0], args[1], args[2]);
+}
+
+static bool naturalLess(const MalType& a, const MalType& b)
+{
+  auto* intA = dynamic_cast<MalInt*>(&*a);
+  auto* intB = dynamic_cast<MalInt*>(&*b);
+
+  if(intA && intB) return *(*intA) < *(*intB);
+
+  auto* stringA = dynamic_cast<MalString*>(&*a);
+  auto* stringB = dynamic_cast<MalString*>(&*b);
+
+  if(stringA && stringB) return *(*stringA) < *(*stringB);
+
+  auto* keywordA = dynamic_cast<MalKeyword*>(&*a);
+  auto* keywordB = dynamic_cast<MalKeyword*>(&*b);
+
+  if(keywordA && keywordB) return keywordA->getString(false) < keywordB->getString(false);
+
+  throw TypeException("Cannot compare " + Printer::prStr(a, true) + " with " + Printer::prStr(b, true));
+}
+
+MalType MalPsortOperation::apply(const vector<MalType>& args)
+{
+  function<bool(const MalType&, const MalType&)> less = naturalLess;
+  size_t minChunk = minNativeChunk;
+
+  if(args.size() > 1)
+  {
+    auto* operation = toOperation(args[0]);
+
+    less = [operation](const MalType& a, const MalType& b) {
+      auto result = operation->apply({ a, b });
+
+      return result != MNil && result != MFalse;
+    };
+    minChunk = minCallChunk;
+  }
+
+  auto elements = toElements(args.back());
+
+  // All-int input is the common case; skip the per-comparison type checks.
+  auto isInt = [](const MalType& element) { return typeid(*element) == typeid(MalInt); };
+
+  if(args.size() == 1 && std::all_of(elements.begin(), elements.end(), isInt))
+  {
+    less = [](const MalType& a, const MalType& b) {
+      return *(*static_cast<MalInt*>(&*a)) < *(*static_cast<MalInt*>(&*b));
+    };
+  }
+
+  auto chunks = chunkCount(elements.size(), minChunk);
+  auto bounds = chunkBounds(elements.size(), chunks);
+
+  if(chunks > 1) interpreter_.shareEnvironments();
+
+  // Sort the chunks in place, then merge neighbouring runs pairwise until
+  // one is left. stable_sort tolerates a predicate that isn't a strict weak
+  // ordering, which a user-supplied one may not be.
+  parallelFor(chunks, [&](size_t chunk) {
+    std::stable_sort(elements.begin() + bounds[chunk], elements.begin() + bounds[chunk + 1], less);
+  });
+
+  vector<MalType> merged(elements.size());
+
+  while(bounds.size() > 2)
+  {
+    auto runs = bounds.size() - 1;
+    vector<size_t> next;
+
+    for(size_t run = 0; run < runs; run += 2)
+    {
+      next.push_back(bounds[run]);
+    }
+
+    next.push_back(bounds.back());
+
+    parallelFor((runs + 1) / 2, [&](size_t pair) {
+      auto begin = bounds[2 * pair];
+      auto middle = bounds[std::min(2 * pair + 1, runs)];
+      auto end = bounds[std::min(2 * pair + 2, runs)];
+
+      std::merge(elements.begin() + begin, elements.begin() + middle,
+                 elements.begin() + middle, elements.begin() + end,
+                 merged.begin() + begin, less);
+    });
+
+    elements.swap(merged);
+    bounds = next;
+  }
+
+  return MalType(new MalList(elements));
+}
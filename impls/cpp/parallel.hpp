@@ -0,0 +1,55 @@
+#pragma once
+
+#include "types.hpp"
+
+// Fork-join collection operations on the shared work-stealing pool. Input is
+// cut into contiguous chunks sized from its length and the pool size; small
+// inputs, or a single-worker pool, run the plain serial loop instead.
+// Results keep the input order.
+
+// (pmap f coll)
+class MalPmapOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalPmapOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (pfold combinef reducef init coll): each chunk is reduced from init with
+// reducef, then the chunk results are combined left to right with
+// combinef. init must be an identity for combinef.
+class MalPfoldOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalPfoldOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (preduce f init coll) is (pfold f f init coll).
+class MalPreduceOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalPreduceOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (psort coll) or (psort less? coll): a stable merge sort. Without a
+// predicate numbers, strings and keywords sort in their natural order.
+class MalPsortOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalPsortOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
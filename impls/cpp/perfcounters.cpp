@@ -0,0 +1,207 @@
+#include "perfcounters.hpp"
+#include "numbers.hpp"
+#include "error.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+  struct Event
+  {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+  };
+
+  const Event events[] = {
+    { ":cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { ":instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { ":l1d-misses", PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { ":llc-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { ":branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  };
+
+  // Counter value, and how long it was enabled and actually counting: the
+  // kernel time-slices more counters than the PMU has registers.
+  struct Sample
+  {
+    uint64_t value;
+    uint64_t enabled;
+    uint64_t running;
+  };
+
+  string describe(int error)
+  {
+    switch(error)
+    {
+      case EACCES:
+      case EPERM:
+        return "not permitted, see /proc/sys/kernel/perf_event_paranoid";
+      case ENOENT:
+      case ENODEV:
+      case EOPNOTSUPP:
+        return "no hardware PMU";
+      default:
+        return strerror(error);
+    }
+  }
+
+  int64_t nowNs()
+  {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+  }
+}
+
+PerfCounters::PerfCounters(bool inherit)
+{
+  for(const auto& event : events)
+  {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.disabled = 1;
+    attr.inherit = inherit;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+
+    if(fd < 0)
+    {
+      if(unavailable_.empty()) unavailable_ = describe(errno);
+      continue;
+    }
+
+    fds_.push_back(fd);
+    names_.push_back(event.name);
+  }
+
+  if(!fds_.empty()) unavailable_.clear();
+}
+
+PerfCounters::~PerfCounters()
+{
+  for(int fd : fds_)
+  {
+    close(fd);
+  }
+}
+
+void PerfCounters::start()
+{
+  for(int fd : fds_)
+  {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+
+  startNs_ = nowNs();
+}
+
+PerfCounters::Reading PerfCounters::stop()
+{
+  Reading reading;
+  reading.wallNs = nowNs() - startNs_;
+  reading.unavailable = unavailable_;
+
+  for(size_t i = 0; i < fds_.size(); ++i)
+  {
+    ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    Sample sample;
+
+    if(read(fds_[i], &sample, sizeof(sample)) != sizeof(sample) || sample.running == 0) continue;
+
+    // Scale up a counter that was multiplexed for part of the run.
+    double value = static_cast<double>(sample.value);
+    if(sample.running < sample.enabled) value *= static_cast<double>(sample.enabled) / sample.running;
+
+    reading.counters.push_back({ names_[i], static_cast<uint64_t>(value) });
+  }
+
+  return reading;
+}
+
+map<string, MalType> PerfCounters::Reading::toMap() const
+{
+  map<string, MalType> result{ { ":wall-ns", MalInt::of(wallNs) } };
+
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+
+  for(const auto& counter : counters)
+  {
+    result[counter.name] = MalInt::of(static_cast<int64_t>(counter.value));
+
+    if(counter.name == ":cycles") cycles = counter.value;
+    if(counter.name == ":instructions") instructions = counter.value;
+  }
+
+  if(cycles && instructions) result[":ipc"] = MalType(new MalDouble(static_cast<double>(instructions) / cycles));
+
+  if(!unavailable.empty()) result[":unavailable"] = MalType(new MalString(unavailable));
+
+  return result;
+}
+
+string PerfCounters::Reading::table() const
+{
+  char line[96];
+  string out;
+
+  snprintf(line, sizeof(line), "%-16s %16.3f ms\n", "wall", wallNs / 1e6);
+  out += line;
+
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+
+  for(const auto& counter : counters)
+  {
+    snprintf(line, sizeof(line), "%-16s %16llu\n", counter.name.c_str() + 1, static_cast<unsigned long long>(counter.value));
+    out += line;
+
+    if(counter.name == ":cycles") cycles = counter.value;
+    if(counter.name == ":instructions") instructions = counter.value;
+  }
+
+  if(cycles && instructions)
+  {
+    snprintf(line, sizeof(line), "%-16s %16.2f\n", "ipc", static_cast<double>(instructions) / cycles);
+    out += line;
+  }
+
+  if(!unavailable.empty()) out += "no hardware counters (" + unavailable + "), timing only\n";
+
+  return out;
+}
+
+FormResult evalWithPerfCounters(MalList& form, MalType& ast, Env& env)
+{
+  if(form.size() != 2) throw TypeException("with-perf-counters takes one expression");
+
+  PerfCounters counters;
+
+  counters.start();
+  auto value = EVAL(form[1], env);
+  auto result = counters.stop().toMap();
+
+  result[":value"] = value;
+  ast = MalType(new MalHashMap(result));
+
+  return FormResult::Return;
+}
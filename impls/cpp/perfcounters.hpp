@@ -0,0 +1,61 @@
+#pragma once
+
+#include "evaluator.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Hardware counters from Linux perf_event_open: cycles, instructions, L1
+// data and last-level cache misses and branch misses, counted in user
+// space for the calling thread (and, with inherit, the threads it starts
+// afterwards). Each counter is opened on its own, so one the CPU lacks
+// doesn't take the others with it. Where none can be opened (no PMU in a
+// VM, or perf_event_paranoid forbids it) only wall time is measured.
+class PerfCounters
+{
+public:
+  struct Counter
+  {
+    string name;
+    uint64_t value;
+  };
+
+  struct Reading
+  {
+    int64_t wallNs = 0;
+    vector<Counter> counters;
+
+    // Why no counters could be opened; empty when at least one was.
+    string unavailable;
+
+    // :wall-ns, each counter by name and :ipc when both cycles and
+    // instructions were counted.
+    map<string, MalType> toMap() const;
+
+    // The same as lines of "name  value", for the CLI.
+    string table() const;
+  };
+
+  explicit PerfCounters(bool inherit = false);
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  void start();
+  Reading stop();
+
+private:
+  vector<int> fds_;
+  vector<const char*> names_;
+  string unavailable_;
+  int64_t startNs_ = 0;
+};
+
+// (with-perf-counters expr) evaluates expr once under the counters and
+// returns their reading as a map, with expr's value under :value.
+FormResult evalWithPerfCounters(MalList& form, MalType& ast, Env& env);
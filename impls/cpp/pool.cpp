@@ -0,0 +1,262 @@
+#include "pool.hpp"
+#include "error.hpp"
+
+#include <cstdlib>
+
+// Runs on the worker thread: evaluates and copies the result (or a thrown
+// mal value) out of the worker's heap before the interpreter goes away.
+static MalType evalDetached(Interpreter& interpreter, const MalType& form)
+{
+  try
+  {
+    return interpreter.eval(form)->deepCopy();
+  }
+  catch(MalTypeException& err)
+  {
+    throw MalTypeException(err.getMal()->deepCopy());
+  }
+}
+
+std::future<MalType> runInThread(const string& source)
+{
+  std::packaged_task<MalType()> task([source] {
+    Interpreter interpreter;
+
+    return evalDetached(interpreter, interpreter.read(source));
+  });
+
+  auto result = task.get_future();
+  std::thread(std::move(task)).detach();
+
+  return result;
+}
+
+std::future<MalType> runInThread(const MalType& form)
+{
+  auto copy = form->deepCopy();
+
+  std::packaged_task<MalType()> task([copy] {
+    Interpreter interpreter;
+
+    return evalDetached(interpreter, copy);
+  });
+
+  auto result = task.get_future();
+  std::thread(std::move(task)).detach();
+
+  return result;
+}
+
+InterpreterPool::InterpreterPool(size_t threads, const function<void(Interpreter&)>& init)
+{
+  stopping_ = false;
+
+  for(size_t i = 0; i < threads; ++i)
+  {
+    threads_.emplace_back([this, init] { work(init); });
+  }
+}
+
+InterpreterPool::~InterpreterPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+
+  ready_.notify_all();
+
+  for(auto& thread : threads_)
+  {
+    thread.join();
+  }
+}
+
+std::future<MalType> InterpreterPool::submit(const string& source)
+{
+  return submit<MalType>([source](Interpreter& interpreter) {
+    return evalDetached(interpreter, interpreter.read(source));
+  });
+}
+
+void InterpreterPool::post(function<void(Interpreter&)> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+
+  ready_.notify_one();
+}
+
+void InterpreterPool::work(const function<void(Interpreter&)>& init)
+{
+  Interpreter interpreter;
+
+  if(init) init(interpreter);
+
+  while(true)
+  {
+    function<void(Interpreter&)> task;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+
+      if(tasks_.empty()) return;
+
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+
+    task(interpreter);
+  }
+}
+
+// Which pool the current thread works for, and its queue there.
+static thread_local WorkStealingPool* currentPool = nullptr;
+static thread_local size_t currentQueue = 0;
+
+WorkStealingPool::WorkStealingPool(size_t threads): pending_(0), sleeping_(0), next_(0), stopping_(false)
+{
+  threads = std::max<size_t>(threads, 1);
+
+  for(size_t i = 0; i < threads; ++i)
+  {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+
+  for(size_t i = 0; i < threads; ++i)
+  {
+    threads_.emplace_back([this, i] { work(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+    stopping_ = true;
+  }
+
+  wake_.notify_all();
+
+  for(auto& thread : threads_)
+  {
+    thread.join();
+  }
+}
+
+WorkStealingPool& WorkStealingPool::shared()
+{
+  // Never destroyed: exiting must not wait on futures nobody will deref.
+  static auto* pool = [] {
+    const char* threads = std::getenv("MAL_THREADS");
+
+    return threads ? new WorkStealingPool(std::strtoul(threads, nullptr, 10)) : new WorkStealingPool();
+  }();
+
+  return *pool;
+}
+
+void WorkStealingPool::post(function<void()> task)
+{
+  auto queue = isWorker() ? currentQueue : next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+  {
+    std::lock_guard<std::mutex> lock(queues_[queue]->mutex);
+    queues_[queue]->tasks.push_back(std::move(task));
+  }
+
+  // Paired with the sleeping_ increment in work(): either the sleeper sees
+  // pending_ or we see the sleeper and wake it.
+  pending_.fetch_add(1);
+
+  if(sleeping_.load() > 0)
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+    wake_.notify_one();
+  }
+}
+
+bool WorkStealingPool::isWorker() const
+{
+  return currentPool == this;
+}
+
+bool WorkStealingPool::tryPop(size_t queue, bool back, function<void()>& task)
+{
+  std::lock_guard<std::mutex> lock(queues_[queue]->mutex);
+  auto& tasks = queues_[queue]->tasks;
+
+  if(tasks.empty()) return false;
+
+  if(back)
+  {
+    task = std::move(tasks.back());
+    tasks.pop_back();
+  }
+  else
+  {
+    task = std::move(tasks.front());
+    tasks.pop_front();
+  }
+
+  pending_.fetch_sub(1);
+
+  return true;
+}
+
+bool WorkStealingPool::runPending()
+{
+  function<void()> task;
+  bool found = tryPop(currentQueue, true, task);
+
+  for(size_t i = 1; !found && i < queues_.size(); ++i)
+  {
+    found = tryPop((currentQueue + i) % queues_.size(), false, task);
+  }
+
+  if(!found) return false;
+
+  // Tasks from submit() capture their own exceptions; anything else that
+  // escapes must not take the worker down with it.
+  try
+  {
+    task();
+  }
+  catch(...)
+  {
+  }
+
+  return true;
+}
+
+void WorkStealingPool::work(size_t self)
+{
+  currentPool = this;
+  currentQueue = self;
+
+  while(true)
+  {
+    if(runPending()) continue;
+
+    std::unique_lock<std::mutex> lock(sleepMutex_);
+
+    sleeping_.fetch_add(1);
+    wake_.wait(lock, [this] { return stopping_ || pending_.load() > 0; });
+    sleeping_.fetch_sub(1);
+
+    if(stopping_ && pending_.load() == 0) return;
+  }
+}
+
+string MalThreadResult::getString(bool)
+{
+  return "#<thread>";
+}
+
+MalType MalRunInThreadOperation::apply(const vector<MalType>& args)
+{
+  return MalType(new MalThreadResult(runInThread(args[0])));
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "types.hpp"
+#include "interpreter.hpp"
+#include "futures.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+using std::function;
+
+// Heaps are thread-confined: values built by one interpreter are only ever
+// touched by that interpreter's thread. Data crosses between interpreters
+// with MalTypeData::deepCopy (or as text through pr-str / read-string).
+// Immortal constants are shared as they are; functions and native
+// operations are bound to their interpreter and cannot be transferred.
+
+// Evaluates source in a fresh interpreter on a new thread. The result is
+// deep-copied on that thread before being handed back.
+std::future<MalType> runInThread(const string& source);
+std::future<MalType> runInThread(const MalType& form);
+
+// A fixed set of worker threads, each owning one long-lived interpreter.
+class InterpreterPool
+{
+  vector<std::thread> threads_;
+  std::deque<function<void(Interpreter&)>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  bool stopping_;
+
+public:
+  explicit InterpreterPool(size_t threads, const function<void(Interpreter&)>& init = nullptr);
+  ~InterpreterPool();
+
+  InterpreterPool(const InterpreterPool&) = delete;
+  InterpreterPool& operator=(const InterpreterPool&) = delete;
+
+  size_t size() const { return threads_.size(); }
+
+  // Evaluates source on the next free worker; the result is deep-copied.
+  std::future<MalType> submit(const string& source);
+
+  template<typename Result>
+  std::future<Result> submit(const function<Result(Interpreter&)>& task)
+  {
+    auto packaged = std::make_shared<std::packaged_task<Result(Interpreter&)>>(task);
+    auto result = packaged->get_future();
+
+    post([packaged](Interpreter& interpreter) { (*packaged)(interpreter); });
+
+    return result;
+  }
+
+private:
+  void post(function<void(Interpreter&)> task);
+  void work(const function<void(Interpreter&)>& init);
+};
+
+// Runs closures that share their interpreter with the submitting thread
+// (futures). Each worker keeps its own deque: it pushes and pops at the
+// back, and idle workers steal from the front of the others. Submitting
+// from outside the pool spreads tasks round-robin over the workers.
+class WorkStealingPool
+{
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<function<void()>> tasks;
+  };
+
+  vector<std::unique_ptr<Queue>> queues_;
+  vector<std::thread> threads_;
+  std::atomic<size_t> pending_;
+  std::atomic<size_t> sleeping_;
+  std::atomic<size_t> next_;
+  std::atomic<bool> stopping_;
+  std::mutex sleepMutex_;
+  std::condition_variable wake_;
+
+public:
+  explicit WorkStealingPool(size_t threads = std::thread::hardware_concurrency());
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  // One worker per hardware thread (or $MAL_THREADS), started on first use.
+  static WorkStealingPool& shared();
+
+  size_t size() const { return threads_.size(); }
+
+  void post(function<void()> task);
+
+  template<typename Result>
+  std::future<Result> submit(const function<Result()>& task)
+  {
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(task);
+    auto result = packaged->get_future();
+
+    post([packaged] { (*packaged)(); });
+
+    return result;
+  }
+
+  // Blocks until result is ready or the deadline passes. On one of this
+  // pool's workers it runs other queued tasks while it waits, so a future
+  // that derefs another future can't starve the pool.
+  template<typename Result>
+  bool await(const std::shared_future<Result>& result,
+             const std::optional<std::chrono::steady_clock::time_point>& deadline = std::nullopt)
+  {
+    using namespace std::chrono;
+
+    while(result.wait_for(seconds(0)) != std::future_status::ready)
+    {
+      if(!isWorker())
+      {
+        if(!deadline)
+        {
+          result.wait();
+          return true;
+        }
+
+        return result.wait_until(*deadline) == std::future_status::ready;
+      }
+
+      if(deadline && steady_clock::now() >= *deadline) return false;
+
+      if(!runPending())
+      {
+        auto slice = steady_clock::now() + milliseconds(1);
+
+        result.wait_until(deadline ? std::min(slice, *deadline) : slice);
+      }
+    }
+
+    return true;
+  }
+
+private:
+  bool isWorker() const;
+  bool runPending();
+  bool tryPop(size_t queue, bool back, function<void()>& task);
+  void work(size_t self);
+};
+
+// The handle returned by (run-in-thread form); deref waits for the result.
+class MalThreadResult : public MalPendingRef
+{
+public:
+  MalThreadResult(std::future<MalType> result): MalPendingRef(result.share()) {}
+
+  virtual string getString(bool printReadably) override;
+};
+
+class MalRunInThreadOperation : public MalOperation
+{
+public:
+  MalRunInThreadOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
@@ -1,9 +1,79 @@
 #include "printer.hpp"
 
 #include "types.hpp"
+#include "lazy.hpp"
+
+#include <algorithm>
+
+static const size_t maxElements = 4;
+
+static string clip(const string& text, size_t length)
+{
+  return text.size() <= length ? text : text.substr(0, length - 3) + "...";
+}
 
 string Printer::prStr(const MalType& malType, const bool& printReadably)
 {
   return malType->getString(printReadably);
 }
 
+
+string Printer::summarize(const MalType& value, int depth)
+{
+  auto* data = &*value;
+  const auto& type = typeid(*data);
+
+  if(type == typeid(MalLazySeq)) return "(lazy-seq ...)";
+
+  if(type == typeid(MalList) || type == typeid(MalVector))
+  {
+    auto* enumerable = static_cast<MalEnumerable*>(data);
+    string open = type == typeid(MalList) ? "(" : "[";
+    string close = type == typeid(MalList) ? ")" : "]";
+
+    if(enumerable->isEmpty()) return open + close;
+    if(depth == 0) return open + "..." + close;
+
+    string out = open;
+    size_t shown = std::min(enumerable->size(), maxElements);
+
+    for(size_t i = 0; i < shown; ++i)
+    {
+      if(i) out += " ";
+      out += summarize((*enumerable)[i], depth - 1);
+    }
+
+    if(enumerable->size() > shown) out += " ...+" + std::to_string(enumerable->size() - shown);
+
+    return out + close;
+  }
+
+  if(type == typeid(MalHashMap))
+  {
+    const auto& entries = static_cast<MalHashMap*>(data)->getEntries();
+
+    if(entries.empty()) return "{}";
+    if(depth == 0) return "{...}";
+
+    string out = "{";
+    size_t shown = 0;
+
+    for(const auto& entry : entries)
+    {
+      if(shown == maxElements)
+      {
+        out += " ...+" + std::to_string(entries.size() - shown);
+        break;
+      }
+
+      if(shown++) out += " ";
+      out += clip(entry.first, 24) + " " + summarize(entry.second, depth - 1);
+    }
+
+    return out + "}";
+  }
+
+  if(type == typeid(MalAtom)) return "(atom " + summarize(**static_cast<MalAtom*>(data), depth - 1) + ")";
+
+  return clip(prStr(value, true), 40);
+}
@@ -9,6 +9,11 @@ class Printer
 {
 public:
   static string prStr(const MalType& malType, const bool& printReadably = false);
+
+  // Like pr-str, but shows only the first few elements of a collection,
+  // nests only depth deep and never realizes a lazy seq. For dumps and
+  // reports about values that may be huge.
+  static string summarize(const MalType& value, int depth = 2);
 };
 
 
@@ -0,0 +1,301 @@
+#include "profiler.hpp"
+#include "interpreter.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <signal.h>
+#include <sys/time.h>
+
+std::atomic<int> CallStack::watchers_(0);
+
+static thread_local CallStack::Frames frames;
+
+CallStack::Frames& CallStack::current()
+{
+  return frames;
+}
+
+SymbolId CallStack::anonymous()
+{
+  static const SymbolId id = SymbolTable::intern("(fn*)");
+
+  return id;
+}
+
+SymbolId CallStack::innermost()
+{
+  static const SymbolId toplevel = SymbolTable::intern("(toplevel)");
+
+  size_t depth = std::min(frames.depth.load(std::memory_order_relaxed), maxDepth);
+
+  return depth ? frames.ids[depth - 1] : toplevel;
+}
+
+void CallStack::Frame::enterSlow(SymbolId name, const EnvData* env)
+{
+  auto& stack = current();
+
+  if(!pushed_)
+  {
+    saved_ = stack.depth.load(std::memory_order_relaxed);
+    pushed_ = true;
+    name_ = name;
+
+    if(Tracer::enabled()) traceStart_ = Tracer::now();
+  }
+
+  if(saved_ < maxDepth)
+  {
+    stack.ids[saved_] = static_cast<uint32_t>(name);
+    stack.envs[saved_] = env;
+  }
+
+  // The handler runs on this thread: the name has to be in place before
+  // the depth that exposes it.
+  std::atomic_signal_fence(std::memory_order_release);
+  stack.depth.store(saved_ + 1, std::memory_order_relaxed);
+}
+
+void CallStack::Frame::leave()
+{
+  current().depth.store(saved_, std::memory_order_relaxed);
+
+  if(traceStart_ >= 0) Tracer::completeIfLong("call", SymbolTable::name(name_), traceStart_, Tracer::now());
+}
+
+namespace
+{
+  // Samples are packed back to back as a depth followed by that many ids,
+  // outermost first. Handlers on different threads reserve space with one
+  // fetch_add; the first sample that doesn't fit sets limit, and everything
+  // past it is dropped.
+  struct Samples
+  {
+    std::unique_ptr<uint32_t[]> buffer;
+    size_t capacity = 0;
+    std::atomic<size_t> used{0};
+    std::atomic<size_t> limit{0};
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> dropped{0};
+    std::atomic<int> inHandler{0};
+    std::atomic<bool> sampling{false};
+    int hz = 0;
+    struct sigaction previousAction;
+  };
+
+  Samples samples;
+  std::mutex profilerMutex;
+
+  // 4M words: about 200,000 samples of twenty frames, over three minutes
+  // of CPU time at 1 kHz.
+  const size_t bufferWords = 1 << 22;
+}
+
+static void onSample(int)
+{
+  samples.inHandler.fetch_add(1);
+
+  if(samples.sampling.load(std::memory_order_acquire))
+  {
+    auto& stack = CallStack::current();
+    std::atomic_signal_fence(std::memory_order_acquire);
+
+    size_t depth = std::min(stack.depth.load(std::memory_order_relaxed), CallStack::maxDepth);
+    size_t at = samples.used.fetch_add(depth + 1);
+
+    if(at + depth + 1 > samples.capacity)
+    {
+      size_t limit = samples.limit.load();
+      while(at < limit && !samples.limit.compare_exchange_weak(limit, at)) {}
+
+      samples.dropped.fetch_add(1);
+    }
+    else
+    {
+      samples.buffer[at] = static_cast<uint32_t>(depth);
+      std::copy(stack.ids, stack.ids + depth, &samples.buffer[at + 1]);
+      samples.count.fetch_add(1);
+    }
+  }
+
+  samples.inHandler.fetch_sub(1);
+}
+
+static void setTimer(int hz)
+{
+  struct itimerval timer = {};
+
+  if(hz > 0)
+  {
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = std::max(1, 1000000 / hz);
+    timer.it_value = timer.it_interval;
+  }
+
+  setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+void Profiler::start(int64_t hz)
+{
+  std::lock_guard<std::mutex> lock(profilerMutex);
+
+  if(samples.sampling.load()) throw TypeException("A profile is already running");
+  if(hz <= 0 || hz > 100000) throw TypeException("The sampling rate must be between 1 and 100000 per second");
+
+  if(!samples.buffer)
+  {
+    samples.buffer.reset(new uint32_t[bufferWords]);
+    samples.capacity = bufferWords;
+  }
+
+  samples.used.store(0);
+  samples.limit.store(samples.capacity);
+  samples.count.store(0);
+  samples.dropped.store(0);
+  samples.hz = hz;
+
+  CallStack::addWatcher();
+
+  struct sigaction action = {};
+  action.sa_handler = onSample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, &samples.previousAction);
+
+  samples.sampling.store(true, std::memory_order_release);
+  setTimer(hz);
+}
+
+bool Profiler::running()
+{
+  return samples.sampling.load();
+}
+
+Profiler::Report Profiler::stop()
+{
+  std::lock_guard<std::mutex> lock(profilerMutex);
+
+  if(!samples.sampling.load()) throw TypeException("No profile is running");
+
+  setTimer(0);
+  samples.sampling.store(false, std::memory_order_release);
+
+  // A handler that started before the flag dropped may still be copying.
+  while(samples.inHandler.load() != 0) std::this_thread::yield();
+
+  sigaction(SIGPROF, &samples.previousAction, nullptr);
+  CallStack::removeWatcher();
+
+  Report report;
+  report.samples = samples.count.load();
+  report.dropped = samples.dropped.load();
+  report.hz = samples.hz;
+
+  size_t end = std::min({ samples.used.load(), samples.limit.load(), samples.capacity });
+  map<vector<uint32_t>, size_t> stacks;
+
+  for(size_t at = 0; at < end; at += samples.buffer[at] + 1)
+  {
+    const uint32_t* ids = &samples.buffer[at + 1];
+    ++stacks[vector<uint32_t>(ids, ids + samples.buffer[at])];
+  }
+
+  map<uint32_t, string> names;
+  auto nameOf = [&](uint32_t id) -> const string& {
+    auto pos = names.find(id);
+    if(pos == names.end()) pos = names.emplace(id, SymbolTable::name(id)).first;
+
+    return pos->second;
+  };
+
+  for(const auto& pair : stacks)
+  {
+    const auto& stack = pair.first;
+
+    if(stack.empty())
+    {
+      report.folded += "(toplevel)";
+      report.self["(toplevel)"] += pair.second;
+      report.total["(toplevel)"] += pair.second;
+    }
+
+    std::set<uint32_t> seen;
+
+    for(size_t i = 0; i < stack.size(); ++i)
+    {
+      if(i > 0) report.folded += ';';
+      report.folded += nameOf(stack[i]);
+
+      // A recursive function counts once per sample towards its total.
+      if(seen.insert(stack[i]).second) report.total[nameOf(stack[i])] += pair.second;
+    }
+
+    if(!stack.empty()) report.self[nameOf(stack.back())] += pair.second;
+
+    report.folded += ' ' + std::to_string(pair.second) + '\n';
+  }
+
+  return report;
+}
+
+string Profiler::Report::table(size_t topN) const
+{
+  vector<std::pair<string, size_t>> rows(self.begin(), self.end());
+
+  std::stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+  if(rows.size() > topN) rows.resize(topN);
+
+  char line[160];
+  string out;
+
+  snprintf(line, sizeof(line), "%zu samples at %d Hz (%zu dropped)\n%7s %7s  %s\n", samples, hz, dropped, "self%", "total%", "function");
+  out += line;
+
+  double scale = samples ? 100.0 / samples : 0;
+
+  for(const auto& row : rows)
+  {
+    snprintf(line, sizeof(line), "%6.1f%% %6.1f%%  %s\n", row.second * scale, total.at(row.first) * scale, row.first.c_str());
+    out += line;
+  }
+
+  return out;
+}
+
+MalType MalProfileStartOperation::apply(const vector<MalType>& args)
+{
+  Profiler::start(args.empty() ? 1000 : Interpreter::toInt(args[0]));
+
+  return MNil;
+}
+
+MalType MalProfileStopOperation::apply(const vector<MalType>& args)
+{
+  auto report = Profiler::stop();
+
+  {
+    std::lock_guard<std::mutex> lock(interpreter_.getOutputMutex());
+    interpreter_.getOutput() << report.table();
+  }
+
+  if(args.empty()) return MalType(new MalString(report.folded));
+
+  auto path = Interpreter::toString(args[0]);
+  std::ofstream out(path);
+
+  if(!out) throw TypeException("Cannot write " + path);
+
+  out << report.folded;
+
+  return MNil;
+}
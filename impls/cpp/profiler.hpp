@@ -0,0 +1,144 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+using std::string;
+
+// A shadow stack of the mal functions each thread is running, kept only
+// while someone is watching so it costs a predictable branch per call
+// otherwise. Frames hold interned names: a function takes the name
+// of the first def! that binds it, and anonymous ones show up as (fn*). A
+// tail call replaces its caller's frame, as it does on the real stack.
+class CallStack
+{
+public:
+  static constexpr size_t maxDepth = 256;
+
+  // Fixed size and constant-initialized, so a signal handler can read the
+  // current thread's stack without allocating. Frames past maxDepth are
+  // counted in depth but not recorded.
+  struct Frames
+  {
+    uint32_t ids[maxDepth];
+
+    // The environment each call bound its arguments in, for state dumps.
+    // Only read on the owning thread, while the frames are live.
+    const EnvData* envs[maxDepth];
+
+    std::atomic<size_t> depth{0};
+  };
+
+  static Frames& current();
+
+  // Frames are kept while at least one watcher (the profiler, allocation
+  // stats) wants them.
+  static bool enabled() { return watchers_.load(std::memory_order_relaxed) > 0; }
+  static void addWatcher() { watchers_.fetch_add(1); }
+  static void removeWatcher() { watchers_.fetch_sub(1); }
+
+  // Lives as long as one EVAL or apply. The first enter() pushes a frame,
+  // later ones (tail calls) overwrite it, and the destructor pops it, even
+  // when an exception unwinds through. Go blocks that park on one thread
+  // can briefly see each other's frames. While tracing, a popped frame
+  // becomes a call span named after the first function entered.
+  class Frame
+  {
+    size_t saved_ = 0;
+    bool pushed_ = false;
+    SymbolId name_ = 0;
+    int64_t traceStart_ = -1;
+
+  public:
+    Frame() = default;
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+
+    void enter(SymbolId name, const EnvData* env = nullptr)
+    {
+      if(!pushed_ && !enabled()) return;
+
+      enterSlow(name, env);
+    }
+
+    ~Frame()
+    {
+      if(pushed_) leave();
+    }
+
+  private:
+    void enterSlow(SymbolId name, const EnvData* env);
+    void leave();
+  };
+
+  // Name of functions no def! has bound.
+  static SymbolId anonymous();
+
+  // The innermost function on this thread's stack, or (toplevel) outside
+  // of any.
+  static SymbolId innermost();
+
+private:
+  static std::atomic<int> watchers_;
+};
+
+// Samples every thread's CallStack on a SIGPROF timer, so each sample lands
+// on whichever thread was using CPU. Only one profile runs at a time in the
+// process. Samples go into a buffer allocated by start(); when it fills,
+// later samples are dropped and counted.
+class Profiler
+{
+public:
+  struct Report
+  {
+    size_t samples;
+    size_t dropped;
+    int hz;
+
+    // Brendan Gregg's collapsed format: "outer;inner;leaf count" per line.
+    string folded;
+
+    // Samples per function: with it innermost, and with it anywhere on the
+    // stack.
+    map<string, size_t> self;
+    map<string, size_t> total;
+
+    // The topN functions by self samples as a text table.
+    string table(size_t topN = 20) const;
+  };
+
+  // Throws if a profile is already running.
+  static void start(int64_t hz = 1000);
+
+  // Stops the timer and aggregates what was sampled. Throws if no profile
+  // is running.
+  static Report stop();
+
+  static bool running();
+};
+
+// (profile-start) or (profile-start hz) starts sampling at hz per second of
+// CPU time, 1000 by default.
+class MalProfileStartOperation : public MalOperation
+{
+public:
+  MalProfileStartOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (profile-stop) prints the top functions to the interpreter's output and
+// returns the collapsed stacks as a string; (profile-stop path) writes them
+// to path instead and returns nil.
+class MalProfileStopOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalProfileStopOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
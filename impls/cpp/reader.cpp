@@ -2,7 +2,12 @@
 #include <regex>
 #include "types.hpp"
 #include <memory>
+#include <cerrno>
+#include <cstdlib>
+#include <cmath>
 #include "error.hpp"
+#include "bigint.hpp"
+#include "numbers.hpp"
 
 using std::regex;
 using std::smatch;
@@ -10,6 +15,7 @@ using std::regex_search;
 using std::shared_ptr;
 
 static const regex intRegex("^-?\\d+$");
+static const regex doubleRegex("^-?\\d+(\\.\\d+([eE][-+]?\\d+)?|[eE][-+]?\\d+)$");
 
 static const regex skipRegexes[] = {
   regex("[\\s,]+"), // whitespaces
@@ -56,7 +62,7 @@ void Tokenizer::skipWhitespace()
   while(foundMatch)
   {
     foundMatch = false;
-    for(auto regex : skipRegexes)
+    for(const auto& regex : skipRegexes)
     {
       if(fetchTokenFromRegex(regex))
       {
@@ -67,7 +73,7 @@ void Tokenizer::skipWhitespace()
   }
 }
 
-bool Tokenizer::fetchTokenFromRegex(regex regex)
+bool Tokenizer::fetchTokenFromRegex(const regex& regex)
 {
   if(eof()) return false;
 
@@ -200,7 +206,25 @@ MalType Tokenizer::readAtom(const shared_ptr<Tokenizer>& tokenizer)
 
   if(regex_search(token, intRegex))
   {
-    return MalType(new MalInt(std::stoi(token)));
+    // Literals too big for 64 bits read as bignums rather than failing.
+    errno = 0;
+    auto value = std::strtoll(token.c_str(), nullptr, 10);
+
+    if(errno == ERANGE) return MalBigInt::from(BigInt::parse(token));
+
+    return MalInt::of(value);
+  }
+
+  if(regex_search(token, doubleRegex))
+  {
+    return MalType(new MalDouble(std::strtod(token.c_str(), nullptr)));
+  }
+
+  if(token == "##Inf" || token == "##-Inf" || token == "##NaN")
+  {
+    double value = token == "##NaN" ? NAN : HUGE_VAL;
+
+    return MalType(new MalDouble(token == "##-Inf" ? -value : value));
   }
 
 
@@ -33,5 +33,5 @@ public:
 private:
   void skipWhitespace();
   void nextToken();
-  bool fetchTokenFromRegex(regex regex);
+  bool fetchTokenFromRegex(const regex& regex);
 };
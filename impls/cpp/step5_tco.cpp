@@ -2,223 +2,18 @@
 #include <iostream>
 #include <vector>
 #include "linenoise.hpp"
-#include "reader.hpp"
 #include "printer.hpp"
-#include "types.hpp"
-#include "env.hpp"
 #include "error.hpp"
-#include "core.hpp"
+#include "interpreter.hpp"
 
 using std::string;
 using std::cout;
-using std::getline;
 using std::endl;
-using std::cin;
-using std::function;
 using std::vector;
 
-Env env = Env(new EnvData());
-
-MalType EVAL(MalType input, Env env);
-
-MalType READ(const string& input)
-{
-  return Tokenizer::readStr(input);
-}
-
-MalType evalAst(const MalType& ast, Env& env)
-{
-  if(typeid(*ast) == typeid(MalSymbol))
-  {
-    auto* symbol = dynamic_cast<MalSymbol*>(&*ast);
-
-    return env->get(symbol->getSymbol());
-  }
-
-  if(typeid(*ast) == typeid(MalList))
-  {
-    vector<MalType> elements;
-
-    auto* malList = dynamic_cast<MalList*>(&*ast);
-
-    for(auto mal : *malList)
-    {
-      elements.push_back(EVAL(mal, env));
-    }
-
-    return MalType(new MalList(elements));
-  }
-
-  if(typeid(*ast) == typeid(MalVector))
-  {
-    vector<MalType> elements;
-
-    auto* malVector= dynamic_cast<MalVector*>(&*ast);
-
-    for(auto mal : *malVector)
-    {
-      elements.push_back(EVAL(mal, env));
-    }
-
-    return MalType(new MalVector(elements));
-  }
-
-  if(typeid(*ast) == typeid(MalHashMap))
-  {
-    vector<MalType> elements;
-
-    auto* malHashMap = dynamic_cast<MalHashMap*>(&*ast);
-
-    for(auto pair : *malHashMap)
-    {
-      elements.push_back(READ(pair.first));
-      elements.push_back(EVAL(pair.second, env));
-    }
-
-    return MalType(new MalHashMap(elements));
-  }
-
-  return ast;
-}
-
-MalType EVAL(MalType input, Env env)
-{
-  while(true)
-  {
-    if(typeid(*input) != typeid(MalList))
-    {
-      return evalAst(input, env);
-    }
-
-    auto* malList = dynamic_cast<MalList*>(&*input);
-
-    if(malList->isEmpty())
-    {
-      return input;
-    }
-
-    if(typeid(*(*malList)[0]) == typeid(MalSymbol))
-    {
-      auto symbol = dynamic_cast<MalSymbol*>(&*(*malList)[0]);
-      
-      if(symbol->getSymbol() == "def!")
-      {
-        auto key = dynamic_cast<MalSymbol*>(&*(*malList)[1]);
-        return env->set(key->getSymbol(), EVAL((*malList)[2], env));
-      }
-
-      if(symbol->getSymbol() == "let*")
-      {
-        auto newEnv = Env(new EnvData(env));
-        auto* defs = dynamic_cast<MalEnumerable*>(&*(*malList)[1]);
-
-        for(auto itr = defs->begin(); itr != defs->end(); ++itr)
-        {
-          auto* key = dynamic_cast<MalSymbol*>(&*(*itr));
-          ++itr;
-          auto value = EVAL(*itr, newEnv);
-
-          newEnv->set(key->getSymbol(), value);
-        }
-
-        env = newEnv;
-        input = (*malList)[2];
-
-        continue;
-      }
-
-      if(symbol->getSymbol() == "do")
-      {
-        vector<MalType> elements;
-        for(auto itr = malList->begin() + 1; itr != malList->end() - 1; ++itr)
-        {
-          elements.push_back(*itr);
-        }
-
-        evalAst(MalType(new MalList(elements)), env);
-
-        input = *malList->end();
-        continue;
-      }
-
-      if(symbol->getSymbol() == "if")
-      {
-        auto result = EVAL((*malList)[1], env);
-
-        if(result != MNil && result != MFalse)
-        {
-          input = (*malList)[2];
-          continue;
-        }
-
-        if(malList->size() == 3)
-        {
-          return MNil;
-        }
-
-        input = (*malList)[3];
-        continue;
-      }
-
-      if(symbol->getSymbol() == "fn*")
-      {
-        vector<MalType> bindings;
-        auto* argsList = dynamic_cast<MalEnumerable*>(&*(*malList)[1]);
-
-        for(auto itr = argsList->begin(); itr != argsList->end(); ++itr)
-        {
-          bindings.push_back(*itr);
-        }
-
-        return MalType(new MalFunction(bindings, (*malList)[2], env));
-      }
-    }
-
-    auto evalList = evalAst(input, env);
-    auto* listPtr = dynamic_cast<MalList*>(&*evalList);
-
-    vector<MalType> args;
-
-    for(auto itr = listPtr->begin() + 1; itr != listPtr->end(); ++itr)
-    {
-      args.push_back(*itr);
-    }
-
-    auto* operation = dynamic_cast<MalOperation*>(&*(*listPtr)[0]);
-
-    if(const auto* function = dynamic_cast<MalFunction*>(operation))
-    {
-      input = function->getBody();
-      env = function->makeEnv(args);
-      continue;
-    }
-
-    return operation->apply(args);
-  }
-}
-
-string PRINT(const MalType& input)
-{
-  return Printer::prStr(input, true);
-}
-
-string rep(const string& input)
-{
-  auto ast = READ(input);
-  auto result = EVAL(ast, env);
-  auto output = PRINT(result);
-
-  return output;
-}
-
 int main()
 {
-  for(auto itr = Core::ns.begin(); itr != Core::ns.end(); ++itr)
-  {
-    env->set(itr->first, itr->second);
-  }
-
-  rep("(def! not (fn* (a) (if a false true)))");
+  Interpreter interpreter;
 
   const auto history_path = "history.txt";
   linenoise::LoadHistory(history_path);
@@ -232,7 +27,7 @@ int main()
 
     try
     {
-      cout << rep(input) << endl;
+      cout << interpreter.rep(input) << endl;
     }
     catch(EOFException& err)
     {
@@ -254,4 +49,3 @@ int main()
 
   return 0;
 }
-
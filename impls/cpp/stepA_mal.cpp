@@ -0,0 +1,113 @@
+#include <string>
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <cstdlib>
+#include "linenoise.hpp"
+#include "printer.hpp"
+#include "error.hpp"
+#include "interpreter.hpp"
+#include "profiler.hpp"
+#include "perfcounters.hpp"
+#include "dump.hpp"
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+
+int main(int argc, char *argv[])
+{
+  Interpreter interpreter;
+
+  const char* dumpPath = std::getenv("MAL_DUMP");
+  StateDump::install(dumpPath ? dumpPath : "");
+
+  // --profile[=path] samples the whole script, writing collapsed stacks to
+  // path (mal.folded by default) and the top functions to stderr.
+  // --perf-counters prints the script's hardware counters to stderr, and
+  // --stats the latency of reading, evaluating and printing each form.
+  // --call-stacks keeps the mal call stack for SIGUSR1 state dumps, which
+  // go to $MAL_DUMP if set and stderr otherwise.
+  string profilePath;
+  bool perfCounters = false;
+  bool stats = false;
+
+  for(; argc > 1; ++argv, --argc)
+  {
+    string flag = argv[1];
+
+    if(flag == "--profile" || flag.rfind("--profile=", 0) == 0) profilePath = flag == "--profile" ? "mal.folded" : flag.substr(10);
+    else if(flag == "--perf-counters") perfCounters = true;
+    else if(flag == "--stats") stats = true;
+    else if(flag == "--call-stacks") CallStack::addWatcher();
+    else break;
+  }
+
+  if(argc > 1)
+  {
+    interpreter.setArgv(vector<string>(argv + 2, argv + argc));
+
+    // Counting threads the script starts, too.
+    std::unique_ptr<PerfCounters> counters;
+
+    if(perfCounters)
+    {
+      counters.reset(new PerfCounters(true));
+      counters->start();
+    }
+
+    if(!profilePath.empty()) Profiler::start();
+
+    interpreter.loadFile(argv[1]);
+
+    if(counters) std::cerr << counters->stop().table();
+
+    if(!profilePath.empty())
+    {
+      auto report = Profiler::stop();
+
+      std::ofstream(profilePath) << report.folded;
+      std::cerr << report.table();
+    }
+
+    if(stats) std::cerr << interpreter.getLatencyStats().table();
+
+    return 0;
+  }
+
+  interpreter.rep("(println (str \"Mal [\" *host-language* \"]\"))");
+
+  const auto history_path = "history.txt";
+  linenoise::LoadHistory(history_path);
+
+  string input;
+
+  while(true)
+  {
+    auto quit = linenoise::Readline("user> ", input);
+    if(quit) break;
+
+    try
+    {
+      cout << interpreter.rep(input) << endl;
+    }
+    catch(MalException& err)
+    {
+      err.log();
+    }
+    catch(MalTypeException& err)
+    {
+      cout << "An uncaught mal exception thrown with value: " << Printer::prStr(err.getMal(), true) << endl;
+    }
+
+    linenoise::AddHistory(input.c_str());
+  }
+
+  linenoise::SaveHistory(history_path);
+
+  if(stats) std::cerr << interpreter.getLatencyStats().table();
+
+  return 0;
+}
@@ -0,0 +1,203 @@
+#include "tracer.hpp"
+#include "profiler.hpp"
+#include "interpreter.hpp"
+#include "error.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+#include <unistd.h>
+
+std::atomic<bool> Tracer::enabled_(false);
+
+namespace
+{
+  // Flushed to the file whenever it grows past this.
+  const size_t flushBytes = 1 << 20;
+
+  struct Trace
+  {
+    std::mutex mutex;
+    FILE* file = nullptr;
+    string buffer;
+    std::atomic<int64_t> minMicros{Tracer::defaultMinMicros};
+    int64_t origin = 0;
+    bool firstEvent = true;
+
+    // Bumped per trace, so each thread names itself once in each file.
+    int generation = 0;
+    int nextThread = 1;
+
+    ~Trace()
+    {
+      finish();
+    }
+
+    void flush()
+    {
+      fwrite(buffer.data(), 1, buffer.size(), file);
+      buffer.clear();
+    }
+
+    void append(const string& event)
+    {
+      buffer += firstEvent ? "\n" : ",\n";
+      buffer += event;
+      firstEvent = false;
+
+      if(buffer.size() >= flushBytes) flush();
+    }
+
+    void finish()
+    {
+      if(!file) return;
+
+      buffer += "\n]\n";
+      flush();
+      fclose(file);
+      file = nullptr;
+    }
+  };
+
+  Trace trace;
+
+  struct ThreadTag
+  {
+    int id = 0;
+    int generation = -1;
+  };
+
+  thread_local ThreadTag threadTag;
+}
+
+int64_t Tracer::now()
+{
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+string Tracer::quote(const string& value)
+{
+  string out = "\"";
+
+  for(char c : value)
+  {
+    if(c == '"' || c == '\\')
+    {
+      out += '\\';
+      out += c;
+    }
+    else if(static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    }
+    else
+    {
+      out += c;
+    }
+  }
+
+  return out + '"';
+}
+
+void Tracer::start(const string& path, int64_t minMicros)
+{
+  std::lock_guard<std::mutex> lock(trace.mutex);
+
+  FILE* file = fopen(path.c_str(), "w");
+
+  if(!file) throw TypeException("Cannot write " + path);
+
+  bool wasTracing = trace.file != nullptr;
+
+  trace.finish();
+  trace.file = file;
+  trace.buffer = "[";
+  trace.firstEvent = true;
+  trace.minMicros = minMicros;
+  trace.origin = now();
+  ++trace.generation;
+
+  // Function call spans come from the call stack's frames.
+  if(!wasTracing) CallStack::addWatcher();
+
+  enabled_.store(true);
+}
+
+void Tracer::stop()
+{
+  std::lock_guard<std::mutex> lock(trace.mutex);
+
+  if(!trace.file) return;
+
+  enabled_.store(false);
+  CallStack::removeWatcher();
+  trace.finish();
+}
+
+void Tracer::startFromEnvironment()
+{
+  static std::once_flag once;
+
+  std::call_once(once, [] {
+    const char* path = std::getenv("MAL_TRACE");
+    if(!path || !*path) return;
+
+    const char* minMicros = std::getenv("MAL_TRACE_MIN_US");
+
+    start(path, minMicros ? std::atoll(minMicros) : defaultMinMicros);
+  });
+}
+
+void Tracer::complete(const char* category, const string& name, int64_t start, int64_t end, const string& args)
+{
+  std::lock_guard<std::mutex> lock(trace.mutex);
+
+  if(!trace.file) return;
+
+  if(threadTag.generation != trace.generation)
+  {
+    if(threadTag.id == 0) threadTag.id = trace.nextThread++;
+    threadTag.generation = trace.generation;
+
+    trace.append("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " + std::to_string(getpid()) +
+                 ", \"tid\": " + std::to_string(threadTag.id) +
+                 ", \"args\": {\"name\": \"mal thread " + std::to_string(threadTag.id) + "\"}}");
+  }
+
+  char times[96];
+  snprintf(times, sizeof(times), "\"ts\": %lld, \"dur\": %lld, \"pid\": %d, \"tid\": %d",
+           static_cast<long long>(start - trace.origin), static_cast<long long>(end - start),
+           static_cast<int>(getpid()), threadTag.id);
+
+  string event = "{\"name\": " + quote(name) + ", \"cat\": \"" + category + "\", \"ph\": \"X\", " + times;
+
+  if(!args.empty()) event += ", \"args\": {" + args + "}";
+
+  trace.append(event + "}");
+}
+
+void Tracer::completeIfLong(const char* category, const string& name, int64_t start, int64_t end)
+{
+  if(end - start < trace.minMicros.load(std::memory_order_relaxed)) return;
+
+  complete(category, name, start, end);
+}
+
+MalType MalTraceToOperation::apply(const vector<MalType>& args)
+{
+  if(args.empty() || args[0] == MNil)
+  {
+    Tracer::stop();
+    return MNil;
+  }
+
+  Tracer::start(Interpreter::toString(args[0]), args.size() > 1 ? Interpreter::toInt(args[1]) : Tracer::defaultMinMicros);
+
+  return MNil;
+}
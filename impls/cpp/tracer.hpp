@@ -0,0 +1,83 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+using std::string;
+
+// Writes a Chrome trace-event timeline (chrome://tracing, ui.perfetto.dev)
+// of reads, macro expansions, mal function calls, load-file and slurp.
+// Calls and expansions shorter than a threshold are left out, so a trace
+// of a busy loop stays readable. Events are buffered and written in large
+// blocks; the file is closed, and its JSON array ended, when tracing stops
+// or the process exits.
+class Tracer
+{
+public:
+  // Microseconds on the monotonic clock.
+  static int64_t now();
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // Traces into path, replacing any trace in progress. Calls and macro
+  // expansions under minMicros are dropped.
+  static void start(const string& path, int64_t minMicros = defaultMinMicros);
+  static void stop();
+
+  // Starts a trace when MAL_TRACE names a file, with MAL_TRACE_MIN_US as
+  // the threshold. Only the first call in a process looks.
+  static void startFromEnvironment();
+
+  // Records a complete event. args is a JSON object body, such as
+  // "\"path\": \"x.mal\"", or empty.
+  static void complete(const char* category, const string& name, int64_t start, int64_t end, const string& args = "");
+
+  // Like complete, but dropped below the threshold.
+  static void completeIfLong(const char* category, const string& name, int64_t start, int64_t end);
+
+  // Quotes value as a JSON string.
+  static string quote(const string& value);
+
+  static const int64_t defaultMinMicros = 100;
+
+  // Times one scope as a complete event. It does nothing unless tracing
+  // was on when it started.
+  class Span
+  {
+    const char* category_;
+    const char* name_;
+    string args_;
+    int64_t start_;
+
+  public:
+    Span(const char* category, const char* name, const string& args = ""):
+      category_(category), name_(name), start_(enabled() ? now() : -1)
+    {
+      if(start_ >= 0) args_ = args;
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    ~Span()
+    {
+      if(start_ >= 0) complete(category_, name_, start_, now(), args_);
+    }
+  };
+
+private:
+  static std::atomic<bool> enabled_;
+};
+
+// (trace-to path) or (trace-to path min-us) starts tracing into path;
+// (trace-to nil) finishes the file.
+class MalTraceToOperation : public MalOperation
+{
+public:
+  MalTraceToOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
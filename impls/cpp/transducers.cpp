@@ -0,0 +1,439 @@
+#include "transducers.hpp"
+#include "lazy.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+
+#include <algorithm>
+#include <typeinfo>
+
+static bool isReduced(const MalType& value)
+{
+  return typeid(*value) == typeid(MalReduced);
+}
+
+static MalType ensureReduced(const MalType& value)
+{
+  return isReduced(value) ? value : MalType(new MalReduced(value));
+}
+
+static MalType unreduced(const MalType& value)
+{
+  return isReduced(value) ? static_cast<MalReduced*>(&*value)->deref() : value;
+}
+
+static bool isTruthy(const MalType& value)
+{
+  return !dynamic_cast<MalNil*>(&*value) && !dynamic_cast<MalFalse*>(&*value);
+}
+
+static int64_t toInt(const MalType& value)
+{
+  auto* malInt = dynamic_cast<MalInt*>(&*value);
+
+  if(!malInt) throw TypeException("Expected a number but got " + Printer::prStr(value, true));
+
+  return **malInt;
+}
+
+static MalType checkCallable(const MalType& value)
+{
+  if(!dynamic_cast<MalOperation*>(&*value)) throw TypeException("Cannot call " + Printer::prStr(value, true));
+
+  return value;
+}
+
+string MalReduced::getString(bool printReadably)
+{
+  return "#<reduced " + value_->getString(printReadably) + ">";
+}
+
+Caller::Caller(const MalType& function):
+  function_(checkCallable(function)), operation_(static_cast<MalOperation*>(&*function_)), busy_(false)
+{
+}
+
+MalType Caller::call()
+{
+  busy_ = true;
+
+  try
+  {
+    auto result = operation_->apply(args_);
+    busy_ = false;
+
+    return result;
+  }
+  catch(...)
+  {
+    busy_ = false;
+    throw;
+  }
+}
+
+MalType Caller::operator()()
+{
+  return operation_->apply({});
+}
+
+MalType Caller::operator()(const MalType& a)
+{
+  if(busy_) return operation_->apply({ a });
+
+  args_.resize(1);
+  args_[0] = a;
+
+  return call();
+}
+
+MalType Caller::operator()(const MalType& a, const MalType& b)
+{
+  if(busy_) return operation_->apply({ a, b });
+
+  args_.resize(2);
+  args_[0] = a;
+  args_[1] = b;
+
+  return call();
+}
+
+class FunctionReducer : public MalReducer
+{
+  Caller function_;
+
+public:
+  FunctionReducer(const MalType& function): function_(function) {}
+
+  virtual MalType step(const MalType& acc, const MalType& input) override { return function_(acc, input); }
+  virtual MalType complete(const MalType& acc) override { return acc; }
+};
+
+class MapReducer : public MalReducer
+{
+  Caller function_;
+  shared_ptr<MalReducer> downstream_;
+
+public:
+  MapReducer(const MalType& function, shared_ptr<MalReducer> downstream):
+    function_(function), downstream_(std::move(downstream)) {}
+
+  virtual MalType step(const MalType& acc, const MalType& input) override
+  {
+    return downstream_->step(acc, function_(input));
+  }
+
+  virtual MalType complete(const MalType& acc) override { return downstream_->complete(acc); }
+};
+
+class FilterReducer : public MalReducer
+{
+  Caller predicate_;
+  shared_ptr<MalReducer> downstream_;
+
+public:
+  FilterReducer(const MalType& predicate, shared_ptr<MalReducer> downstream):
+    predicate_(predicate), downstream_(std::move(downstream)) {}
+
+  virtual MalType step(const MalType& acc, const MalType& input) override
+  {
+    return isTruthy(predicate_(input)) ? downstream_->step(acc, input) : acc;
+  }
+
+  virtual MalType complete(const MalType& acc) override { return downstream_->complete(acc); }
+};
+
+class TakeReducer : public MalReducer
+{
+  int64_t remaining_;
+  shared_ptr<MalReducer> downstream_;
+
+public:
+  TakeReducer(int64_t count, shared_ptr<MalReducer> downstream):
+    remaining_(count), downstream_(std::move(downstream)) {}
+
+  virtual MalType step(const MalType& acc, const MalType& input) override
+  {
+    auto result = remaining_-- > 0 ? downstream_->step(acc, input) : acc;
+
+    return remaining_ <= 0 ? ensureReduced(result) : result;
+  }
+
+  virtual MalType complete(const MalType& acc) override { return downstream_->complete(acc); }
+};
+
+class PartitionAllReducer : public MalReducer
+{
+  // Partitions can be asked for far bigger than the input; buffers grow
+  // past this as elements arrive instead.
+  static constexpr size_t maxReserve = 1024;
+
+  size_t size_;
+  vector<MalType> buffer_;
+  shared_ptr<MalReducer> downstream_;
+
+  MalType flush()
+  {
+    MalType partition(new MalVector(std::move(buffer_)));
+
+    buffer_.clear();
+    buffer_.reserve(std::min(size_, maxReserve));
+
+    return partition;
+  }
+
+public:
+  PartitionAllReducer(size_t size, shared_ptr<MalReducer> downstream):
+    size_(size), downstream_(std::move(downstream))
+  {
+    buffer_.reserve(std::min(size_, maxReserve));
+  }
+
+  virtual MalType step(const MalType& acc, const MalType& input) override
+  {
+    buffer_.push_back(input);
+
+    return buffer_.size() < size_ ? acc : downstream_->step(acc, flush());
+  }
+
+  virtual MalType complete(const MalType& acc) override
+  {
+    if(buffer_.empty()) return downstream_->complete(acc);
+
+    return downstream_->complete(unreduced(downstream_->step(acc, flush())));
+  }
+};
+
+class DedupeReducer : public MalReducer
+{
+  MalType previous_;
+  shared_ptr<MalReducer> downstream_;
+
+public:
+  DedupeReducer(shared_ptr<MalReducer> downstream): downstream_(std::move(downstream)) {}
+
+  virtual MalType step(const MalType& acc, const MalType& input) override
+  {
+    if(previous_ && previous_->equals(input)) return acc;
+
+    previous_ = input;
+
+    return downstream_->step(acc, input);
+  }
+
+  virtual MalType complete(const MalType& acc) override { return downstream_->complete(acc); }
+};
+
+MalType MalReducer::apply(const vector<MalType>& args)
+{
+  if(args.size() == 2) return step(args[0], args[1]);
+  if(args.size() == 1) return complete(args[0]);
+
+  throw TypeException("A reducing function takes an accumulator and an input, or just an accumulator to complete it");
+}
+
+shared_ptr<MalReducer> MalReducer::from(const MalType& rf)
+{
+  if(auto reducer = std::dynamic_pointer_cast<MalReducer>(rf)) return reducer;
+
+  return std::make_shared<FunctionReducer>(rf);
+}
+
+string MalTransducer::getString(bool)
+{
+  return "#<transducer>";
+}
+
+MalType MalTransducer::apply(const vector<MalType>& args)
+{
+  return wrap_(MalReducer::from(args[0]));
+}
+
+MalType MalTransducer::map(const MalType& function)
+{
+  checkCallable(function);
+
+  return MalType(new MalTransducer([function](const shared_ptr<MalReducer>& downstream) {
+    return std::make_shared<MapReducer>(function, downstream);
+  }));
+}
+
+MalType MalTransducer::filter(const MalType& predicate)
+{
+  checkCallable(predicate);
+
+  return MalType(new MalTransducer([predicate](const shared_ptr<MalReducer>& downstream) {
+    return std::make_shared<FilterReducer>(predicate, downstream);
+  }));
+}
+
+MalType MalTransducer::take(int64_t count)
+{
+  return MalType(new MalTransducer([count](const shared_ptr<MalReducer>& downstream) {
+    return std::make_shared<TakeReducer>(count, downstream);
+  }));
+}
+
+MalType MalTransducer::partitionAll(int64_t size)
+{
+  if(size < 1) throw TypeException("partition-all takes a size of at least 1");
+
+  return MalType(new MalTransducer([size](const shared_ptr<MalReducer>& downstream) {
+    return std::make_shared<PartitionAllReducer>(size, downstream);
+  }));
+}
+
+MalType MalTransducer::dedupe()
+{
+  return MalType(new MalTransducer([](const shared_ptr<MalReducer>& downstream) {
+    return std::make_shared<DedupeReducer>(downstream);
+  }));
+}
+
+MalType MalReduceOperation::apply(const vector<MalType>& args)
+{
+  Caller function(args[0]);
+  SeqCursor cursor(args.back());
+  MalType acc;
+  MalType input;
+
+  if(args.size() > 2)
+  {
+    acc = args[1];
+  }
+  else if(!cursor.next(acc))
+  {
+    return function();
+  }
+
+  while(cursor.next(input))
+  {
+    acc = function(acc, input);
+
+    if(isReduced(acc)) return unreduced(acc);
+  }
+
+  return acc;
+}
+
+MalType MalTransduceOperation::apply(const vector<MalType>& args)
+{
+  if(args.size() < 3) throw TypeException("transduce takes a transducer, a reducing function, an optional init and a collection");
+
+  auto reducer = MalReducer::from(Caller(args[0])(args[1]));
+  auto acc = args.size() > 3 ? args[2] : Caller(args[1])();
+  SeqCursor cursor(args.back());
+  MalType input;
+
+  while(cursor.next(input))
+  {
+    acc = reducer->step(acc, input);
+
+    if(isReduced(acc))
+    {
+      acc = unreduced(acc);
+      break;
+    }
+  }
+
+  return reducer->complete(acc);
+}
+
+MalType MalReducedOperation::apply(const vector<MalType>& args)
+{
+  return MalType(new MalReduced(args[0]));
+}
+
+MalType MalIsReducedOperation::apply(const vector<MalType>& args)
+{
+  return isReduced(args[0]) ? MTrue : MFalse;
+}
+
+class ComposedOperation : public MalOperation
+{
+  vector<MalType> functions_;
+
+public:
+  ComposedOperation(vector<MalType> functions): functions_(std::move(functions)) {}
+
+  virtual MalType apply(const vector<MalType>& args) override
+  {
+    if(functions_.empty()) return args[0];
+
+    auto result = static_cast<MalOperation*>(&*functions_.back())->apply(args);
+
+    for(auto itr = functions_.rbegin() + 1; itr != functions_.rend(); ++itr)
+    {
+      result = static_cast<MalOperation*>(&**itr)->apply({ result });
+    }
+
+    return result;
+  }
+};
+
+MalType MalCompOperation::apply(const vector<MalType>& args)
+{
+  if(args.size() == 1) return checkCallable(args[0]);
+
+  for(const auto& arg : args)
+  {
+    checkCallable(arg);
+  }
+
+  return MalType(new ComposedOperation(args));
+}
+
+MalType MalPartitionAllOperation::apply(const vector<MalType>& args)
+{
+  int64_t size = toInt(args[0]);
+
+  if(args.size() == 1) return MalTransducer::partitionAll(size);
+  if(size < 1) throw TypeException("partition-all takes a size of at least 1");
+
+  SeqCursor cursor(args[1]);
+
+  return MalLazySeq::generate([size, cursor](vector<MalType>& chunk) mutable {
+    MalType value;
+
+    while(chunk.size() < MalLazySeq::chunkSize && (chunk.empty() || cursor.buffered()))
+    {
+      vector<MalType> partition;
+
+      while(partition.size() < static_cast<size_t>(size) && cursor.next(value))
+      {
+        partition.push_back(value);
+      }
+
+      if(partition.empty()) return false;
+
+      bool full = partition.size() == static_cast<size_t>(size);
+      chunk.push_back(MalType(new MalVector(std::move(partition))));
+
+      if(!full) return false;
+    }
+
+    return true;
+  });
+}
+
+MalType MalDedupeOperation::apply(const vector<MalType>& args)
+{
+  if(args.empty()) return MalTransducer::dedupe();
+
+  SeqCursor cursor(args[0]);
+  MalType previous;
+
+  return MalLazySeq::generate([cursor, previous](vector<MalType>& chunk) mutable {
+    MalType value;
+
+    while(chunk.size() < MalLazySeq::chunkSize && (chunk.empty() || cursor.buffered()))
+    {
+      if(!cursor.next(value)) return false;
+
+      if(previous && previous->equals(value)) continue;
+
+      previous = value;
+      chunk.push_back(value);
+    }
+
+    return true;
+  });
+}
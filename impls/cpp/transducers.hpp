@@ -0,0 +1,136 @@
+#pragma once
+
+#include "types.hpp"
+
+// (reduced x): returned by a reducing function to stop the reduction early.
+class MalReduced : public MalDerefable
+{
+  MalType value_;
+
+public:
+  MalReduced(const MalType& value): value_(value) {}
+
+  virtual string getString(bool printReadably) override;
+
+  virtual MalType deref() override { return value_; }
+};
+
+// Calls one function many times, reusing a single argument vector unless a
+// call comes back in through the same caller.
+class Caller
+{
+  MalType function_;
+  MalOperation* operation_;
+  vector<MalType> args_;
+  bool busy_;
+
+  MalType call();
+
+public:
+  Caller(const MalType& function);
+
+  MalType operator()();
+  MalType operator()(const MalType& a);
+  MalType operator()(const MalType& a, const MalType& b);
+};
+
+// A reducing function. step folds one input into the accumulator; complete
+// finishes the result once the input is used up or a step returned reduced.
+// Called from Mal, (rf acc x) steps and (rf acc) completes.
+class MalReducer : public MalOperation
+{
+public:
+  virtual MalType step(const MalType& acc, const MalType& input) = 0;
+  virtual MalType complete(const MalType& acc) = 0;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+
+  // rf itself if it is native, otherwise an adapter that steps by calling
+  // it and completes by returning the accumulator.
+  static shared_ptr<MalReducer> from(const MalType& rf);
+};
+
+// Built by (map f), (filter pred), (take n), (partition-all n) and (dedupe).
+// Applied to a reducing function, it returns a new native reducer with
+// fresh state, so one transducer can be used by any number of transduces.
+// comp of transducers therefore builds a single fused reducer.
+class MalTransducer : public MalOperation
+{
+public:
+  typedef function<shared_ptr<MalReducer>(const shared_ptr<MalReducer>& downstream)> Wrap;
+
+private:
+  Wrap wrap_;
+
+public:
+  MalTransducer(Wrap wrap): wrap_(std::move(wrap)) {}
+
+  virtual string getString(bool printReadably) override;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+
+  static MalType map(const MalType& function);
+  static MalType filter(const MalType& predicate);
+  static MalType take(int64_t count);
+  static MalType partitionAll(int64_t size);
+  static MalType dedupe();
+};
+
+class MalReduceOperation : public MalOperation
+{
+public:
+  MalReduceOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalTransduceOperation : public MalOperation
+{
+public:
+  MalTransduceOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalReducedOperation : public MalOperation
+{
+public:
+  MalReducedOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalIsReducedOperation : public MalOperation
+{
+public:
+  MalIsReducedOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (comp f g h) calls h, then g on its result, then f.
+class MalCompOperation : public MalOperation
+{
+public:
+  MalCompOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (partition-all n coll) lazily, or (partition-all n) as a transducer.
+// Both give the partitions as vectors.
+class MalPartitionAllOperation : public MalOperation
+{
+public:
+  MalPartitionAllOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalDedupeOperation : public MalOperation
+{
+public:
+  MalDedupeOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
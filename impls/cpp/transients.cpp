@@ -0,0 +1,246 @@
+#include "transients.hpp"
+#include "error.hpp"
+#include "printer.hpp"
+#include "heap.hpp"
+
+void MalTransient::ensureEditable() const
+{
+  if(persistent_) throw TypeException("Transient used after persistent! call");
+}
+
+void MalTransient::freeze()
+{
+  ensureEditable();
+  persistent_ = true;
+}
+
+string MalTransient::getString(bool)
+{
+  return "#<transient>";
+}
+
+MalType MalTransientVector::persistent()
+{
+  freeze();
+
+  return MalType(new MalVector(std::move(elements_)));
+}
+
+void MalTransientVector::conj(const MalType& value)
+{
+  ensureEditable();
+  elements_.push_back(value);
+}
+
+size_t MalTransientVector::count() const
+{
+  ensureEditable();
+
+  return elements_.size();
+}
+
+void MalTransientVector::traverse(HeapVisitor& visitor) const
+{
+  visitor.elements(elements_);
+}
+
+void MalTransientVector::assoc(int64_t index, const MalType& value)
+{
+  ensureEditable();
+
+  if(index < 0 || static_cast<size_t>(index) > elements_.size())
+  {
+    throw IndexOutOfBoundsException("Index " + std::to_string(index) + " is out of bounds for assoc!");
+  }
+
+  if(static_cast<size_t>(index) == elements_.size())
+  {
+    elements_.push_back(value);
+  }
+  else
+  {
+    elements_[index] = value;
+  }
+}
+
+void MalTransientVector::pop()
+{
+  ensureEditable();
+
+  if(elements_.empty()) throw IndexOutOfBoundsException("Can't pop! an empty transient vector");
+
+  elements_.pop_back();
+}
+
+MalType MalTransientVector::get(int64_t index) const
+{
+  ensureEditable();
+
+  if(index < 0 || static_cast<size_t>(index) >= elements_.size()) return nullptr;
+
+  return elements_[index];
+}
+
+MalType MalTransientMap::persistent()
+{
+  freeze();
+
+  return MalType(new MalHashMap(std::move(entries_)));
+}
+
+void MalTransientMap::conj(const MalType& value)
+{
+  ensureEditable();
+
+  if(auto* malMap = dynamic_cast<MalHashMap*>(&*value))
+  {
+    for(const auto& pair : malMap->getEntries())
+    {
+      entries_[pair.first] = pair.second;
+    }
+
+    return;
+  }
+
+  auto* entry = dynamic_cast<MalVector*>(&*value);
+
+  if(!entry || entry->size() != 2) throw TypeException("conj! on a transient map takes [key value] or a map");
+
+  assoc((*entry)[0], (*entry)[1]);
+}
+
+size_t MalTransientMap::count() const
+{
+  ensureEditable();
+
+  return entries_.size();
+}
+
+void MalTransientMap::traverse(HeapVisitor& visitor) const
+{
+  visitor.entries(entries_);
+}
+
+void MalTransientMap::assoc(const MalType& key, const MalType& value)
+{
+  ensureEditable();
+
+  auto entry = MalHashMap::keyFor(key);
+
+  if(entry.empty()) throw InvalidKeyException("Invalid key in hashmap");
+
+  entries_[entry] = value;
+}
+
+void MalTransientMap::dissoc(const MalType& key)
+{
+  ensureEditable();
+  entries_.erase(MalHashMap::keyFor(key));
+}
+
+MalType MalTransientMap::get(const MalType& key) const
+{
+  ensureEditable();
+
+  auto itr = entries_.find(MalHashMap::keyFor(key));
+
+  return itr == entries_.end() ? nullptr : itr->second;
+}
+
+static MalTransient* toTransient(const MalType& value)
+{
+  auto* transient = dynamic_cast<MalTransient*>(&*value);
+
+  if(!transient) throw TypeException("Expected a transient but got " + Printer::prStr(value, true));
+
+  return transient;
+}
+
+template<typename Transient>
+static Transient* toTransient(const MalType& value, const string& operation)
+{
+  auto* transient = dynamic_cast<Transient*>(toTransient(value));
+
+  if(!transient) throw TypeException(operation + " isn't supported on " + Printer::prStr(value, true));
+
+  return transient;
+}
+
+MalType MalTransientOperation::apply(const vector<MalType>& args)
+{
+  if(auto* malVector = dynamic_cast<MalVector*>(&*args[0]))
+  {
+    return MalType(new MalTransientVector(vector<MalType>(malVector->begin(), malVector->end())));
+  }
+
+  if(auto* malMap = dynamic_cast<MalHashMap*>(&*args[0]))
+  {
+    return MalType(new MalTransientMap(malMap->getEntries()));
+  }
+
+  throw TypeException("Cannot make a transient of " + Printer::prStr(args[0], true));
+}
+
+MalType MalPersistentOperation::apply(const vector<MalType>& args)
+{
+  return toTransient(args[0])->persistent();
+}
+
+MalType MalTransientAssocOperation::apply(const vector<MalType>& args)
+{
+  if(args.size() % 2 != 1) throw EOFException("Expected equal amount of keys and values");
+
+  if(auto* transientVector = dynamic_cast<MalTransientVector*>(&*args[0]))
+  {
+    for(size_t i = 1; i < args.size(); i += 2)
+    {
+      auto* index = dynamic_cast<MalInt*>(&*args[i]);
+
+      if(!index) throw TypeException("assoc! on a transient vector takes an index but got " + Printer::prStr(args[i], true));
+
+      transientVector->assoc(*(*index), args[i + 1]);
+    }
+
+    return args[0];
+  }
+
+  auto* transientMap = toTransient<MalTransientMap>(args[0], "assoc!");
+
+  for(size_t i = 1; i < args.size(); i += 2)
+  {
+    transientMap->assoc(args[i], args[i + 1]);
+  }
+
+  return args[0];
+}
+
+MalType MalTransientConjOperation::apply(const vector<MalType>& args)
+{
+  auto* transient = toTransient(args[0]);
+
+  for(auto itr = args.begin() + 1; itr != args.end(); ++itr)
+  {
+    transient->conj(*itr);
+  }
+
+  return args[0];
+}
+
+MalType MalTransientDissocOperation::apply(const vector<MalType>& args)
+{
+  auto* transientMap = toTransient<MalTransientMap>(args[0], "dissoc!");
+
+  for(auto itr = args.begin() + 1; itr != args.end(); ++itr)
+  {
+    transientMap->dissoc(*itr);
+  }
+
+  return args[0];
+}
+
+MalType MalTransientPopOperation::apply(const vector<MalType>& args)
+{
+  toTransient<MalTransientVector>(args[0], "pop!")->pop();
+
+  return args[0];
+}
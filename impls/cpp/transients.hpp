@@ -0,0 +1,119 @@
+#pragma once
+
+#include "types.hpp"
+
+// A vector or map under construction. transient copies the collection once;
+// assoc!, conj!, dissoc! and pop! then change that copy in place, and
+// persistent! moves it into a new persistent value in O(1). From then on the
+// transient is spent and any further use throws. A transient belongs to one
+// thread at a time.
+class MalTransient : public MalTypeData
+{
+  bool persistent_;
+
+protected:
+  void ensureEditable() const;
+
+  // Marks the transient spent; subclasses then move their contents out.
+  void freeze();
+
+public:
+  MalTransient(): persistent_(false) {}
+
+  virtual string getString(bool printReadably) override;
+
+  virtual MalType persistent() = 0;
+  virtual void conj(const MalType& value) = 0;
+  virtual size_t count() const = 0;
+};
+
+class MalTransientVector : public MalTransient
+{
+  vector<MalType> elements_;
+
+public:
+  MalTransientVector(vector<MalType> elements): elements_(std::move(elements)) {}
+
+  virtual MalType persistent() override;
+  virtual void conj(const MalType& value) override;
+  virtual size_t count() const override;
+
+  virtual void traverse(HeapVisitor& visitor) const override;
+
+  // index may be one past the end, which appends.
+  void assoc(int64_t index, const MalType& value);
+  void pop();
+
+  // nullptr when the index is out of bounds.
+  MalType get(int64_t index) const;
+};
+
+class MalTransientMap : public MalTransient
+{
+  map<string, MalType> entries_;
+
+public:
+  MalTransientMap(map<string, MalType> entries): entries_(std::move(entries)) {}
+
+  virtual MalType persistent() override;
+
+  // Takes a [key value] vector, or a map whose entries are all added.
+  virtual void conj(const MalType& value) override;
+  virtual size_t count() const override;
+
+  virtual void traverse(HeapVisitor& visitor) const override;
+
+  void assoc(const MalType& key, const MalType& value);
+  void dissoc(const MalType& key);
+
+  // nullptr when the key is absent.
+  MalType get(const MalType& key) const;
+};
+
+class MalTransientOperation : public MalOperation
+{
+public:
+  MalTransientOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalPersistentOperation : public MalOperation
+{
+public:
+  MalPersistentOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalTransientAssocOperation : public MalOperation
+{
+public:
+  MalTransientAssocOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalTransientConjOperation : public MalOperation
+{
+public:
+  MalTransientConjOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalTransientDissocOperation : public MalOperation
+{
+public:
+  MalTransientDissocOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalTransientPopOperation : public MalOperation
+{
+public:
+  MalTransientPopOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
@@ -3,49 +3,156 @@
 #include "env.hpp"
 #include "printer.hpp"
 #include "reader.hpp"
+#include "evaluator.hpp"
+#include "interpreter.hpp"
+#include "futures.hpp"
+#include "transients.hpp"
+#include "lazy.hpp"
+#include "bigint.hpp"
+#include "numbers.hpp"
+#include "arrays.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+#include "heap.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
 
 using std::cout;
 using std::endl;
 using std::ifstream;
 using std::stringstream;
 
-MalType EVAL(MalType input, Env env);
+// The constants are immortal: aliasing an empty shared_ptr gives them no
+// control block, so copying them never touches a shared reference count
+// and interpreters on different threads don't contend on them.
+static MalFalse falseValue;
+static MalTrue trueValue;
+static MalNil nilValue;
 
-MalType MFalse = MalType(new MalFalse());
-MalType MTrue = MalType(new MalTrue());
-MalType MNil = MalType(new MalNil());
+MalType MFalse = MalType(MalType(), &falseValue);
+MalType MTrue = MalType(MalType(), &trueValue);
+MalType MNil = MalType(MalType(), &nilValue);
 
-MalInt::MalInt(int value)
+MalType MalTypeData::deepCopy() const
 {
-  value_ = value;
+  throw TypeException("Cannot copy " + const_cast<MalTypeData*>(this)->getString(true) + " to another interpreter");
 }
 
-string MalInt::getString(bool _)
+shared_ptr<Cursor> MalTypeData::cursor(const MalType& _)
 {
-  return std::to_string(value_);
+  return nullptr;
 }
 
-int MalInt::operator+(const MalInt& other) const
+SeqCursor::SeqCursor(const MalType& seq): cursor_(seq->cursor(seq))
 {
-  return value_ + other.value_;
+  if(!cursor_) throw TypeException(Printer::prStr(seq, true) + " is not a sequence");
 }
 
-int MalInt::operator-(const MalInt& other) const
+class EnumerableCursor : public Cursor
+{
+  MalType owner_;
+  MalEnumerable* enumerable_;
+  size_t index_;
+
+public:
+  EnumerableCursor(const MalType& owner):
+    owner_(owner), enumerable_(static_cast<MalEnumerable*>(&*owner)), index_(0) {}
+
+  virtual bool next(MalType& value) override
+  {
+    if(index_ >= enumerable_->size()) return false;
+
+    value = (*enumerable_)[index_++];
+    return true;
+  }
+};
+
+class EmptyCursor : public Cursor
+{
+public:
+  virtual bool next(MalType& _) override { return false; }
+};
+
+class StringCursor : public Cursor
+{
+  string value_;
+  size_t index_;
+
+public:
+  StringCursor(string value): value_(std::move(value)), index_(0) {}
+
+  virtual bool next(MalType& value) override
+  {
+    if(index_ >= value_.size()) return false;
+
+    value = MalType(new MalString(string(1, value_[index_++])));
+    return true;
+  }
+};
+
+class MapCursor : public Cursor
+{
+  MalType owner_;
+  map<string, MalType>::const_iterator next_;
+  map<string, MalType>::const_iterator end_;
+
+public:
+  MapCursor(const MalType& owner): owner_(owner)
+  {
+    const auto& entries = static_cast<MalHashMap*>(&*owner)->getEntries();
+
+    next_ = entries.begin();
+    end_ = entries.end();
+  }
+
+  virtual bool next(MalType& value) override
+  {
+    if(next_ == end_) return false;
+
+    value = MalType(new MalVector({ MalHashMap::keyFrom(next_->first), next_->second }));
+    ++next_;
+    return true;
+  }
+};
+
+MalInt::MalInt(int64_t value)
 {
-  return value_ - other.value_;
+  value_ = value;
 }
 
-int MalInt::operator*(const MalInt& other) const
+MalType MalInt::of(int64_t value)
 {
-  return value_ * other.value_;
+  static const int64_t low = -128;
+  static const int64_t high = 1024;
+  // Immortal like the constants above: built in static storage and never
+  // freed, so copies don't contend on a count shared by every thread.
+  static const vector<MalType> cache = [] {
+    static std::aligned_storage_t<sizeof(MalInt), alignof(MalInt)> storage[high - low + 1];
+    vector<MalType> ints;
+
+    for(int64_t i = low; i <= high; ++i)
+    {
+      ints.push_back(MalType(MalType(), ::new(&storage[i - low]) MalInt(i)));
+    }
+
+    return ints;
+  }();
+
+  if(value < low || value > high) return MalType(new MalInt(value));
+
+  return cache[value - low];
 }
 
-int MalInt::operator/(const MalInt& other) const
+string MalInt::getString(bool _)
 {
-  return value_ / other.value_;
+  return std::to_string(value_);
 }
 
 bool MalInt::operator>(const MalInt& other) const
@@ -68,7 +175,7 @@ bool MalInt::operator<=(const MalInt& other) const
   return !((*this) > other);
 }
 
-int MalInt::operator*() const
+int64_t MalInt::operator*() const
 {
   return value_;
 }
@@ -82,19 +189,59 @@ bool MalInt::equals(const MalType& other) const
   return value_ == otherInt->value_;
 }
 
-MalSymbol::MalSymbol(string symbol)
+MalType MalInt::deepCopy() const
 {
-  symbol_ = symbol;
+  return MalType(new MalInt(value_));
 }
 
-string MalSymbol::getSymbol() const
+namespace
 {
-  return symbol_;
+  struct SymbolStore
+  {
+    std::mutex mutex;
+    std::unordered_map<string, SymbolId> ids;
+    std::deque<string> names;
+  };
+
+  SymbolStore& symbolStore()
+  {
+    static SymbolStore store;
+    return store;
+  }
+}
+
+SymbolId SymbolTable::intern(const string& name)
+{
+  auto& store = symbolStore();
+  std::lock_guard<std::mutex> lock(store.mutex);
+
+  auto pos = store.ids.find(name);
+  if(pos != store.ids.end()) return pos->second;
+
+  SymbolId id = store.names.size();
+  store.names.push_back(name);
+  store.ids.emplace(name, id);
+
+  return id;
+}
+
+const string& SymbolTable::name(const SymbolId& id)
+{
+  auto& store = symbolStore();
+  std::lock_guard<std::mutex> lock(store.mutex);
+
+  return store.names[id];
+}
+
+MalSymbol::MalSymbol(const string& symbol)
+{
+  id_ = SymbolTable::intern(symbol);
+  symbol_ = &SymbolTable::name(id_);
 }
 
 string MalSymbol::getString(bool _)
 {
-  return symbol_;
+  return *symbol_;
 }
 
 bool MalSymbol::equals(const MalType& other) const
@@ -103,12 +250,33 @@ bool MalSymbol::equals(const MalType& other) const
 
   auto* otherSymbol = dynamic_cast<MalSymbol*>(&*other);
 
-  return symbol_ == otherSymbol->symbol_;
+  return id_ == otherSymbol->id_;
+}
+
+MalType MalSymbol::deepCopy() const
+{
+  return MalType(new MalSymbol(*symbol_));
 }
 
-MalEnumerable::MalEnumerable(vector<MalType> elements)
+MalEnumerable::MalEnumerable(): pending_(true)
 {
-  elements_ = elements;
+}
+
+MalEnumerable::MalEnumerable(vector<MalType> elements): pending_(false)
+{
+  elements_ = std::move(elements);
+}
+
+shared_ptr<Cursor> MalEnumerable::cursor(const MalType& self)
+{
+  return std::make_shared<EnumerableCursor>(self);
+}
+
+void MalEnumerable::traverse(HeapVisitor& visitor) const
+{
+  // Lazy subclasses fill elements_ in when realized; reading it here must
+  // not realize them.
+  if(!pending_.load(std::memory_order_acquire)) visitor.elements(elements_);
 }
 
 bool MalEnumerable::equals(const MalType& other) const
@@ -142,6 +310,19 @@ string MalList::getString(bool printReadably)
   return out;
 }
 
+MalType MalList::deepCopy() const
+{
+  vector<MalType> elements;
+  elements.reserve(elements_.size());
+
+  for(const auto& element : elements_)
+  {
+    elements.push_back(element->deepCopy());
+  }
+
+  return MalType(new MalList(elements));
+}
+
 MalString::MalString(const string& value)
 {
   value_ = value;
@@ -183,7 +364,22 @@ bool MalString::equals(const MalType& other) const
   return value_ == otherString->value_;
 }
 
-string MalString::operator*()
+shared_ptr<Cursor> MalString::cursor(const MalType& _)
+{
+  return std::make_shared<StringCursor>(value_);
+}
+
+MalType MalString::deepCopy() const
+{
+  return MalType(new MalString(value_));
+}
+
+void MalString::traverse(HeapVisitor& visitor) const
+{
+  visitor.text(value_);
+}
+
+const string& MalString::operator*() const
 {
   return value_;
 }
@@ -198,6 +394,16 @@ bool MalNil::equals(const MalType& other) const
   return other == MNil;
 }
 
+shared_ptr<Cursor> MalNil::cursor(const MalType& _)
+{
+  return std::make_shared<EmptyCursor>();
+}
+
+MalType MalNil::deepCopy() const
+{
+  return MNil;
+}
+
 string MalTrue::getString(bool _)
 {
   return "true";
@@ -208,6 +414,11 @@ bool MalTrue::equals(const MalType& other) const
   return other == MTrue;
 }
 
+MalType MalTrue::deepCopy() const
+{
+  return MTrue;
+}
+
 string MalFalse::getString(bool _)
 {
   return "false";
@@ -218,6 +429,11 @@ bool MalFalse::equals(const MalType& other) const
   return other == MFalse;
 }
 
+MalType MalFalse::deepCopy() const
+{
+  return MFalse;
+}
+
 string MalVector::getString(bool printReadably)
 {
   string out = "[";
@@ -233,6 +449,19 @@ string MalVector::getString(bool printReadably)
   return out;
 }
 
+MalType MalVector::deepCopy() const
+{
+  vector<MalType> elements;
+  elements.reserve(elements_.size());
+
+  for(const auto& element : elements_)
+  {
+    elements.push_back(element->deepCopy());
+  }
+
+  return MalType(new MalVector(elements));
+}
+
 MalKeyword::MalKeyword(const string& keyword)
 {
   keyword_ = keyword;
@@ -252,29 +481,52 @@ bool MalKeyword::equals(const MalType& other) const
   return keyword_ == otherString->keyword_;
 }
 
+MalType MalKeyword::deepCopy() const
+{
+  return MalType(new MalKeyword(keyword_));
+}
+
+void MalKeyword::traverse(HeapVisitor& visitor) const
+{
+  visitor.text(keyword_);
+}
+
 MalHashMap::MalHashMap(vector<MalType> elements)
 {
   if(elements.size() % 2 != 0) throw EOFException("Expected equal amount of keys and values");
 
   for(size_t i = 0; i < elements.size(); i += 2)
   {
-    const auto& value = elements[i + 1];
+    auto key = keyFor(elements[i]);
 
-    if(auto* stringKey = dynamic_cast<MalString*>(&*elements[i]))
-    {
-      map_['"' + stringKey->getString(false) + '"'] = value;
-    }
-    else if (auto* keywordKey = dynamic_cast<MalKeyword*>(&*elements[i]))
-    {
-      map_[keywordKey->getString(false)] = value;
-    }
-    else
-    {
-     throw InvalidKeyException("Invalid key in hashmap");
-    }
+    if(key.empty()) throw InvalidKeyException("Invalid key in hashmap");
+
+    map_[key] = elements[i + 1];
   }
 }
 
+string MalHashMap::keyFor(const MalType& key)
+{
+  if(auto* stringKey = dynamic_cast<MalString*>(&*key))
+  {
+    return '"' + stringKey->getString(false) + '"';
+  }
+
+  if(auto* keywordKey = dynamic_cast<MalKeyword*>(&*key))
+  {
+    return keywordKey->getString(false);
+  }
+
+  return "";
+}
+
+MalType MalHashMap::keyFrom(const string& key)
+{
+  if(key[0] == '"') return MalType(new MalString(key.substr(1, key.size() - 2)));
+
+  return MalType(new MalKeyword(key));
+}
+
 string MalHashMap::getString(bool printReadably)
 {
   string out = "{";
@@ -296,7 +548,7 @@ bool MalHashMap::equals(const MalType& other) const
   auto* otherMap = dynamic_cast<MalHashMap*>(&*other);
   if(!otherMap || otherMap->map_.size() != map_.size()) return false;
 
-  for(auto pair : (*otherMap))
+  for(const auto& pair : (*otherMap))
   {
     if(!contains(pair.first)) return false;
 
@@ -307,51 +559,41 @@ bool MalHashMap::equals(const MalType& other) const
   return true;
 }
 
-MalType& MalHashMap::operator[](const string& key)
+shared_ptr<Cursor> MalHashMap::cursor(const MalType& self)
 {
-  return map_[key];
+  return std::make_shared<MapCursor>(self);
 }
 
-bool MalHashMap::contains(const string& key) const
+MalType MalHashMap::deepCopy() const
 {
-  return map_.find(key) != map_.end();
-}
+  auto* copy = new MalHashMap(map<string, MalType>());
 
-string MalOperation::getString(bool _)
-{
-  return "";
+  for(const auto& pair : map_)
+  {
+    copy->map_[pair.first] = pair.second->deepCopy();
+  }
+
+  return MalType(copy);
 }
 
-MalType MalAddOperation::apply(const vector<MalType>& args)
+void MalHashMap::traverse(HeapVisitor& visitor) const
 {
-  auto a = dynamic_cast<MalInt*>(&*args[0]);
-  auto b = dynamic_cast<MalInt*>(&*args[1]);
-
-  return MalType(new MalInt((*a) + (*b)));
+  visitor.entries(map_);
 }
 
-MalType MalMultOperation::apply(const vector<MalType>& args)
+MalType& MalHashMap::operator[](const string& key)
 {
-  auto a = dynamic_cast<MalInt*>(&*args[0]);
-  auto b = dynamic_cast<MalInt*>(&*args[1]);
-
-  return MalType(new MalInt((*a) * (*b)));
+  return map_[key];
 }
 
-MalType MalSubOperation::apply(const vector<MalType>& args)
+bool MalHashMap::contains(const string& key) const
 {
-  auto a = dynamic_cast<MalInt*>(&*args[0]);
-  auto b = dynamic_cast<MalInt*>(&*args[1]);
-
-  return MalType(new MalInt((*a) - (*b)));
+  return map_.find(key) != map_.end();
 }
 
-MalType MalDivOperation::apply(const vector<MalType>& args)
+string MalOperation::getString(bool _)
 {
-  auto a = dynamic_cast<MalInt*>(&*args[0]);
-  auto b = dynamic_cast<MalInt*>(&*args[1]);
-
-  return MalType(new MalInt((*a) / (*b)));
+  return "";
 }
 
 MalFunction::MalFunction(const vector<MalType>& bindings, const MalType& body, const Env& baseEnv, const bool& isMacro)
@@ -360,6 +602,7 @@ MalFunction::MalFunction(const vector<MalType>& bindings, const MalType& body, c
   body_ = body;
   baseEnv_ = baseEnv;
   isMacro_ = isMacro;
+  name_ = CallStack::anonymous();
 }
 
 string MalFunction::getString(bool _)
@@ -369,7 +612,19 @@ string MalFunction::getString(bool _)
 
 MalType MalFunction::apply(const vector<MalType>& args)
 {
-  return EVAL(body_, makeEnv(args));
+  auto env = makeEnv(args);
+
+  CallStack::Frame frame;
+  frame.enter(getName(), &*env);
+
+  return EVAL(body_, env);
+}
+
+void MalFunction::traverse(HeapVisitor& visitor) const
+{
+  visitor.elements(bindings_);
+  visitor.value(body_);
+  visitor.env(baseEnv_);
 }
 
 MalType MalFunction::getBody() const
@@ -393,17 +648,25 @@ bool MalFunction::isMacro() const
   return isMacro_;
 }
 
+void MalFunction::nameIfAnonymous(SymbolId name)
+{
+  auto anonymous = CallStack::anonymous();
+
+  name_.compare_exchange_strong(anonymous, name);
+}
+
 MalType MalPrnOperation::apply(const vector<MalType>& args)
 {
   string out;
 
-  for(auto mal : args)
+  for(const auto& mal : args)
   {
     if(out != "") out += ' ';
     out += Printer::prStr(mal, true);
   }
 
-  cout << out << endl;
+  std::lock_guard<std::mutex> lock(interpreter_.getOutputMutex());
+  interpreter_.getOutput() << out << endl;
 
   return MNil;
 }
@@ -415,60 +678,65 @@ MalType MalListOperation::apply(const vector<MalType>& args)
 
 MalType MalIsListOperation::apply(const vector<MalType>& args)
 {
-  return typeid(*args[0]) == typeid(MalList) ? MTrue : MFalse;
+  return typeid(*args[0]) == typeid(MalList) || typeid(*args[0]) == typeid(MalLazySeq) ? MTrue : MFalse;
 }
 
 MalType MalIsEmptyOperation::apply(const vector<MalType>& args)
 {
-  auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0]);
+  if(auto* lazySeq = dynamic_cast<MalLazySeq*>(&*args[0])) return lazySeq->hasFirst() ? MFalse : MTrue;
+  if(auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0])) return enumerable->isEmpty() ? MTrue : MFalse;
+  if(auto* malMap = dynamic_cast<MalHashMap*>(&*args[0])) return malMap->size() == 0 ? MTrue : MFalse;
+  if(auto* malString = dynamic_cast<MalString*>(&*args[0])) return (**malString).empty() ? MTrue : MFalse;
 
-  return enumerable->isEmpty() ? MTrue : MFalse;
+  MalType first;
+
+  return SeqCursor(args[0]).next(first) ? MFalse : MTrue;
 }
 
 MalType MalCountOperation::apply(const vector<MalType>& args)
 {
-  auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0]);
+  if(auto* transient = dynamic_cast<MalTransient*>(&*args[0]))
+  {
+    return MalInt::of(static_cast<int64_t>(transient->count()));
+  }
 
-  if(!enumerable) return MalType(new MalInt(0));
+  if(auto* lazySeq = dynamic_cast<MalLazySeq*>(&*args[0]))
+  {
+    return MalInt::of(static_cast<int64_t>(lazySeq->count()));
+  }
 
-  return MalType(new MalInt(static_cast<int>(enumerable->size())));
-}
+  if(auto* malMap = dynamic_cast<MalHashMap*>(&*args[0]))
+  {
+    return MalInt::of(static_cast<int64_t>(malMap->size()));
+  }
 
-MalType MalEqualsOperation::apply(const vector<MalType>& args)
-{
-  return args[0]->equals(args[1]) ? MTrue : MFalse;
-}
+  if(auto* malString = dynamic_cast<MalString*>(&*args[0]))
+  {
+    return MalInt::of(static_cast<int64_t>((**malString).size()));
+  }
 
-MalType MalGTOperation::apply(const vector<MalType>& args)
-{
-  auto a = dynamic_cast<MalInt*>(&*args[0]);
-  auto b = dynamic_cast<MalInt*>(&*args[1]);
+  if(auto* array = dynamic_cast<MalTypedArray*>(&*args[0]))
+  {
+    return MalInt::of(static_cast<int64_t>(array->size()));
+  }
 
-  return (*a) > (*b) ? MTrue : MFalse;
-}
+  auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0]);
 
-MalType MalGTEOperation::apply(const vector<MalType>& args)
-{
-  auto a = dynamic_cast<MalInt*>(&*args[0]);
-  auto b = dynamic_cast<MalInt*>(&*args[1]);
+  if(!enumerable) return MalInt::of(0);
 
-  return (*a) >= (*b) ? MTrue : MFalse;
+  return MalInt::of(static_cast<int64_t>(enumerable->size()));
 }
 
-MalType MalLTOperation::apply(const vector<MalType>& args)
+MalType MalEqualsOperation::apply(const vector<MalType>& args)
 {
-  auto a = dynamic_cast<MalInt*>(&*args[0]);
-  auto b = dynamic_cast<MalInt*>(&*args[1]);
+  if(args.empty()) throw TypeException("= takes at least one argument");
 
-  return (*a) < (*b) ? MTrue : MFalse;
-}
-
-MalType MalLTEOperation::apply(const vector<MalType>& args)
-{
-  auto a = dynamic_cast<MalInt*>(&*args[0]);
-  auto b = dynamic_cast<MalInt*>(&*args[1]);
+  for(size_t i = 1; i < args.size(); ++i)
+  {
+    if(!args[i - 1]->equals(args[i])) return MFalse;
+  }
 
-  return (*a) <= (*b) ? MTrue : MFalse;
+  return MTrue;
 }
 
 MalType MalPrStrOperation::apply(const vector<MalType>& args)
@@ -500,13 +768,14 @@ MalType MalPrintlnOperation::apply(const vector<MalType>& args)
 {
   string out;
 
-  for(auto mal : args)
+  for(const auto& mal : args)
   {
     if(out != "") out += ' ';
     out += Printer::prStr(mal);
   }
 
-  cout << out << endl;
+  std::lock_guard<std::mutex> lock(interpreter_.getOutputMutex());
+  interpreter_.getOutput() << out << endl;
 
   return MNil;
 }
@@ -514,6 +783,7 @@ MalType MalPrintlnOperation::apply(const vector<MalType>& args)
 MalType MalReadStringOperation::apply(const vector<MalType>& args)
 {
   auto* malString = dynamic_cast<MalString*>(&*args[0]);
+  Tracer::Span span("read", "read-string");
 
   return Tokenizer::readStr(*(*malString));
 }
@@ -521,6 +791,7 @@ MalType MalReadStringOperation::apply(const vector<MalType>& args)
 MalType MalSlurpOperation::apply(const vector<MalType>& args)
 {
   auto* malString = dynamic_cast<MalString*>(&*args[0]);
+  Tracer::Span span("io", "slurp", Tracer::enabled() ? "\"path\": " + Tracer::quote(**malString) : "");
 
   ifstream file((*(*malString)));
 
@@ -531,7 +802,7 @@ MalType MalSlurpOperation::apply(const vector<MalType>& args)
 
 MalType MalEvalOperation::apply(const vector<MalType>& args)
 {
-  return EVAL(args[0], nullptr);
+  return interpreter_.eval(args[0]);
 }
 
 MalAtom::MalAtom(const MalType& ref)
@@ -541,7 +812,7 @@ MalAtom::MalAtom(const MalType& ref)
 
 string MalAtom::getString(bool printReadably)
 {
-  return "(atom " + ref_->getString(printReadably) + ")";
+  return "(atom " + (**this)->getString(printReadably) + ")";
 }
 
 bool MalAtom::equals(const MalType& other) const
@@ -549,17 +820,161 @@ bool MalAtom::equals(const MalType& other) const
   auto* otherAtom = dynamic_cast<MalAtom*>(&*other);
   if(!otherAtom) return false;
 
-  return ref_->equals(otherAtom->ref_);
+  return (**this)->equals(**otherAtom);
 }
 
-MalType MalAtom::operator*()
+MalType MalAtom::deepCopy() const
 {
-  return ref_;
+  return MalType(new MalAtom((**this)->deepCopy()));
 }
 
-void MalAtom::setRef(const MalType& ref)
+void MalAtom::traverse(HeapVisitor& visitor) const
 {
-  ref_ = ref;
+  visitor.value(**this);
+
+  if(auto watches = std::atomic_load(&watches_))
+  {
+    visitor.bytes(sizeof(Watches) + watches->capacity() * sizeof(Watches::value_type));
+
+    for(const auto& watch : *watches)
+    {
+      visitor.value(watch.first);
+      visitor.value(watch.second);
+    }
+  }
+}
+
+MalType MalAtom::operator*() const
+{
+  return std::atomic_load(&ref_);
+}
+
+MalType MalAtom::reset(const MalType& ref)
+{
+  return std::atomic_exchange(&ref_, ref);
+}
+
+MalType MalAtom::swap(const function<MalType(const MalType&)>& update)
+{
+  auto current = std::atomic_load(&ref_);
+
+  while(true)
+  {
+    auto next = update(current);
+
+    // On failure current is reloaded with the value that won the race.
+    if(std::atomic_compare_exchange_weak(&ref_, &current, next)) return current;
+  }
+}
+
+bool MalAtom::compareAndSet(const MalType& expected, const MalType& ref)
+{
+  auto current = std::atomic_load(&ref_);
+
+  while(current == expected || current->equals(expected))
+  {
+    if(std::atomic_compare_exchange_weak(&ref_, &current, ref)) return true;
+  }
+
+  return false;
+}
+
+void MalAtom::addWatch(const MalType& key, const MalType& callback)
+{
+  auto current = std::atomic_load(&watches_);
+  shared_ptr<const Watches> next;
+
+  do
+  {
+    auto watches = std::make_shared<Watches>();
+
+    if(current)
+    {
+      for(const auto& watch : *current)
+      {
+        if(!watch.first->equals(key)) watches->push_back(watch);
+      }
+    }
+
+    watches->emplace_back(key, callback);
+    next = watches;
+  }
+  while(!std::atomic_compare_exchange_weak(&watches_, &current, next));
+}
+
+void MalAtom::removeWatch(const MalType& key)
+{
+  auto current = std::atomic_load(&watches_);
+  shared_ptr<const Watches> next;
+
+  do
+  {
+    if(!current) return;
+
+    auto watches = std::make_shared<Watches>();
+
+    for(const auto& watch : *current)
+    {
+      if(!watch.first->equals(key)) watches->push_back(watch);
+    }
+
+    next = watches->empty() ? nullptr : watches;
+  }
+  while(!std::atomic_compare_exchange_weak(&watches_, &current, next));
+}
+
+void MalAtom::notifyWatches(const MalType& self, const MalType& oldRef, const MalType& newRef) const
+{
+  auto watches = std::atomic_load(&watches_);
+  if(!watches) return;
+
+  for(const auto& watch : *watches)
+  {
+    auto* callback = dynamic_cast<MalOperation*>(&*watch.second);
+
+    callback->apply({ watch.first, self, oldRef, newRef });
+  }
+}
+
+static MalAtom* toAtom(const MalType& value)
+{
+  auto* atom = dynamic_cast<MalAtom*>(&*value);
+
+  if(!atom) throw TypeException("Expected an atom but got " + Printer::prStr(value, true));
+
+  return atom;
+}
+
+static MalOperation* toOperation(const MalType& value)
+{
+  auto* operation = dynamic_cast<MalOperation*>(&*value);
+
+  if(!operation) throw TypeException("Cannot call " + Printer::prStr(value, true));
+
+  return operation;
+}
+
+// Runs (f old args...) in a CAS loop and fires the watches once it lands.
+static std::pair<MalType, MalType> swapAtom(const vector<MalType>& args)
+{
+  auto* atom = toAtom(args[0]);
+  auto* operation = toOperation(args[1]);
+
+  vector<MalType> operationArgs(args.size() - 1);
+  std::copy(args.begin() + 2, args.end(), operationArgs.begin() + 1);
+
+  MalType newRef;
+
+  auto oldRef = atom->swap([&](const MalType& current) {
+    operationArgs[0] = current;
+    newRef = operation->apply(operationArgs);
+
+    return newRef;
+  });
+
+  atom->notifyWatches(args[0], oldRef, newRef);
+
+  return { oldRef, newRef };
 }
 
 MalType MalAtomOperation::apply(const vector<MalType>& args)
@@ -574,64 +989,149 @@ MalType MalIsAtomOperation::apply(const vector<MalType>& args)
 
 MalType MalDerefOperation::apply(const vector<MalType>& args)
 {
-  return *(*dynamic_cast<MalAtom*>(&*args[0]));
+  auto* derefable = dynamic_cast<MalDerefable*>(&*args[0]);
+
+  if(!derefable) throw TypeException("Cannot deref " + Printer::prStr(args[0], true));
+
+  if(args.size() > 1)
+  {
+    auto* pending = dynamic_cast<MalPendingRef*>(derefable);
+    auto* timeout = dynamic_cast<MalInt*>(&*args[1]);
+
+    if(!pending) throw TypeException("Cannot deref " + Printer::prStr(args[0], true) + " with a timeout");
+    if(!timeout || args.size() < 3) throw TypeException("deref with a timeout takes milliseconds and a timeout value");
+
+    return pending->deref(*(*timeout), args[2]);
+  }
+
+  return derefable->deref();
 }
 
 MalType MalResetOperation::apply(const vector<MalType>& args)
 {
-  auto* atom = dynamic_cast<MalAtom*>(&*args[0]);
+  auto* atom = toAtom(args[0]);
 
-  atom->setRef(args[1]);
+  auto oldRef = atom->reset(args[1]);
+  atom->notifyWatches(args[0], oldRef, args[1]);
 
   return args[1];
 }
 
 MalType MalSwapOperation::apply(const vector<MalType>& args)
 {
-  auto* atom = dynamic_cast<MalAtom*>(&*args[0]);
-  auto* operation = dynamic_cast<MalOperation*>(&*args[1]);
+  return swapAtom(args).second;
+}
+
+MalType MalSwapValsOperation::apply(const vector<MalType>& args)
+{
+  auto vals = swapAtom(args);
+
+  return MalType(new MalVector({ vals.first, vals.second }));
+}
+
+MalType MalCompareAndSetOperation::apply(const vector<MalType>& args)
+{
+  auto* atom = toAtom(args[0]);
+
+  if(!atom->compareAndSet(args[1], args[2])) return MFalse;
+
+  atom->notifyWatches(args[0], args[1], args[2]);
+
+  return MTrue;
+}
+
+MalType MalAddWatchOperation::apply(const vector<MalType>& args)
+{
+  toOperation(args[2]);
+  toAtom(args[0])->addWatch(args[1], args[2]);
+
+  return args[0];
+}
+
+MalType MalRemoveWatchOperation::apply(const vector<MalType>& args)
+{
+  toAtom(args[0])->removeWatch(args[1]);
 
-  vector<MalType> operationArgs = { *(*atom) };
+  return args[0];
+}
 
-  for(size_t i = 2; i < args.size(); ++i)
+// Appends every element of seq, reading lists and vectors directly and
+// anything else through its cursor.
+static void appendSeq(vector<MalType>& elements, const MalType& seq)
+{
+  if(typeid(*seq) == typeid(MalList) || typeid(*seq) == typeid(MalVector))
   {
-    operationArgs.push_back(args[i]);
+    auto* enumerable = static_cast<MalEnumerable*>(&*seq);
+
+    elements.insert(elements.end(), enumerable->begin(), enumerable->end());
+    return;
   }
 
-  atom->setRef(operation->apply(operationArgs));
+  SeqCursor cursor(seq);
+  MalType value;
 
-  return *(*atom);
+  while(cursor.next(value))
+  {
+    elements.push_back(value);
+  }
 }
 
 MalType MalConsOperation::apply(const vector<MalType>& args)
 {
+  // Leaves the rest unrealized, so (lazy-seq (cons x ...)) can recurse forever.
+  if(auto* lazySeq = dynamic_cast<MalLazySeq*>(&*args[1])) return MalLazySeq::cons(args[0], *lazySeq);
+
   vector<MalType> elements = {args[0]};
 
-  auto* malEnumerable = dynamic_cast<MalEnumerable*>(&*args[1]);
+  appendSeq(elements, args[1]);
 
-  for(const auto& element : (*malEnumerable))
-  {
-    elements.push_back(element);
-  }
-
-  return MalType(new MalList(elements));
+  return MalType(new MalList(std::move(elements)));
 }
 
 MalType MalConcatOperation::apply(const vector<MalType>& args)
 {
-  vector<MalType> elements;
+  bool lazy = false;
 
+  // Only producers that haven't run yet are worth deferring.
   for(const auto& arg : args)
   {
-    auto* malEnumerable = dynamic_cast<MalEnumerable*>(&*arg);
+    lazy = lazy || (typeid(*arg) == typeid(MalLazySeq) && !static_cast<MalLazySeq*>(&*arg)->isBuffered());
+  }
 
-    for(const auto& element : (*malEnumerable))
-    {
-      elements.push_back(element);
-    }
+  if(lazy)
+  {
+    vector<SeqCursor> cursors(args.begin(), args.end());
+    size_t current = 0;
+
+    return MalLazySeq::generate([cursors, current](vector<MalType>& chunk) mutable {
+      MalType value;
+
+      while(current < cursors.size() && chunk.size() < MalLazySeq::chunkSize)
+      {
+        if(!chunk.empty() && !cursors[current].buffered()) return true;
+
+        if(cursors[current].next(value))
+        {
+          chunk.push_back(value);
+        }
+        else
+        {
+          ++current;
+        }
+      }
+
+      return current < cursors.size();
+    });
   }
 
-  return MalType(new MalList(elements));
+  vector<MalType> elements;
+
+  for(const auto& arg : args)
+  {
+    appendSeq(elements, arg);
+  }
+
+  return MalType(new MalList(std::move(elements)));
 }
 
 MalType MalVecOperation::apply(const vector<MalType>& args)
@@ -640,51 +1140,80 @@ MalType MalVecOperation::apply(const vector<MalType>& args)
 
   vector<MalType> elements;
 
-  for(const auto& element : (*dynamic_cast<MalList*>(&*args[0])))
-  {
-    elements.push_back(element);
-  }
+  appendSeq(elements, args[0]);
 
-  return MalType(new MalVector(elements));
+  return MalType(new MalVector(std::move(elements)));
 }
 
 MalType MalNthOperation::apply(const vector<MalType>& args)
 {
+  // A bignum is past the end of anything; other non-integers throw.
+  int64_t index = dynamic_cast<MalBigInt*>(&*args[1]) ? -1 : Interpreter::toInt(args[1]);
+
+  if(auto* lazySeq = dynamic_cast<MalLazySeq*>(&*args[0]))
+  {
+    auto element = index >= 0 ? lazySeq->nth(index) : nullptr;
+
+    if(!element) throw IndexOutOfBoundsException("Index out of bounds: Tried to get nth '"
+      + Printer::prStr(args[1], true) + "' past the end of a lazy sequence");
+
+    return element;
+  }
+
+  if(auto* array = dynamic_cast<MalTypedArray*>(&*args[0]))
+  {
+    if(index < 0 || static_cast<size_t>(index) >= array->size()) throw IndexOutOfBoundsException("Index out of bounds: Tried to get nth '"
+      + Printer::prStr(args[1], true) + "' from an array of size '" + std::to_string(array->size()) + "'");
+
+    return array->nth(index);
+  }
+
   auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0]);
-  auto* index = dynamic_cast<MalInt*>(&*args[1]);
-  int size = static_cast<int>(enumerable->size());
 
-  if(*(*index) >= size) throw IndexOutOfBoundsException("Index out of bounds: Tried to get nth '" 
+  if(!enumerable) throw TypeException("nth takes a sequence but got " + Printer::prStr(args[0], true));
+
+  size_t size = enumerable->size();
+
+  if(index < 0 || static_cast<size_t>(index) >= size) throw IndexOutOfBoundsException("Index out of bounds: Tried to get nth '"
     + Printer::prStr(args[1], true) + "' from enumerable with size '" + std::to_string(size) + "'");
 
-  return (*enumerable)[*(*index)];
+  return (*enumerable)[static_cast<size_t>(index)];
 }
 
 MalType MalFirstOperation::apply(const vector<MalType>& args)
 {
   if(dynamic_cast<MalNil*>(&*args[0])) return MNil;
 
-  auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0]);
-  if(enumerable->isEmpty()) return MNil;
+  if(auto* lazySeq = dynamic_cast<MalLazySeq*>(&*args[0])) return lazySeq->first();
+
+  if(auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0]))
+  {
+    return enumerable->isEmpty() ? MNil : (*enumerable)[0];
+  }
+
+  MalType first;
 
-  return (*enumerable)[0];
+  return SeqCursor(args[0]).next(first) ? first : MNil;
 }
 
 MalType MalRestOperation::apply(const vector<MalType>& args)
 {
   if(dynamic_cast<MalNil*>(&*args[0])) return MalType(new MalList({}));
 
-  auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0]);
-  if(enumerable->isEmpty()) return MalType(new MalList({}));
+  if(auto* lazySeq = dynamic_cast<MalLazySeq*>(&*args[0])) return lazySeq->rest();
 
-  vector<MalType> elements;
-
-  for(auto itr = enumerable->begin() + 1; itr != enumerable->end(); ++itr)
+  if(auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[0]))
   {
-    elements.push_back(*itr);
+    // Short ones are cheaper to copy; longer ones get a view, so walking a
+    // vector with first/rest stays linear.
+    if(enumerable->size() > MalLazySeq::chunkSize) return MalLazySeq::view(args[0], 1);
+
+    return MalType(new MalList(vector<MalType>(enumerable->begin() + (enumerable->isEmpty() ? 0 : 1), enumerable->end())));
   }
 
-  return MalType(new MalList(elements));
+  auto seq = MalLazySeq::from(SeqCursor(args[0]));
+
+  return static_cast<MalLazySeq*>(&*seq)->rest();
 }
 
 MalType MalThrowOperation::apply(const vector<MalType>& args)
@@ -696,36 +1225,101 @@ MalType MalApplyOperation::apply(const vector<MalType>& args)
 {
   auto* operation = dynamic_cast<MalOperation*>(&*args[0]);
 
-  vector<MalType> opArgs;
+  vector<MalType> opArgs(args.begin() + 1, args.end() - 1);
 
-  for(auto itr = args.begin() + 1; itr != args.end() - 1; ++itr)
-  {
-    opArgs.push_back(*itr);
-  }
+  appendSeq(opArgs, args.back());
+
+  return operation->apply(opArgs);
+}
+
+MalType MalSeqOperation::apply(const vector<MalType>& args)
+{
+  auto& seq = args[0];
 
-  auto* lastEnumerable = dynamic_cast<MalEnumerable*>(&*args[args.size() - 1]);
+  if(dynamic_cast<MalNil*>(&*seq)) return MNil;
 
-  for(auto arg : (*lastEnumerable))
+  if(auto* lazySeq = dynamic_cast<MalLazySeq*>(&*seq)) return lazySeq->hasFirst() ? seq : MNil;
+
+  if(auto* enumerable = dynamic_cast<MalEnumerable*>(&*seq))
   {
-    opArgs.push_back(arg);
+    if(enumerable->isEmpty()) return MNil;
+
+    return typeid(*seq) == typeid(MalList) ? seq : MalLazySeq::view(seq, 0);
   }
 
-  return operation->apply(opArgs);
+  auto lazy = MalLazySeq::from(SeqCursor(seq));
+
+  return static_cast<MalLazySeq*>(&*lazy)->hasFirst() ? lazy : MNil;
 }
 
-MalType MalMapOperation::apply(const vector<MalType>& args)
+MalType MalConjOperation::apply(const vector<MalType>& args)
 {
-  auto* operation = dynamic_cast<MalOperation*>(&*args[0]);
-  auto* enumerable = dynamic_cast<MalEnumerable*>(&*args[1]);
-  
-  vector<MalType> elements;
+  auto& coll = args[0];
 
-  for(auto ast : (*enumerable))
+  if(dynamic_cast<MalNil*>(&*coll) || typeid(*coll) == typeid(MalList))
   {
-    elements.push_back(operation->apply({ast}));
+    // Each value goes on the front, so they end up in reverse order.
+    vector<MalType> elements(args.rbegin(), args.rend() - 1);
+
+    if(typeid(*coll) == typeid(MalList)) appendSeq(elements, coll);
+
+    return MalType(new MalList(std::move(elements)));
   }
 
-  return MalType(new MalList(elements));
+  if(auto* malVector = dynamic_cast<MalVector*>(&*coll))
+  {
+    vector<MalType> elements;
+    elements.reserve(malVector->size() + args.size() - 1);
+
+    elements.insert(elements.end(), malVector->begin(), malVector->end());
+    elements.insert(elements.end(), args.begin() + 1, args.end());
+
+    return MalType(new MalVector(std::move(elements)));
+  }
+
+  if(auto* malMap = dynamic_cast<MalHashMap*>(&*coll))
+  {
+    auto entries = malMap->getEntries();
+
+    for(auto itr = args.begin() + 1; itr != args.end(); ++itr)
+    {
+      if(auto* other = dynamic_cast<MalHashMap*>(&**itr))
+      {
+        for(const auto& entry : other->getEntries())
+        {
+          entries[entry.first] = entry.second;
+        }
+
+        continue;
+      }
+
+      auto* entry = dynamic_cast<MalVector*>(&**itr);
+
+      if(!entry || entry->size() != 2) throw TypeException("conj on a map takes [key value] vectors or maps");
+
+      auto key = MalHashMap::keyFor((*entry)[0]);
+
+      if(key.empty()) throw InvalidKeyException("Invalid key in hashmap");
+
+      entries[key] = (*entry)[1];
+    }
+
+    return MalType(new MalHashMap(std::move(entries)));
+  }
+
+  if(dynamic_cast<MalLazySeq*>(&*coll))
+  {
+    auto seq = coll;
+
+    for(auto itr = args.begin() + 1; itr != args.end(); ++itr)
+    {
+      seq = MalLazySeq::cons(*itr, *static_cast<MalLazySeq*>(&*seq));
+    }
+
+    return seq;
+  }
+
+  throw TypeException("Cannot conj onto " + Printer::prStr(coll, true));
 }
 
 MalType MalIsNilOperation::apply(const vector<MalType>& args)
@@ -773,7 +1367,7 @@ MalType MalVectorOperation::apply(const vector<MalType>& args)
 {
   vector<MalType> elements;
 
-  for(auto arg : args)
+  for(const auto& arg : args)
   {
     elements.push_back(arg);
   }
@@ -795,7 +1389,7 @@ MalType MalHashMapOperation::apply(const vector<MalType>& args)
 {
   vector<MalType> elements;
 
-  for(auto arg : args)
+  for(const auto& arg : args)
   {
     elements.push_back(arg);
   }
@@ -812,75 +1406,61 @@ MalType MalAssocOperation::apply(const vector<MalType>& args)
 {
   auto* malMap = dynamic_cast<MalHashMap*>(&*args[0]);
 
-  vector<MalType> elements;
+  if(args.size() % 2 != 1) throw EOFException("Expected equal amount of keys and values");
+
+  auto entries = malMap->getEntries();
 
-  for(auto pair : (*malMap))
+  for(size_t i = 1; i < args.size(); i += 2)
   {
-     MalType key = MalType(pair.first[0] == '"' ? 
-        dynamic_cast<MalTypeData*>(new MalString(pair.first.substr(1, pair.first.size() - 2))) :
-        dynamic_cast<MalTypeData*>(new MalKeyword(pair.first)));
+    auto key = MalHashMap::keyFor(args[i]);
 
-    elements.push_back(key);
-    elements.push_back(pair.second);
-  }
+    if(key.empty()) throw InvalidKeyException("Invalid key in hashmap");
 
-  for(auto itr = args.begin() + 1; itr != args.end(); ++itr)
-  {
-    elements.push_back(*itr);
+    entries[key] = args[i + 1];
   }
 
-  return MalType(new MalHashMap(elements));
+  return MalType(new MalHashMap(std::move(entries)));
 }
 
 MalType MalDissocOperation::apply(const vector<MalType>& args)
 {
   auto* malMap = dynamic_cast<MalHashMap*>(&*args[0]);
 
-  vector<MalType> elements;
+  auto entries = malMap->getEntries();
 
-  for(auto pair : (*malMap))
+  for(auto itr = args.begin() + 1; itr != args.end(); ++itr)
   {
-    bool shouldRemoveKey = false;
-
-    MalType key = MalType(pair.first[0] == '"' ? 
-        dynamic_cast<MalTypeData*>(new MalString(pair.first.substr(1, pair.first.size() - 2))) :
-        dynamic_cast<MalTypeData*>(new MalKeyword(pair.first)));
-
-    for(auto itr = args.begin() + 1; itr != args.end(); ++itr)
-    {
-      if((*itr)->equals(key))
-      {
-        shouldRemoveKey = true;
-        break;
-      }
-    }
-
-    if(shouldRemoveKey) continue;
-
-    elements.push_back(key);
-    elements.push_back(pair.second);
+    entries.erase(MalHashMap::keyFor(*itr));
   }
 
-  return MalType(new MalHashMap(elements));
+  return MalType(new MalHashMap(std::move(entries)));
 }
 
 MalType MalGetOperation::apply(const vector<MalType>& args)
 {
   if(dynamic_cast<MalNil*>(&*args[0])) return MNil;
 
-  auto* malMap = dynamic_cast<MalHashMap*>(&*args[0]);
-
-  string key;
-
-  if(auto* stringKey = dynamic_cast<MalString*>(&*args[1]))
+  if(auto* transientMap = dynamic_cast<MalTransientMap*>(&*args[0]))
   {
-    key = '"' + stringKey->getString(false) + '"';
+    auto value = transientMap->get(args[1]);
+
+    return value ? value : MNil;
   }
-  else if(auto* keywordKey = dynamic_cast<MalKeyword*>(&*args[1]))
+
+  if(auto* transientVector = dynamic_cast<MalTransientVector*>(&*args[0]))
   {
-    key = keywordKey->getString(false);
+    auto* index = dynamic_cast<MalInt*>(&*args[1]);
+    auto value = index ? transientVector->get(**index) : nullptr;
+
+    return value ? value : MNil;
   }
 
+  auto* malMap = dynamic_cast<MalHashMap*>(&*args[0]);
+
+  if(!malMap) throw TypeException("get takes a map but got " + Printer::prStr(args[0], true));
+
+  auto key = MalHashMap::keyFor(args[1]);
+
   if(!malMap->contains(key)) return MNil;
 
   return (*malMap)[key];
@@ -888,20 +1468,23 @@ MalType MalGetOperation::apply(const vector<MalType>& args)
 
 MalType MalContainsOperation::apply(const vector<MalType>& args)
 {
-  auto* malMap = dynamic_cast<MalHashMap*>(&*args[0]);
-
-  string key;
-
-  if(auto* stringKey = dynamic_cast<MalString*>(&*args[1]))
+  if(auto* transientMap = dynamic_cast<MalTransientMap*>(&*args[0]))
   {
-    key = '"' + stringKey->getString(false) + '"';
+    return transientMap->get(args[1]) ? MTrue : MFalse;
   }
-  else if(auto* keywordKey = dynamic_cast<MalKeyword*>(&*args[1]))
+
+  if(auto* transientVector = dynamic_cast<MalTransientVector*>(&*args[0]))
   {
-    key = keywordKey->getString(false);
+    auto* index = dynamic_cast<MalInt*>(&*args[1]);
+
+    return index && transientVector->get(**index) ? MTrue : MFalse;
   }
 
-  return malMap->contains(key) ? MTrue : MFalse;
+  auto* malMap = dynamic_cast<MalHashMap*>(&*args[0]);
+
+  if(!malMap) throw TypeException("contains? takes a map but got " + Printer::prStr(args[0], true));
+
+  return malMap->contains(MalHashMap::keyFor(args[1])) ? MTrue : MFalse;
 }
 
 MalType MalKeysOperation::apply(const vector<MalType>& args)
@@ -910,13 +1493,9 @@ MalType MalKeysOperation::apply(const vector<MalType>& args)
 
   vector<MalType> keys;
 
-  for(auto pair : (*malMap))
+  for(const auto& pair : (*malMap))
   {
-     MalType key = MalType(pair.first[0] == '"' ? 
-        dynamic_cast<MalTypeData*>(new MalString(pair.first.substr(1, pair.first.size() - 2))) :
-        dynamic_cast<MalTypeData*>(new MalKeyword(pair.first)));
-
-    keys.push_back(key);
+    keys.push_back(MalHashMap::keyFrom(pair.first));
   }
 
   return MalType(new MalList(keys));
@@ -928,10 +1507,63 @@ MalType MalValsOperation::apply(const vector<MalType>& args)
 
   vector<MalType> vals;
 
-  for(auto pair : (*malMap))
+  for(const auto& pair : (*malMap))
   {
     vals.push_back(pair.second);
   }
 
   return MalType(new MalList(vals));
 }
+
+MalType MalReadlineOperation::apply(const vector<MalType>& args)
+{
+  auto* prompt = dynamic_cast<MalString*>(&*args[0]);
+
+  interpreter_.getOutput() << *(*prompt) << std::flush;
+
+  string line;
+  if(!std::getline(interpreter_.getInput(), line)) return MNil;
+
+  return MalType(new MalString(line));
+}
+
+MalType MalIsStringOperation::apply(const vector<MalType>& args)
+{
+  return dynamic_cast<MalString*>(&*args[0]) ? MTrue : MFalse;
+}
+
+MalType MalIsNumberOperation::apply(const vector<MalType>& args)
+{
+  const auto& type = typeid(*args[0]);
+
+  return type == typeid(MalInt) || type == typeid(MalDouble) || type == typeid(MalBigInt) ? MTrue : MFalse;
+}
+
+MalType MalIsFnOperation::apply(const vector<MalType>& args)
+{
+  auto* function = dynamic_cast<MalFunction*>(&*args[0]);
+  if(function) return function->isMacro() ? MFalse : MTrue;
+
+  return dynamic_cast<MalOperation*>(&*args[0]) ? MTrue : MFalse;
+}
+
+MalType MalIsMacroOperation::apply(const vector<MalType>& args)
+{
+  auto* function = dynamic_cast<MalFunction*>(&*args[0]);
+
+  return function && function->isMacro() ? MTrue : MFalse;
+}
+
+MalType MalTimeMsOperation::apply(const vector<MalType>& _)
+{
+  auto now = std::chrono::system_clock::now().time_since_epoch();
+
+  return MalInt::of(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
+
+MalType MalTimeNsOperation::apply(const vector<MalType>& _)
+{
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+  return MalInt::of(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
@@ -4,6 +4,8 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <atomic>
+#include <cstdint>
 #include <functional>
 
 using std::string;
@@ -18,6 +20,12 @@ typedef shared_ptr<MalTypeData> MalType;
 class EnvData;
 typedef shared_ptr<EnvData> Env;
 
+class Interpreter;
+
+class Cursor;
+
+class HeapVisitor;
+
 extern MalType MFalse;
 extern MalType MTrue;
 extern MalType MNil;
@@ -28,72 +36,155 @@ public:
   virtual string getString(bool printReadably) = 0;
 
   virtual bool equals(const MalType& other) const { return false; }
+
+  // A structurally equal value sharing no reference counts with this one,
+  // used to move data between interpreters on different threads.
+  virtual MalType deepCopy() const;
+
+  // Walks this value as a sequence, or nullptr if it isn't one. self is the
+  // MalType holding this, for the cursor to keep alive.
+  virtual shared_ptr<Cursor> cursor(const MalType& self);
+
+  // Tells the visitor what this value refers to and what memory it owns
+  // besides itself (heap.hpp). Leaves that own nothing needn't override it.
+  virtual void traverse(HeapVisitor&) const {}
+
+  // Count values per thread, and in instrumented builds account for every
+  // one (allocstats.hpp).
+  static void* operator new(size_t size);
+  static void operator delete(void* block, size_t size);
+};
+
+// The sequence protocol. Lists, vectors and lazy seqs yield their elements,
+// maps their entries as [key value] vectors, strings their characters as
+// one-character strings, and nil nothing.
+class Cursor
+{
+public:
+  virtual ~Cursor() = default;
+
+  // Reads the next element into value; false once there are none left.
+  virtual bool next(MalType& value) = 0;
+
+  // Whether next() can answer without running a lazy seq's producers.
+  virtual bool buffered() const { return true; }
+};
+
+// A copyable handle on the cursor of any sequence; throws a TypeException
+// for values that aren't one. Copies share their position.
+class SeqCursor
+{
+  shared_ptr<Cursor> cursor_;
+
+public:
+  SeqCursor(const MalType& seq);
+
+  bool next(MalType& value) { return cursor_->next(value); }
+
+  // Producers end a chunk where their input's chunk ends, so one built on
+  // (lazy-seq ...) goes an element at a time and may refer back to itself.
+  bool buffered() const { return cursor_->buffered(); }
 };
 
 class MalInt : public MalTypeData
 {
-  int value_;
+  int64_t value_;
 
 public:
-  MalInt(int value);
+  MalInt(int64_t value);
+
+  // Shares one preallocated MalInt per small value instead of allocating.
+  static MalType of(int64_t value);
 
   virtual string getString(bool printReadably) override;
 
-  int operator+(const MalInt& other) const;
-  int operator-(const MalInt& other) const;
-  int operator*(const MalInt& other) const;
-  int operator/(const MalInt& other) const;
   bool operator>(const MalInt& other) const;
   bool operator>=(const MalInt& other) const;
   bool operator<(const MalInt& other) const;
   bool operator<=(const MalInt& other) const;
 
-  int operator*() const;
+  int64_t operator*() const;
 
   virtual bool equals(const MalType& other) const override;
+
+  virtual MalType deepCopy() const override;
+};
+
+typedef size_t SymbolId;
+
+class SymbolTable
+{
+public:
+  static SymbolId intern(const string& name);
+  static const string& name(const SymbolId& id);
 };
 
 class MalSymbol : public MalTypeData
 {
-  string symbol_;
+  SymbolId id_;
+  const string* symbol_;
 
 public:
-  MalSymbol(string symbol);
+  MalSymbol(const string& symbol);
 
-  string getSymbol() const;
+  const string& getSymbol() const { return *symbol_; }
+  SymbolId getId() const { return id_; }
 
   virtual string getString(bool printReadably) override;
 
   virtual bool equals(const MalType& other) const override;
+
+  virtual MalType deepCopy() const override;
 };
 
 class MalEnumerable : public MalTypeData
 {
+  // Set until a lazy subclass has filled in elements_.
+  std::atomic<bool> pending_;
+
+  void ensureRealized() const
+  {
+    if(pending_.load(std::memory_order_acquire)) const_cast<MalEnumerable*>(this)->realize();
+  }
+
 protected:
   vector<MalType> elements_;
 
+  // Starts out pending; realize() is called before elements_ is first read
+  // and must end with markRealized().
+  MalEnumerable();
+
+  virtual void realize() {}
+  void markRealized() { pending_.store(false, std::memory_order_release); }
+
 public:
   MalEnumerable(vector<MalType> elements);
 
   virtual string getString(bool printReadably) override = 0;
 
-  vector<MalType>::iterator begin() { return elements_.begin(); }
-  vector<MalType>::iterator end() { return elements_.end(); }
+  vector<MalType>::iterator begin() { ensureRealized(); return elements_.begin(); }
+  vector<MalType>::iterator end() { ensureRealized(); return elements_.end(); }
 
-  bool isEmpty() const { return elements_.empty(); }
-  size_t size() const { return elements_.size(); }
+  bool isEmpty() const { ensureRealized(); return elements_.empty(); }
+  size_t size() const { ensureRealized(); return elements_.size(); }
 
-  MalType operator[](const int& index) { return elements_[index]; }
+  MalType operator[](size_t index) { ensureRealized(); return elements_[index]; }
 
   virtual bool equals(const MalType& other) const override;
+
+  virtual shared_ptr<Cursor> cursor(const MalType& self) override;
+
+  virtual void traverse(HeapVisitor& visitor) const override;
 };
 
 class MalList : public MalEnumerable
 {
 public:
-  MalList(vector<MalType> elements): MalEnumerable(elements) {}
+  MalList(vector<MalType> elements): MalEnumerable(std::move(elements)) {}
 
   virtual string getString(bool printReadably) override;
+
+  virtual MalType deepCopy() const override;
 };
 
 class MalString : public MalTypeData
@@ -107,7 +198,13 @@ public:
 
   virtual bool equals(const MalType& other) const override;
 
-  string operator*();
+  virtual MalType deepCopy() const override;
+
+  virtual void traverse(HeapVisitor& visitor) const override;
+
+  virtual shared_ptr<Cursor> cursor(const MalType& self) override;
+
+  const string& operator*() const;
 };
 
 class MalNil : public MalTypeData
@@ -118,6 +215,10 @@ public:
   virtual string getString(bool printReadably) override;
 
   virtual bool equals(const MalType& other) const override;
+
+  virtual MalType deepCopy() const override;
+
+  virtual shared_ptr<Cursor> cursor(const MalType& self) override;
 };
 
 class MalTrue : public MalTypeData
@@ -128,6 +229,8 @@ public:
   virtual string getString(bool printReadably) override;
 
   virtual bool equals(const MalType& other) const override;
+
+  virtual MalType deepCopy() const override;
 };
 
 class MalFalse : public MalTypeData
@@ -138,14 +241,18 @@ public:
   virtual string getString(bool printReadably) override;
 
   virtual bool equals(const MalType& other) const override;
+
+  virtual MalType deepCopy() const override;
 };
 
 class MalVector : public MalEnumerable
 {
 public:
-  MalVector(vector<MalType> elements): MalEnumerable(elements) {}
+  MalVector(vector<MalType> elements): MalEnumerable(std::move(elements)) {}
 
   virtual string getString(bool printReadably) override;
+
+  virtual MalType deepCopy() const override;
 };
 
 class MalKeyword : public MalTypeData
@@ -158,6 +265,10 @@ public:
   virtual string getString(bool printReadably) override;
 
   virtual bool equals(const MalType& other) const override;
+
+  virtual MalType deepCopy() const override;
+
+  virtual void traverse(HeapVisitor& visitor) const override;
 };
 
 class MalHashMap : public MalTypeData
@@ -166,17 +277,33 @@ class MalHashMap : public MalTypeData
 
 public:
   MalHashMap(vector<MalType> elements);
+  explicit MalHashMap(map<string, MalType> entries): map_(std::move(entries)) {}
+
+  // Entries are keyed by the printed form of a string or keyword key; keyFor
+  // returns "" for anything that can't be a key.
+  static string keyFor(const MalType& key);
+  static MalType keyFrom(const string& key);
 
   virtual string getString(bool printReadably) override;
 
   virtual bool equals(const MalType& other) const override;
 
+  virtual MalType deepCopy() const override;
+
+  virtual void traverse(HeapVisitor& visitor) const override;
+
+  virtual shared_ptr<Cursor> cursor(const MalType& self) override;
+
   map<string, MalType>::iterator begin() { return map_.begin(); }
   map<string, MalType>::iterator end() { return map_.end(); }
 
   MalType& operator[](const string& key);
 
   bool contains(const string& key) const;
+
+  size_t size() const { return map_.size(); }
+
+  const map<string, MalType>& getEntries() const { return map_; }
 };
 
 class MalOperation : public MalTypeData
@@ -189,44 +316,13 @@ public:
   virtual MalType apply(const vector<MalType>& args) = 0;
 };
 
-class MalAddOperation : public MalOperation
-{
-public:
-  MalAddOperation() = default;
-
-  virtual MalType apply(const vector<MalType>& args) override;
-};
-
-class MalMultOperation : public MalOperation
-{
-public:
-  MalMultOperation() = default;
-
-  virtual MalType apply(const vector<MalType>& args) override;
-};
-
-class MalSubOperation : public MalOperation
-{
-public:
-  MalSubOperation() = default;
-
-  virtual MalType apply(const vector<MalType>& args) override;
-};
-
-class MalDivOperation : public MalOperation
-{
-public:
-  MalDivOperation() = default;
-
-  virtual MalType apply(const vector<MalType>& args) override;
-};
-
 class MalFunction : public MalOperation
 {
   vector<MalType> bindings_;
   MalType body_;
   Env baseEnv_;
   bool isMacro_;
+  std::atomic<SymbolId> name_;
 
 public:
   MalFunction(const vector<MalType>& bindings, const MalType& body, const Env& baseEnv, const bool& isMacro = false);
@@ -235,18 +331,27 @@ public:
 
   MalType apply(const vector<MalType>& args);
 
+  virtual void traverse(HeapVisitor& visitor) const override;
+
   MalType getBody() const;
   Env makeEnv(const vector<MalType>& args) const;
 
   void makeMacro();
 
   bool isMacro() const;
+
+  // The symbol the first def! or defmacro! bound this to, for profiles and
+  // stack dumps; CallStack::anonymous() until then.
+  SymbolId getName() const { return name_.load(std::memory_order_relaxed); }
+  void nameIfAnonymous(SymbolId name);
 };
 
 class MalPrnOperation : public MalOperation
 {
+  Interpreter& interpreter_;
+
 public:
-  MalPrnOperation() = default;
+  MalPrnOperation(Interpreter& interpreter): interpreter_(interpreter) {}
 
   virtual MalType apply(const vector<MalType>& args) override;
 };
@@ -291,38 +396,6 @@ public:
   virtual MalType apply(const vector<MalType>& args) override;
 };
 
-class MalGTOperation : public MalOperation
-{
-public:
-  MalGTOperation() = default;
-
-  virtual MalType apply(const vector<MalType>& args) override;
-};
-
-class MalGTEOperation : public MalOperation
-{
-public:
-  MalGTEOperation() = default;
-
-  virtual MalType apply(const vector<MalType>& args) override;
-};
-
-class MalLTOperation : public MalOperation
-{
-public:
-  MalLTOperation() = default;
-
-  virtual MalType apply(const vector<MalType>& args) override;
-};
-
-class MalLTEOperation : public MalOperation
-{
-public:
-  MalLTEOperation() = default;
-
-  virtual MalType apply(const vector<MalType>& args) override;
-};
-
 class MalPrStrOperation : public MalOperation
 {
 public:
@@ -341,8 +414,10 @@ public:
 
 class MalPrintlnOperation : public MalOperation
 {
+  Interpreter& interpreter_;
+
 public:
-  MalPrintlnOperation() = default;
+  MalPrintlnOperation(Interpreter& interpreter): interpreter_(interpreter) {}
 
   virtual MalType apply(const vector<MalType>& args) override;
 };
@@ -365,15 +440,31 @@ public:
 
 class MalEvalOperation : public MalOperation
 {
+  Interpreter& interpreter_;
+
 public:
-  MalEvalOperation() = default;
+  MalEvalOperation(Interpreter& interpreter): interpreter_(interpreter) {}
 
   virtual MalType apply(const vector<MalType>& args) override;
 };
 
-class MalAtom : public MalTypeData
+// Anything deref (and @) reads through: atoms, thread results and the like.
+class MalDerefable : public MalTypeData
+{
+public:
+  virtual MalType deref() = 0;
+};
+
+// Atoms may be shared between threads. The reference is only read and
+// replaced through the atomic shared_ptr functions, and every update is a
+// compare-and-swap, so an update function can run more than once under
+// contention and must not have side effects.
+class MalAtom : public MalDerefable
 {
+  typedef vector<std::pair<MalType, MalType>> Watches;
+
   MalType ref_;
+  shared_ptr<const Watches> watches_;
 
 public:
   MalAtom(const MalType& ref);
@@ -382,9 +473,26 @@ public:
 
   virtual bool equals(const MalType& other) const override;
 
-  MalType operator*();
+  virtual MalType deepCopy() const override;
+
+  virtual void traverse(HeapVisitor& visitor) const override;
+
+  MalType operator*() const;
+
+  virtual MalType deref() override { return **this; }
 
-  void setRef(const MalType& ref);
+  // Each returns the value that was replaced.
+  MalType reset(const MalType& ref);
+  MalType swap(const function<MalType(const MalType&)>& update);
+
+  // Succeeds only if the current value equals expected when it is replaced.
+  bool compareAndSet(const MalType& expected, const MalType& ref);
+
+  void addWatch(const MalType& key, const MalType& callback);
+  void removeWatch(const MalType& key);
+
+  // Calls each watch with (key atom old new); self is the atom's own handle.
+  void notifyWatches(const MalType& self, const MalType& oldRef, const MalType& newRef) const;
 };
 
 class MalAtomOperation : public MalOperation
@@ -427,6 +535,38 @@ public:
   virtual MalType apply(const vector<MalType>& args) override;
 };
 
+class MalSwapValsOperation : public MalOperation
+{
+public:
+  MalSwapValsOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalCompareAndSetOperation : public MalOperation
+{
+public:
+  MalCompareAndSetOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalAddWatchOperation : public MalOperation
+{
+public:
+  MalAddWatchOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalRemoveWatchOperation : public MalOperation
+{
+public:
+  MalRemoveWatchOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
 class MalConsOperation : public MalOperation
 {
 public:
@@ -491,10 +631,22 @@ public:
   virtual MalType apply(const vector<MalType>& args) override;
 };
 
-class MalMapOperation : public MalOperation
+// (seq coll): nil for an empty collection, otherwise its elements as a
+// list or lazy seq. Vectors are viewed, not copied.
+class MalSeqOperation : public MalOperation
+{
+public:
+  MalSeqOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (conj coll x ...) adds where coll is cheapest to grow: the front of a list
+// or lazy seq, the end of a vector, or by key for a map.
+class MalConjOperation : public MalOperation
 {
 public:
-  MalMapOperation() = default;
+  MalConjOperation() = default;
 
   virtual MalType apply(const vector<MalType>& args) override;
 };
@@ -642,3 +794,63 @@ public:
 
   virtual MalType apply(const vector<MalType>& args) override;
 };
+
+class MalReadlineOperation : public MalOperation
+{
+  Interpreter& interpreter_;
+
+public:
+  MalReadlineOperation(Interpreter& interpreter): interpreter_(interpreter) {}
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalIsStringOperation : public MalOperation
+{
+public:
+  MalIsStringOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalIsNumberOperation : public MalOperation
+{
+public:
+  MalIsNumberOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalIsFnOperation : public MalOperation
+{
+public:
+  MalIsFnOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalIsMacroOperation : public MalOperation
+{
+public:
+  MalIsMacroOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+// (time-ms) is wall-clock milliseconds since the epoch; (time-ns) is
+// nanoseconds on the monotonic clock, for measuring intervals.
+class MalTimeMsOperation : public MalOperation
+{
+public:
+  MalTimeMsOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};
+
+class MalTimeNsOperation : public MalOperation
+{
+public:
+  MalTimeNsOperation() = default;
+
+  virtual MalType apply(const vector<MalType>& args) override;
+};